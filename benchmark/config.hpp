@@ -11,6 +11,7 @@
 #include <nonius.h++>
 
 #include <immer/heap/gc_heap.hpp>
+#include <immer/heap/hugepage_heap.hpp>
 #include <immer/memory_policy.hpp>
 
 namespace {
@@ -51,5 +52,7 @@ using gcf_memory    = immer::memory_policy<immer::heap_policy<immer::gc_heap>, i
 using basic_memory  = immer::memory_policy<immer::heap_policy<immer::cpp_heap>, immer::refcount_policy>;
 using safe_memory   = immer::memory_policy<immer::free_list_heap_policy<immer::cpp_heap>, immer::refcount_policy>;
 using unsafe_memory = immer::memory_policy<immer::unsafe_free_list_heap_policy<immer::cpp_heap>, immer::unsafe_refcount_policy>;
+using huge_memory   = immer::memory_policy<immer::free_list_heap_policy<immer::hugepage_heap<>>, immer::refcount_policy>;
+using fewer_memory  = immer::memory_policy<immer::free_list_heap_policy<immer::cpp_heap>, immer::refcount_policy, immer::no_transience_policy, true>;
 
 } // anonymous namespace
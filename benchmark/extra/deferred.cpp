@@ -0,0 +1,89 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#include <immer/flex_vector.hpp>
+#include <immer/map.hpp>
+#include <immer/refcount/deferred_refcount_policy.hpp>
+
+#include <nonius.h++>
+
+#include <vector>
+
+NONIUS_PARAM(N, std::size_t{1000})
+
+namespace {
+
+using def_memory      = immer::default_memory_policy;
+using deferred_memory = immer::memory_policy<
+    immer::free_list_heap_policy<immer::cpp_heap>,
+    immer::deferred_refcount_policy<>>;
+
+// Replaces a container of `N` elements by a new one.  Both policies
+// spend the same time building the new container, so the difference
+// is the time it takes to drop the last reference to the old one,
+// which is what a latency critical thread pays when it releases it.
+template <typename Container, typename Fn>
+auto benchmark_release(Fn make)
+{
+    return [=] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        auto cs = std::vector<Container>(meter.runs());
+        for (auto& c : cs)
+            c = make(n);
+        meter.measure([&] (int i) {
+            cs[i] = make(n);
+        });
+        cs.clear();
+        immer::drain_deferred();
+    };
+}
+
+auto make_flex_vector = [] (auto n, auto v) {
+    for (auto i = 0u; i < n; ++i)
+        v = std::move(v).push_back(i);
+    return v;
+};
+
+auto make_map = [] (auto n, auto m) {
+    for (auto i = 0u; i < n; ++i)
+        m = std::move(m).set(i, i);
+    return m;
+};
+
+template <typename MemoryPolicy>
+using flex_t = immer::flex_vector<unsigned, MemoryPolicy>;
+
+template <typename MemoryPolicy>
+using map_t = immer::map<unsigned, unsigned, std::hash<unsigned>,
+                         std::equal_to<unsigned>, MemoryPolicy>;
+
+template <typename MemoryPolicy>
+auto benchmark_release_flex_vector()
+{
+    using container_t = flex_t<MemoryPolicy>;
+    return benchmark_release<container_t>([] (auto n) {
+        return make_flex_vector(n, container_t{});
+    });
+}
+
+template <typename MemoryPolicy>
+auto benchmark_release_map()
+{
+    using container_t = map_t<MemoryPolicy>;
+    return benchmark_release<container_t>([] (auto n) {
+        return make_map(n, container_t{});
+    });
+}
+
+} // anonymous namespace
+
+NONIUS_BENCHMARK("flex_vector/default",  benchmark_release_flex_vector<def_memory>())
+NONIUS_BENCHMARK("flex_vector/deferred", benchmark_release_flex_vector<deferred_memory>())
+NONIUS_BENCHMARK("map/default",          benchmark_release_map<def_memory>())
+NONIUS_BENCHMARK("map/deferred",         benchmark_release_map<deferred_memory>())
@@ -0,0 +1,97 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#include <immer/array.hpp>
+#include <immer/flex_vector.hpp>
+#include <immer/map.hpp>
+#include <immer/vector.hpp>
+
+#include <nonius.h++>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+NONIUS_PARAM(N, std::size_t{100000})
+
+namespace {
+
+auto thread_count()
+{
+    return std::max(2u, std::thread::hardware_concurrency());
+}
+
+// Every thread creates and drops `N` containers, copied from the one
+// returned by `make`.  The default constructed containers all share
+// the same immortal root, whose count is never written.  Copying a
+// non empty container from every thread shows what they would cost
+// if the root was counted instead.
+template <typename Container, typename Fn>
+auto benchmark_copies(Fn make)
+{
+    return [=] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        auto proto = make();
+        meter.measure([&] {
+            auto sizes = std::vector<std::size_t>(thread_count());
+            auto threads = std::vector<std::thread>{};
+            for (auto& size : sizes)
+                threads.emplace_back([&proto, n, &size] {
+                    auto sum = std::size_t{};
+                    for (auto j = 0u; j < n; ++j) {
+                        auto c = proto;
+                        sum += c.size();
+                    }
+                    size = sum;
+                });
+            for (auto& t : threads)
+                t.join();
+            return sizes;
+        });
+    };
+}
+
+template <typename Container>
+auto benchmark_empty()
+{
+    return benchmark_copies<Container>([] { return Container{}; });
+}
+
+template <typename Container>
+auto benchmark_shared()
+{
+    return benchmark_copies<Container>([] {
+        return Container{}.push_back(42);
+    });
+}
+
+template <typename Map>
+auto benchmark_shared_map()
+{
+    return benchmark_copies<Map>([] { return Map{}.set(42, 42); });
+}
+
+using vector_t      = immer::vector<unsigned>;
+using flex_vector_t = immer::flex_vector<unsigned>;
+using array_t       = immer::array<unsigned>;
+using map_t         = immer::map<unsigned, unsigned>;
+
+} // anonymous namespace
+
+NONIUS_BENCHMARK("vector - empty", benchmark_empty<vector_t>())
+NONIUS_BENCHMARK("vector - shared", benchmark_shared<vector_t>())
+
+NONIUS_BENCHMARK("flex_vector - empty", benchmark_empty<flex_vector_t>())
+NONIUS_BENCHMARK("flex_vector - shared", benchmark_shared<flex_vector_t>())
+
+NONIUS_BENCHMARK("array - empty", benchmark_empty<array_t>())
+NONIUS_BENCHMARK("array - shared", benchmark_shared<array_t>())
+
+NONIUS_BENCHMARK("map - empty", benchmark_empty<map_t>())
+NONIUS_BENCHMARK("map - shared", benchmark_shared_map<map_t>())
@@ -0,0 +1,135 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#include <immer/heap/cpp_heap.hpp>
+#include <immer/heap/heap_policy.hpp>
+#include <immer/heap/free_list_heap.hpp>
+
+#include <nonius.h++>
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+NONIUS_PARAM(N, std::size_t{1000})
+
+namespace {
+
+constexpr auto node_size  = 64u;
+constexpr auto batch_size = 32u;
+
+// Every thread allocates and deallocates `N` batches of nodes, with
+// an access to each node in between.  The more the heap contends,
+// the worse the total time grows as the number of threads increases.
+template <typename Heap, unsigned Threads>
+auto benchmark_churn()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+
+        meter.measure([&] {
+            auto threads = std::vector<std::thread>{};
+            for (auto t = 0u; t < Threads; ++t)
+                threads.emplace_back([&] {
+                    auto nodes = std::array<void*, batch_size>{};
+                    for (auto i = 0u; i < n; ++i) {
+                        for (auto& p : nodes) {
+                            p = Heap::allocate(node_size);
+                            *static_cast<volatile unsigned*>(p) = i;
+                        }
+                        for (auto& p : nodes)
+                            Heap::deallocate(node_size, p);
+                    }
+                });
+            for (auto& t : threads)
+                t.join();
+        });
+    };
+}
+
+// One thread allocates `N` batches of nodes and hands them over to
+// another thread that deallocates them, so nodes are always released
+// by a different thread than the one that allocated them.
+template <typename Heap>
+auto benchmark_producer_consumer()
+{
+    return [] (nonius::chronometer meter)
+    {
+        using batch_t = std::array<void*, batch_size>;
+
+        auto n = meter.param<N>();
+
+        meter.measure([&] {
+            auto queue = std::deque<batch_t>{};
+            std::mutex mutex;
+            std::condition_variable cv;
+            auto producer = std::thread{[&] {
+                for (auto i = 0u; i < n; ++i) {
+                    auto nodes = batch_t{};
+                    for (auto& p : nodes) {
+                        p = Heap::allocate(node_size);
+                        *static_cast<volatile unsigned*>(p) = i;
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock{mutex};
+                        queue.push_back(nodes);
+                    }
+                    cv.notify_one();
+                }
+            }};
+            auto consumer = std::thread{[&] {
+                for (auto i = 0u; i < n; ++i) {
+                    std::unique_lock<std::mutex> lock{mutex};
+                    cv.wait(lock, [&] { return !queue.empty(); });
+                    auto nodes = queue.front();
+                    queue.pop_front();
+                    lock.unlock();
+                    for (auto p : nodes)
+                        Heap::deallocate(node_size, p);
+                }
+            }};
+            producer.join();
+            consumer.join();
+        });
+    };
+}
+
+using cpp_heap       = immer::cpp_heap;
+using free_list_heap = immer::with_free_list_node<
+    immer::free_list_heap<node_size, immer::default_free_list_size,
+                          immer::cpp_heap>>;
+using policy_heap    = immer::free_list_heap_policy<immer::cpp_heap>
+    ::optimized<node_size>::type;
+
+} // anonymous namespace
+
+NONIUS_BENCHMARK("cpp/1",        benchmark_churn<cpp_heap, 1>())
+NONIUS_BENCHMARK("cpp/4",        benchmark_churn<cpp_heap, 4>())
+NONIUS_BENCHMARK("cpp/16",       benchmark_churn<cpp_heap, 16>())
+NONIUS_BENCHMARK("cpp/32",       benchmark_churn<cpp_heap, 32>())
+
+NONIUS_BENCHMARK("free_list/1",  benchmark_churn<free_list_heap, 1>())
+NONIUS_BENCHMARK("free_list/4",  benchmark_churn<free_list_heap, 4>())
+NONIUS_BENCHMARK("free_list/16", benchmark_churn<free_list_heap, 16>())
+NONIUS_BENCHMARK("free_list/32", benchmark_churn<free_list_heap, 32>())
+
+NONIUS_BENCHMARK("policy/1",     benchmark_churn<policy_heap, 1>())
+NONIUS_BENCHMARK("policy/4",     benchmark_churn<policy_heap, 4>())
+NONIUS_BENCHMARK("policy/16",    benchmark_churn<policy_heap, 16>())
+NONIUS_BENCHMARK("policy/32",    benchmark_churn<policy_heap, 32>())
+
+NONIUS_BENCHMARK("cpp/producer-consumer",
+                 benchmark_producer_consumer<cpp_heap>())
+NONIUS_BENCHMARK("free_list/producer-consumer",
+                 benchmark_producer_consumer<free_list_heap>())
+NONIUS_BENCHMARK("policy/producer-consumer",
+                 benchmark_producer_consumer<policy_heap>())
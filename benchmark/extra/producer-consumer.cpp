@@ -0,0 +1,139 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#include <immer/vector.hpp>
+#include <immer/heap/cpp_heap.hpp>
+#include <immer/heap/heap_policy.hpp>
+
+#include <nonius.h++>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+NONIUS_PARAM(N, std::size_t{1000})
+
+namespace {
+
+constexpr auto vector_count = 16u;
+
+// Counts the calls to the underlying heap, so we can report how many
+// of them each heap policy avoids.
+template <typename Tag>
+struct counting_heap : immer::cpp_heap
+{
+    static std::atomic<std::size_t> allocations;
+    static std::atomic<std::size_t> vectors;
+
+    template <typename... Tags>
+    static void* allocate(std::size_t size, Tags...)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        return cpp_heap::allocate(size);
+    }
+};
+
+template <typename Tag>
+std::atomic<std::size_t> counting_heap<Tag>::allocations {0};
+template <typename Tag>
+std::atomic<std::size_t> counting_heap<Tag>::vectors {0};
+
+template <typename Heap>
+struct report
+{
+    const char* name;
+
+    ~report()
+    {
+        if (auto n = Heap::vectors.load())
+            std::cerr << name << ": "
+                      << double(Heap::allocations.load()) / n
+                      << " allocations per vector" << std::endl;
+    }
+};
+
+// The benchmark thread builds vectors of `N` elements and hands them
+// over to another thread that drops them, so every node is released
+// by a different thread than the one that allocated it.
+template <typename Heap, typename HeapPolicy>
+auto benchmark_producer_consumer(const char* name)
+{
+    return [name] (nonius::chronometer meter)
+    {
+        using memory_t = immer::memory_policy<HeapPolicy,
+                                              immer::refcount_policy>;
+        using vector_t = immer::vector<unsigned, memory_t>;
+
+        static auto report_ = report<Heap>{name};
+        auto n = meter.param<N>();
+
+        auto queue   = std::deque<vector_t>{};
+        auto dropped = 0u;
+        auto done    = false;
+        std::mutex mutex;
+        std::condition_variable cv;
+        auto consumer = std::thread{[&] {
+            std::unique_lock<std::mutex> lock{mutex};
+            while (true) {
+                cv.wait(lock, [&] { return done || !queue.empty(); });
+                if (queue.empty())
+                    return;
+                auto v = std::move(queue.front());
+                queue.pop_front();
+                lock.unlock();
+                v = {};
+                lock.lock();
+                ++dropped;
+                cv.notify_all();
+            }
+        }};
+
+        meter.measure([&] {
+            for (auto i = 0u; i < vector_count; ++i) {
+                auto v = vector_t{};
+                for (auto j = 0u; j < n; ++j)
+                    v = std::move(v).push_back(j);
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    queue.push_back(std::move(v));
+                }
+                cv.notify_all();
+            }
+            std::unique_lock<std::mutex> lock{mutex};
+            cv.wait(lock, [&] { return dropped == vector_count; });
+            dropped = 0;
+            Heap::vectors.fetch_add(vector_count);
+        });
+
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            done = true;
+        }
+        cv.notify_all();
+        consumer.join();
+    };
+}
+
+using basic_heap       = counting_heap<struct basic_tag>;
+using free_list_heap   = counting_heap<struct free_list_tag>;
+using remote_heap      = counting_heap<struct remote_tag>;
+
+} // anonymous namespace
+
+NONIUS_BENCHMARK("basic", benchmark_producer_consumer<
+                     basic_heap,
+                     immer::heap_policy<basic_heap>>("basic"))
+NONIUS_BENCHMARK("free_list", benchmark_producer_consumer<
+                     free_list_heap,
+                     immer::free_list_heap_policy<free_list_heap>>("free_list"))
+NONIUS_BENCHMARK("remote", benchmark_producer_consumer<
+                     remote_heap,
+                     immer::remote_free_list_heap_policy<remote_heap>>("remote"))
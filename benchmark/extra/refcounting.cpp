@@ -7,6 +7,10 @@
 //
 
 #include <immer/detail/ref_count_base.hpp>
+#include <immer/flex_vector.hpp>
+#include <immer/map.hpp>
+#include <immer/memory_policy.hpp>
+#include <immer/refcount/biased_refcount_policy.hpp>
 
 #include <nonius.h++>
 #include <boost/intrusive_ptr.hpp>
@@ -17,6 +21,7 @@
 #include <memory>
 #include <utility>
 #include <array>
+#include <thread>
 #include <vector>
 
 NONIUS_PARAM(N, std::size_t{1000})
@@ -144,3 +149,107 @@ NONIUS_BENCHMARK("manual - memcopy", [] (nonius::chronometer meter)
         return r;
     });
 })
+
+// Takes and releases a reference to every object, like copying and
+// dropping a node does with its children.
+template <typename RefcountPolicy>
+auto benchmark_policy(bool owned)
+{
+    return [=] (nonius::chronometer meter)
+    {
+        using objs_t = std::array<RefcountPolicy, benchmark_size>;
+        auto objs = std::unique_ptr<objs_t>{};
+        if (owned)
+            objs = std::make_unique<objs_t>();
+        else
+            std::thread{[&] { objs = std::make_unique<objs_t>(); }}.join();
+
+        meter.measure([&] {
+            for (auto& x : *objs)
+                x.inc();
+            for (auto& x : *objs)
+                x.dec();
+            return objs.get();
+        });
+    };
+}
+
+NONIUS_BENCHMARK("policy - refcount",
+                 benchmark_policy<immer::refcount_policy>(true))
+NONIUS_BENCHMARK("policy - unsafe",
+                 benchmark_policy<immer::unsafe_refcount_policy>(true))
+NONIUS_BENCHMARK("policy - biased",
+                 benchmark_policy<immer::biased_refcount_policy>(true))
+NONIUS_BENCHMARK("policy - biased, other thread",
+                 benchmark_policy<immer::biased_refcount_policy>(false))
+
+namespace {
+
+template <typename RefcountPolicy>
+using refcount_memory = immer::memory_policy<
+    immer::free_list_heap_policy<immer::cpp_heap>,
+    RefcountPolicy>;
+
+template <typename RefcountPolicy>
+using flex_t = immer::flex_vector<unsigned, refcount_memory<RefcountPolicy>>;
+
+template <typename RefcountPolicy>
+using map_t = immer::map<unsigned, unsigned, std::hash<unsigned>,
+                         std::equal_to<unsigned>,
+                         refcount_memory<RefcountPolicy>>;
+
+// Updates of an l-value copy the path to the changed element,
+// taking a reference to all the siblings of the copied nodes.
+template <typename RefcountPolicy>
+auto benchmark_flex_vector_update()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        auto v = flex_t<RefcountPolicy>{};
+        for (auto i = 0u; i < n; ++i)
+            v = std::move(v).push_back(i);
+
+        meter.measure([&] {
+            auto r = v;
+            for (auto i = 0u; i < n; ++i)
+                r = r.update(i, [] (auto x) { return x + 1; });
+            return r;
+        });
+    };
+}
+
+template <typename RefcountPolicy>
+auto benchmark_map_update()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        auto m = map_t<RefcountPolicy>{};
+        for (auto i = 0u; i < n; ++i)
+            m = std::move(m).set(i, i);
+
+        meter.measure([&] {
+            auto r = m;
+            for (auto i = 0u; i < n; ++i)
+                r = r.set(i, i + 1);
+            return r;
+        });
+    };
+}
+
+} // anonymous namespace
+
+NONIUS_BENCHMARK("flex_vector - refcount",
+                 benchmark_flex_vector_update<immer::refcount_policy>())
+NONIUS_BENCHMARK("flex_vector - unsafe",
+                 benchmark_flex_vector_update<immer::unsafe_refcount_policy>())
+NONIUS_BENCHMARK("flex_vector - biased",
+                 benchmark_flex_vector_update<immer::biased_refcount_policy>())
+
+NONIUS_BENCHMARK("map - refcount",
+                 benchmark_map_update<immer::refcount_policy>())
+NONIUS_BENCHMARK("map - unsafe",
+                 benchmark_map_update<immer::unsafe_refcount_policy>())
+NONIUS_BENCHMARK("map - biased",
+                 benchmark_map_update<immer::biased_refcount_policy>())
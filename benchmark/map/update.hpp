@@ -0,0 +1,100 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#pragma once
+
+#include "benchmark/config.hpp"
+
+#include <immer/map.hpp>
+#include <immer/map_transient.hpp>
+#include <map>
+#include <unordered_map>
+
+namespace {
+
+template <typename Generator, typename Map>
+auto benchmark_update_mut_std()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        auto g = Generator{}(n);
+        auto v = Map{};
+        for (auto i = 0u; i < n; ++i)
+            v[g[i]] = 0u;
+
+        measure(meter, [&] {
+            auto r = v;
+            for (auto i = 0u; i < n; ++i)
+                ++r[g[i]];
+            return r;
+        });
+    };
+}
+
+template <typename Generator, typename Map>
+auto benchmark_update()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        auto g = Generator{}(n);
+        auto v = Map{};
+        for (auto i = 0u; i < n; ++i)
+            v = v.set(g[i], 0u);
+
+        measure(meter, [&] {
+            auto r = v;
+            for (auto i = 0u; i < n; ++i)
+                r = r.update(g[i], [] (auto x) { return x + 1; });
+            return r;
+        });
+    };
+}
+
+template <typename Generator, typename Map>
+auto benchmark_update_move()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        auto g = Generator{}(n);
+        auto v = Map{};
+        for (auto i = 0u; i < n; ++i)
+            v = v.set(g[i], 0u);
+
+        measure(meter, [&] {
+            auto r = v;
+            for (auto i = 0u; i < n; ++i)
+                r = std::move(r).update(g[i], [] (auto x) { return x + 1; });
+            return r;
+        });
+    };
+}
+
+template <typename Generator, typename Map>
+auto benchmark_update_transient()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        auto g = Generator{}(n);
+        auto v = Map{};
+        for (auto i = 0u; i < n; ++i)
+            v = v.set(g[i], 0u);
+
+        measure(meter, [&] {
+            auto r = v.transient();
+            for (auto i = 0u; i < n; ++i)
+                r.update(g[i], [] (auto x) { return x + 1; });
+            return r.persistent();
+        });
+    };
+}
+
+} // namespace
@@ -10,6 +10,7 @@
 
 #include "benchmark/config.hpp"
 
+#include <immer/cached_hash.hpp>
 #include <immer/set.hpp>
 #include <hash_trie.hpp> // Phil Nash
 #include <boost/container/flat_set.hpp>
@@ -33,6 +33,8 @@ NONIUS_BENCHMARK("boost::flat_set", benchmark_access_std<generator__, boost::con
 NONIUS_BENCHMARK("hamt::hash_trie", benchmark_access_hamt<generator__, hamt::hash_trie<t__>>())
 NONIUS_BENCHMARK("immer::set/5B", benchmark_access<generator__, immer::set<t__, std::hash<t__>,std::equal_to<t__>,def_memory,5>>())
 NONIUS_BENCHMARK("immer::set/4B", benchmark_access<generator__, immer::set<t__, std::hash<t__>,std::equal_to<t__>,def_memory,4>>())
+NONIUS_BENCHMARK("immer::set/FB", benchmark_access<generator__, immer::set<t__, std::hash<t__>,std::equal_to<t__>,fewer_memory,5>>())
+NONIUS_BENCHMARK("immer::set/CH", benchmark_access<generator__, immer::set<t__, immer::cached_hash<std::hash<t__>>,std::equal_to<t__>,def_memory,5>>())
 
 NONIUS_BENCHMARK("bad/std::set", benchmark_bad_access_std<generator__, std::set<t__>>())
 NONIUS_BENCHMARK("bad/std::unordered_set", benchmark_bad_access_std<generator__, std::unordered_set<t__>>())
@@ -40,3 +42,5 @@ NONIUS_BENCHMARK("bad/boost::flat_set", benchmark_bad_access_std<generator__, bo
 NONIUS_BENCHMARK("bad/hamt::hash_trie", benchmark_bad_access_hamt<generator__, hamt::hash_trie<t__>>())
 NONIUS_BENCHMARK("bad/immer::set/5B", benchmark_bad_access<generator__, immer::set<t__, std::hash<t__>,std::equal_to<t__>,def_memory,5>>())
 NONIUS_BENCHMARK("bad/immer::set/4B", benchmark_bad_access<generator__, immer::set<t__, std::hash<t__>,std::equal_to<t__>,def_memory,4>>())
+NONIUS_BENCHMARK("bad/immer::set/FB", benchmark_bad_access<generator__, immer::set<t__, std::hash<t__>,std::equal_to<t__>,fewer_memory,5>>())
+NONIUS_BENCHMARK("bad/immer::set/CH", benchmark_bad_access<generator__, immer::set<t__, immer::cached_hash<std::hash<t__>>,std::equal_to<t__>,def_memory,5>>())
@@ -0,0 +1,100 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#pragma once
+
+#include "benchmark/config.hpp"
+
+#include <immer/set.hpp>
+#include <immer/set_transient.hpp>
+#include <set>
+#include <unordered_set>
+
+namespace {
+
+template <typename Generator, typename Set>
+auto benchmark_erase_mut_std()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        auto g = Generator{}(n);
+        auto v = Set{};
+        for (auto i = 0u; i < n; ++i)
+            v.insert(g[i]);
+
+        measure(meter, [&] {
+            auto r = v;
+            for (auto i = 0u; i < n; ++i)
+                r.erase(g[i]);
+            return r;
+        });
+    };
+}
+
+template <typename Generator, typename Set>
+auto benchmark_erase()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        auto g = Generator{}(n);
+        auto v = Set{};
+        for (auto i = 0u; i < n; ++i)
+            v = v.insert(g[i]);
+
+        measure(meter, [&] {
+            auto r = v;
+            for (auto i = 0u; i < n; ++i)
+                r = r.erase(g[i]);
+            return r;
+        });
+    };
+}
+
+template <typename Generator, typename Set>
+auto benchmark_erase_move()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        auto g = Generator{}(n);
+        auto v = Set{};
+        for (auto i = 0u; i < n; ++i)
+            v = v.insert(g[i]);
+
+        measure(meter, [&] {
+            auto r = v;
+            for (auto i = 0u; i < n; ++i)
+                r = std::move(r).erase(g[i]);
+            return r;
+        });
+    };
+}
+
+template <typename Generator, typename Set>
+auto benchmark_erase_transient()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        auto g = Generator{}(n);
+        auto v = Set{};
+        for (auto i = 0u; i < n; ++i)
+            v = v.insert(g[i]);
+
+        measure(meter, [&] {
+            auto r = v.transient();
+            for (auto i = 0u; i < n; ++i)
+                r.erase(g[i]);
+            return r.persistent();
+        });
+    };
+}
+
+} // namespace
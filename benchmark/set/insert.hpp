@@ -10,7 +10,9 @@
 
 #include "benchmark/config.hpp"
 
+#include <immer/cached_hash.hpp>
 #include <immer/set.hpp>
+#include <immer/set_transient.hpp>
 #include <hash_trie.hpp> // Phil Nash
 #include <boost/container/flat_set.hpp>
 #include <set>
@@ -35,6 +37,23 @@ auto benchmark_insert_mut_std()
     };
 }
 
+template <typename Generator, typename Set>
+auto benchmark_insert_move()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        auto g = Generator{}(n);
+
+        measure(meter, [&] {
+            auto v = Set{};
+            for (auto i = 0u; i < n; ++i)
+                v = std::move(v).insert(g[i]);
+            return v;
+        });
+    };
+}
+
 template <typename Generator, typename Set>
 auto benchmark_insert()
 {
@@ -0,0 +1,54 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#pragma once
+
+#include "benchmark/config.hpp"
+#include "benchmark/set/iter.hpp"
+
+#include <immer/executor.hpp>
+
+namespace {
+
+template <typename Generator, typename Set>
+auto benchmark_reduce_sequential()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        auto g = Generator{}(n);
+        auto v = Set(g.begin(), g.end());
+
+        using step_t = iter_step<typename decltype(g)::value_type>;
+        measure(meter, [&] {
+            volatile auto c = immer::accumulate(v, 0u, step_t{});
+            return c;
+        });
+    };
+}
+
+template <typename Generator, typename Set, unsigned Threads>
+auto benchmark_reduce_parallel()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        auto g = Generator{}(n);
+        auto v = Set(g.begin(), g.end());
+        auto ex = immer::thread_executor{Threads};
+
+        using step_t = iter_step<typename decltype(g)::value_type>;
+        measure(meter, [&] {
+            volatile auto c = immer::accumulate(ex, v, 0u, step_t{},
+                                                std::plus<unsigned>{});
+            return c;
+        });
+    };
+}
+
+} // namespace
@@ -0,0 +1,23 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#include "parallel.hpp"
+
+#ifndef GENERATOR_T
+#error "you must define a GENERATOR_T"
+#endif
+
+using generator__ = GENERATOR_T;
+using t__ = typename decltype(generator__{}(0))::value_type;
+using set__ = immer::set<t__, std::hash<t__>,std::equal_to<t__>,def_memory,5>;
+
+NONIUS_BENCHMARK("immer::set/reduce", benchmark_reduce_sequential<generator__, set__>())
+NONIUS_BENCHMARK("immer::set/reduce/1T", benchmark_reduce_parallel<generator__, set__, 1>())
+NONIUS_BENCHMARK("immer::set/reduce/2T", benchmark_reduce_parallel<generator__, set__, 2>())
+NONIUS_BENCHMARK("immer::set/reduce/4T", benchmark_reduce_parallel<generator__, set__, 4>())
+NONIUS_BENCHMARK("immer::set/reduce/8T", benchmark_reduce_parallel<generator__, set__, 8>())
@@ -89,6 +89,18 @@ NONIUS_BENCHMARK("dvektor/5B/random",  benchmark_access_random<immer::dvektor<un
 NONIUS_BENCHMARK("dvektor/6B/random",  benchmark_access_random<immer::dvektor<unsigned,def_memory,6>>())
 #endif
 
+// Run these with a big N, i.e. N:10000000, to see the effect of huge
+// pages on the TLB misses
+NONIUS_BENCHMARK("vector/5B/idx/basic",      benchmark_access_idx<immer::vector<unsigned,basic_memory,5>>())
+NONIUS_BENCHMARK("vector/5B/idx/safe",       benchmark_access_idx<immer::vector<unsigned,safe_memory,5>>())
+NONIUS_BENCHMARK("vector/5B/idx/huge",       benchmark_access_idx<immer::vector<unsigned,huge_memory,5>>())
+NONIUS_BENCHMARK("vector/5B/random/basic",   benchmark_access_random<immer::vector<unsigned,basic_memory,5>>())
+NONIUS_BENCHMARK("vector/5B/random/safe",    benchmark_access_random<immer::vector<unsigned,safe_memory,5>>())
+NONIUS_BENCHMARK("vector/5B/random/huge",    benchmark_access_random<immer::vector<unsigned,huge_memory,5>>())
+NONIUS_BENCHMARK("flex/F/5B/random/basic",   benchmark_access_random<immer::flex_vector<unsigned,basic_memory,5>,push_front_fn>())
+NONIUS_BENCHMARK("flex/F/5B/random/safe",    benchmark_access_random<immer::flex_vector<unsigned,safe_memory,5>,push_front_fn>())
+NONIUS_BENCHMARK("flex/F/5B/random/huge",    benchmark_access_random<immer::flex_vector<unsigned,huge_memory,5>,push_front_fn>())
+
 #if IMMER_BENCHMARK_BOOST_COROUTINE
 NONIUS_BENCHMARK("vector/5B/coro", benchmark_access_coro<immer::vector<unsigned,def_memory,5>>())
 #endif
@@ -9,6 +9,7 @@
 #include "benchmark/vector/push_front.hpp"
 
 #include <immer/flex_vector.hpp>
+#include <immer/flex_vector_transient.hpp>
 
 #if IMMER_BENCHMARK_LIBRRB
 extern "C" {
@@ -28,3 +29,11 @@ NONIUS_BENCHMARK("flex/GC", bechmark_push_front<immer::flex_vector<unsigned,gc_m
 NONIUS_BENCHMARK("flex_s/GC", bechmark_push_front<immer::flex_vector<std::size_t,gc_memory,5>>())
 NONIUS_BENCHMARK("flex/NO", bechmark_push_front<immer::flex_vector<unsigned,basic_memory,5>>())
 NONIUS_BENCHMARK("flex/UN", bechmark_push_front<immer::flex_vector<unsigned,unsafe_memory,5>>())
+
+NONIUS_BENCHMARK("flex/5B/concat", bechmark_push_front_concat<immer::flex_vector<unsigned,def_memory,5>>())
+NONIUS_BENCHMARK("flex/5B/move", bechmark_push_front_move<immer::flex_vector<unsigned,def_memory,5>>())
+NONIUS_BENCHMARK("flex/5B/transient", bechmark_push_front_transient<immer::flex_vector<unsigned,def_memory,5>>())
+NONIUS_BENCHMARK("flex/GC/transient", bechmark_push_front_transient<immer::flex_vector<unsigned,gc_memory,5>>())
+
+NONIUS_BENCHMARK("pop/flex/5B", bechmark_pop_front<immer::flex_vector<unsigned,def_memory,5>>())
+NONIUS_BENCHMARK("pop/flex/GC", bechmark_pop_front<immer::flex_vector<unsigned,gc_memory,5>>())
@@ -28,6 +28,74 @@ auto bechmark_push_front()
     };
 }
 
+template <typename Vektor>
+auto bechmark_push_front_concat()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+
+        measure(meter, [&] {
+            auto v = Vektor{};
+            for (auto i = 0u; i < n; ++i)
+                v = Vektor{}.push_back(i) + v;
+            return v;
+        });
+    };
+}
+
+template <typename Vektor>
+auto bechmark_push_front_move()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+
+        measure(meter, [&] {
+            auto v = Vektor{};
+            for (auto i = 0u; i < n; ++i)
+                v = std::move(v).push_front(i);
+            return v;
+        });
+    };
+}
+
+template <typename Vektor>
+auto bechmark_push_front_transient()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+
+        measure(meter, [&] {
+            auto v = Vektor{}.transient();
+            for (auto i = 0u; i < n; ++i)
+                v.push_front(i);
+            return v.persistent();
+        });
+    };
+}
+
+template <typename Vektor>
+auto bechmark_pop_front()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+
+        auto v = Vektor{};
+        for (auto i = 0u; i < n; ++i)
+            v = v.push_back(i);
+
+        measure(meter, [&] {
+            auto r = v;
+            for (auto i = 0u; i < n; ++i)
+                r = r.drop(1);
+            return r;
+        });
+    };
+}
+
 auto benchmark_push_front_librrb(nonius::chronometer meter)
 {
     auto n = meter.param<N>();
@@ -8,9 +8,13 @@
 
 #pragma once
 
+#include "detail/type_traits.hpp"
+
 #include <algorithm>
+#include <functional>
 #include <numeric>
 #include <type_traits>
+#include <vector>
 
 namespace immer {
 
@@ -57,6 +61,23 @@ void for_each_chunk(const T* first, const T* last, Fn&& fn)
     std::forward<Fn>(fn)(first, last);
 }
 
+/*!
+ * Apply operation `fn` for every contiguous *chunk* of data in the
+ * `immer::set` or `immer::map` `r` in parallel.  The trie is split in
+ * its top level subtrees, which are traversed in different tasks run
+ * by the executor `ex`, so `fn` may be called concurrently from
+ * several threads.  See `immer/executor.hpp` for the executors.
+ */
+template <typename Executor, typename Range, typename Fn,
+          std::enable_if_t
+          <detail::is_executor_v<Executor>, bool> = true>
+void for_each_chunk(Executor&& ex, const Range& r, Fn&& fn)
+{
+    r.impl().for_each_part_parallel(
+        std::forward<Executor>(ex),
+        [&] (auto, auto&& traverse) { traverse(fn); });
+}
+
 /*!
  * Apply operation `fn` for every contiguous *chunk* of data in the
  * range sequentially, until `fn` returns `false`.  Each time, `Fn` is
@@ -112,6 +133,48 @@ T accumulate(Range&& r, T init, Fn fn)
     return init;
 }
 
+/*!
+ * Equivalent of `std::accumulate` applied to the `immer::set` or
+ * `immer::map` `r`, that traverses it in parallel like
+ * `for_each_chunk(ex, r, fn)`.  Every part of the trie is accumulated
+ * with `fn` starting from `T{}`, and then the results of the parts are
+ * added to `init` in order with `combine`, which must be associative
+ * and have `T{}` as identity.
+ */
+template <typename Executor, typename Range, typename T,
+          typename Fn, typename Combine,
+          std::enable_if_t
+          <detail::is_executor_v<Executor>, bool> = true>
+T accumulate(Executor&& ex, const Range& r, T init, Fn fn, Combine combine)
+{
+    auto parts = std::vector<T>(r.impl().parallel_parts());
+    r.impl().for_each_part_parallel(
+        std::forward<Executor>(ex),
+        [&] (auto i, auto&& traverse) {
+            auto part = T{};
+            traverse([&] (auto first, auto last) {
+                part = std::accumulate(first, last, std::move(part), fn);
+            });
+            parts[i] = std::move(part);
+        });
+    for (auto& part : parts)
+        init = combine(std::move(init), std::move(part));
+    return init;
+}
+
+/*!
+ * Like `accumulate(ex, r, init, fn, combine)`, using `fn` to combine
+ * the results of the parts too.  This is the case of additions and
+ * other operations where the values and the result have the same type.
+ */
+template <typename Executor, typename Range, typename T, typename Fn,
+          std::enable_if_t
+          <detail::is_executor_v<Executor>, bool> = true>
+T accumulate(Executor&& ex, const Range& r, T init, Fn fn)
+{
+    return accumulate(std::forward<Executor>(ex), r, std::move(init), fn, fn);
+}
+
 /*!
  * Equivalent of `std::accumulate` applied to the range @f$ [first,
  * last) @f$.
@@ -209,6 +272,25 @@ bool all_of(Iter first, Iter last, Pred p)
     });
 }
 
+/*!
+ * Compares two versions `a` and `b` of an `immer::set` or an
+ * `immer::map`.  It calls `added` with the values that are only in
+ * `b`, `removed` with the values that are only in `a`, and
+ * `changed` with the values `x` in `a` and `y` in `b` whose key is
+ * the same, but that are different according to `==`.  The subtrees
+ * that are shared by both containers are skipped, so its complexity
+ * depends on how much they differ, not on their size.
+ */
+template <typename Range,
+          typename Added, typename Removed, typename Changed>
+void diff(const Range& a, const Range& b,
+          Added&& added, Removed&& removed, Changed&& changed)
+{
+    using value_t = typename std::decay_t<Range>::value_type;
+    a.impl().template diff<std::equal_to<value_t>>(
+        b.impl(), added, removed, changed);
+}
+
 /** @} */ // group: algorithm
 
 } // namespace immer
@@ -11,6 +11,8 @@
 #include "memory_policy.hpp"
 #include "detail/arrays/with_capacity.hpp"
 
+#include <functional>
+
 namespace immer {
 
 template <typename T, typename MemoryPolicy>
@@ -222,6 +224,28 @@ public:
     decltype(auto) set(size_type index, value_type value) &&
     { return set_move(move_t{}, index, std::move(value)); }
 
+    /*!
+     * Like `set(index, value)`, but when `value` is equal to the
+     * element at position `index`, as compared by `eq`, it returns the
+     * same array without allocating memory.
+     */
+    template <typename Eq = std::equal_to<T>>
+    array set_if_changed(size_type index, value_type value,
+                         Eq&& eq = Eq{}) const&
+    {
+        if (eq(impl_.get(index), value))
+            return *this;
+        return impl_.assoc(index, std::move(value));
+    }
+
+    template <typename Eq = std::equal_to<T>>
+    decltype(auto) set_if_changed(size_type index, value_type value,
+                                  Eq&& eq = Eq{}) &&
+    {
+        return set_if_changed_move(move_t{}, index, std::move(value),
+                                   std::forward<Eq>(eq));
+    }
+
     /*!
      * Returns an array containing the result of the expression
      * `fn((*this)[idx])` at position `idx`.
@@ -296,6 +320,19 @@ private:
     array set_move(std::false_type, size_type index, value_type value)
     { return impl_.assoc(index, std::move(value)); }
 
+    template <typename Eq>
+    array&& set_if_changed_move(std::true_type, size_type index,
+                                value_type value, Eq&& eq)
+    {
+        if (!eq(impl_.get(index), value))
+            impl_.assoc_mut({}, index, std::move(value));
+        return std::move(*this);
+    }
+    template <typename Eq>
+    array set_if_changed_move(std::false_type, size_type index,
+                              value_type value, Eq&& eq)
+    { return set_if_changed(index, std::move(value), std::forward<Eq>(eq)); }
+
     template <typename Fn>
     array&& update_move(std::true_type, size_type index, Fn&& fn)
     { impl_.update_mut({}, index, std::forward<Fn>(fn)); return std::move(*this); }
@@ -10,6 +10,7 @@
 
 #include "detail/util.hpp"
 #include "memory_policy.hpp"
+#include "refcount/deferred_refcount_policy.hpp"
 
 namespace immer {
 
@@ -33,6 +34,22 @@ class box
     };
 
     using heap = typename MemoryPolicy::heap::type;
+    using refcount = typename MemoryPolicy::refcount;
+
+    struct delete_traits
+    {
+        using entry = holder*;
+
+        static constexpr auto max_depth = 1;
+
+        static bool next_child(entry&, entry&) { return false; }
+
+        static void destroy(entry p)
+        {
+            p->~holder();
+            heap::deallocate(sizeof(holder), p);
+        }
+    };
 
     holder* impl_ = nullptr;
 
@@ -83,8 +100,10 @@ public:
     ~box()
     {
         if (impl_ && impl_->dec()) {
-            impl_->~holder();
-            heap::deallocate(sizeof(holder), impl_);
+            if (detail::is_deferred_refcount_v<refcount>)
+                detail::defer_delete_deep<refcount, delete_traits>(impl_);
+            else
+                delete_traits::destroy(impl_);
         }
     }
 
@@ -0,0 +1,34 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#pragma once
+
+#include <functional>
+
+namespace immer {
+
+/*!
+ * Adaptor that makes `immer::set` and `immer::map` store the hash of
+ * every value next to it.  This costs a `std::size_t` per value, but
+ * lookups then compare hashes before calling `Equal`, and values that
+ * are pushed down the tree when their slot gets crowded are not
+ * hashed again.  It pays off when hashing or comparing the values is
+ * expensive, like with long strings.
+ *
+ * Any hash function object can opt-in to this by declaring a `static
+ * constexpr bool cache_hash = true` member instead.
+ *
+ * @tparam Hash The type of the hash function object to wrap.
+ */
+template <typename Hash>
+struct cached_hash : Hash
+{
+    static constexpr bool cache_hash = true;
+};
+
+} // namespace immer
@@ -62,5 +62,10 @@ namespace immer {
 
 const auto default_bits = 5;
 const auto default_free_list_size = 1 << 10;
+const auto default_free_list_shards = 1 << 4;
+const auto cache_line_size = 64;
+const auto default_arena_chunk_size = 1 << 16;
+const auto default_hugepage_region_size = 1 << 21;
+const auto default_epoch_reclaim_interval = 1 << 6;
 
 } // namespace immer
@@ -10,6 +10,8 @@
 
 #include "algorithm.hpp"
 #include "detail/arrays/node.hpp"
+#include "heap/arena_heap.hpp"
+#include "refcount/deferred_refcount_policy.hpp"
 
 namespace immer {
 namespace detail {
@@ -28,7 +30,9 @@ struct no_capacity
     static const no_capacity& empty()
     {
         static const no_capacity empty_ {
-            node_t::make_n(0),
+            without_arena([] {
+                return node_t::make_n(0)->make_immortal();
+            }),
             0,
         };
         return empty_;
@@ -84,8 +88,14 @@ struct no_capacity
     void dec()
     {
         using immer::detail::get;
-        if (ptr->refs().dec())
-            node_t::delete_n(ptr, size, size);
+        if (ptr->refs().dec()) {
+            if (is_deferred_refcount_v<typename MemoryPolicy::refcount>)
+                defer_delete_deep<typename MemoryPolicy::refcount,
+                                  typename node_t::delete_traits>(
+                    {ptr, size, size});
+            else
+                node_t::delete_n(ptr, size, size);
+        }
     }
 
     T* data() { return ptr->data(); }
@@ -50,6 +50,12 @@ struct node
         return auto_const_cast(get<refs_t>(impl));
     }
 
+    node_t* make_immortal()
+    {
+        make_refs_immortal(refs());
+        return this;
+    }
+
     const ownee_t& ownee() const { return get<ownee_t>(impl); }
     ownee_t& ownee()             { return get<ownee_t>(impl); }
 
@@ -68,6 +74,28 @@ struct node
         heap::deallocate(sizeof_n(cap), p);
     }
 
+    /*!
+     * Describes an array to `detail::delete_deep`, which is a tree
+     * of just one node.
+     */
+    struct delete_traits
+    {
+        struct entry
+        {
+            node_t* node;
+            size_t  size;
+            size_t  capacity;
+        };
+
+        static constexpr auto max_depth = 1;
+
+        static bool next_child(entry&, entry&)
+        { return false; }
+
+        static void destroy(const entry& e)
+        { delete_n(e.node, e.size, e.capacity); }
+    };
+
 
     static node_t* make_n(size_t n)
     {
@@ -30,7 +30,9 @@ struct with_capacity
     static const with_capacity& empty()
     {
         static const with_capacity empty_ {
-            node_t::make_n(1),
+            without_arena([] {
+                return node_t::make_n(1)->make_immortal();
+            }),
             0,
             1
         };
@@ -94,8 +96,14 @@ struct with_capacity
     void dec()
     {
         using immer::detail::get;
-        if (ptr->refs().dec())
-            node_t::delete_n(ptr, size, capacity);
+        if (ptr->refs().dec()) {
+            if (is_deferred_refcount_v<typename MemoryPolicy::refcount>)
+                defer_delete_deep<typename MemoryPolicy::refcount,
+                                  typename node_t::delete_traits>(
+                    {ptr, size, capacity});
+            else
+                node_t::delete_n(ptr, size, capacity);
+        }
     }
 
     const T* data() const { return ptr->data(); }
@@ -0,0 +1,82 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <limits>
+
+namespace immer {
+namespace detail {
+
+constexpr auto unlimited_budget = std::numeric_limits<std::size_t>::max();
+
+/*!
+ * Deletes a tree whose root node has just been released, visiting it
+ * depth first with an explicit stack instead of recursion.  `Traits`
+ * describes the tree:
+ *
+ *   - `Traits::entry` is a node that is being deleted together with
+ *     whatever is needed to find its children, and the next child to
+ *     look at.
+ *
+ *   - `Traits::max_depth` bounds the number of levels of the tree.
+ *
+ *   - `Traits::next_child(e, child)` releases the children of `e`,
+ *     starting from the next one, until one of them is dead.  Then,
+ *     it stores it in `child` and returns `true`.  It returns `false`
+ *     once there are no children left.
+ *
+ *   - `Traits::destroy(e)` deallocates the node of `e`, once all its
+ *     children have been processed.
+ *
+ * At most `budget` nodes are deleted.  When the budget is exhausted
+ * before the whole tree is gone, the entries left in the stack are
+ * passed to `suspend`.  Each of them is an independent tree that can
+ * be resumed later, by calling this function again on it.  It returns
+ * the number of nodes that were deleted.
+ */
+template <typename Traits, typename Suspend>
+std::size_t delete_deep(typename Traits::entry root,
+                        std::size_t budget,
+                        Suspend&& suspend)
+{
+    typename Traits::entry stack[Traits::max_depth + 1];
+    auto size    = std::size_t{};
+    auto deleted = std::size_t{};
+    stack[size++] = root;
+    while (size) {
+        if (deleted == budget) {
+            while (size)
+                suspend(stack[--size]);
+            break;
+        }
+        auto& top = stack[size - 1];
+        if (Traits::next_child(top, stack[size])) {
+            ++size;
+            assert(size <= Traits::max_depth);
+        } else {
+            Traits::destroy(top);
+            --size;
+            ++deleted;
+        }
+    }
+    return deleted;
+}
+
+template <typename Traits>
+std::size_t delete_deep(typename Traits::entry root)
+{
+    return delete_deep<Traits>(root, unlimited_budget, [] (auto&&) {
+        assert(!"unreachable");
+    });
+}
+
+} // namespace detail
+} // namespace immer
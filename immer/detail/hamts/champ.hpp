@@ -10,8 +10,15 @@
 
 #include "config.hpp"
 #include "detail/hamts/node.hpp"
+#include "heap/arena_heap.hpp"
+#include "refcount/deferred_refcount_policy.hpp"
 
 #include <algorithm>
+#include <cassert>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <vector>
 
 namespace immer {
 namespace detail {
@@ -27,6 +34,8 @@ struct champ
     static constexpr auto bits = B;
 
     using node_t = node<T, Hash, Equal, MemoryPolicy, B>;
+    using edit_t = typename node_t::edit_t;
+    using owner_t = typename MemoryPolicy::transience_t::owner;
     using bitmap_t = typename get_bitmap_type<B>::type;
 
     static_assert(branches<B> <= sizeof(bitmap_t) * 8, "");
@@ -37,7 +46,9 @@ struct champ
     static const champ& empty()
     {
         static const champ empty_ {
-            node_t::make_inner_n(0),
+            without_arena([] {
+                return node_t::make_inner_n(0)->make_immortal();
+            }),
             0,
         };
         return empty_;
@@ -92,8 +103,14 @@ struct champ
 
     void dec() const
     {
-        if (root->dec())
-            node_t::delete_deep(root, 0);
+        if (root->dec()) {
+            if (is_deferred_refcount_v<typename MemoryPolicy::refcount>)
+                defer_delete_deep<typename MemoryPolicy::refcount,
+                                  typename node_t::delete_traits>(
+                    {root, 0, 0});
+            else
+                node_t::delete_deep(root, 0);
+        }
     }
 
     template <typename Fn>
@@ -102,6 +119,39 @@ struct champ
         for_each_chunk_traversal(root, 0, fn);
     }
 
+    // The parallel traversal splits the trie in parts, the values at
+    // the root and every subtree under it, which are independent.
+    count_t parallel_parts() const
+    {
+        return 1 + popcount(root->nodemap());
+    }
+
+    // Runs `task(i, traverse)` on the executor `ex` for every part `i`
+    // of the trie, where `traverse(fn)` passes every chunk of the part
+    // to `fn`.
+    template <typename Executor, typename Task>
+    void for_each_part_parallel(Executor&& ex, Task&& task) const
+    {
+        auto tasks = std::vector<std::function<void()>>{};
+        tasks.reserve(parallel_parts());
+        tasks.push_back([&] {
+            task(count_t{}, [&] (auto&& fn) {
+                auto datamap = root->datamap();
+                if (datamap)
+                    fn(root->values(), root->values() + popcount(datamap));
+            });
+        });
+        auto children = root->children();
+        for (auto i = count_t{}; i + 1 < parallel_parts(); ++i) {
+            tasks.push_back([&, i] {
+                task(i + 1, [&] (auto&& fn) {
+                    for_each_chunk_traversal(children[i], 1, fn);
+                });
+            });
+        }
+        std::forward<Executor>(ex)(tasks);
+    }
+
     template <typename Fn>
     void for_each_chunk_traversal(node_t* node, count_t depth, Fn&& fn) const
     {
@@ -123,9 +173,16 @@ struct champ
 
     template <typename Project, typename Default, typename K>
     decltype(auto) get(const K& k) const
+    { return get<Project, Default>(k, Hash{}(k)); }
+
+    // The `*_hashed` flavours of the operations take the hash of the
+    // key, that has to be the one computed by `Hash`, so it is not
+    // computed again.
+    template <typename Project, typename Default, typename K>
+    decltype(auto) get(const K& k, hash_t full) const
     {
         auto node = root;
-        auto hash = Hash{}(k);
+        auto hash = full;
         for (auto i = count_t{}; i < max_depth<B>; ++i) {
             auto bit = bitmap_t{1u} << (hash & mask<B>);
             if (node->nodemap() & bit) {
@@ -135,7 +192,7 @@ struct champ
             } else if (node->datamap() & bit) {
                 auto offset = popcount(node->datamap() & (bit - 1));
                 auto val    = node->values() + offset;
-                if (Equal{}(*val, k))
+                if (node->hash_matches(offset, full) && Equal{}(*val, k))
                     return Project{}(*val);
                 else
                     return Default{}();
@@ -186,7 +243,7 @@ struct champ
             } else if (node->datamap() & bit) {
                 auto offset = popcount(node->datamap() & (bit - 1));
                 auto val    = node->values() + offset;
-                if (Equal{}(*val, v))
+                if (node->hash_matches(offset, hash) && Equal{}(*val, v))
                     return {
                         node_t::copy_inner_replace_value(
                             node, offset, std::move(v)),
@@ -195,7 +252,7 @@ struct champ
                 else {
                     auto child = node_t::make_merged(shift + B,
                                                     std::move(v), hash,
-                                                    *val, Hash{}(*val));
+                                                    *val, node->value_hash(offset));
                     try {
                         return {
                             node_t::copy_inner_replace_merged(
@@ -209,7 +266,8 @@ struct champ
                 }
             } else {
                 return {
-                    node_t::copy_inner_insert_value(node, bit, std::move(v)),
+                    node_t::copy_inner_insert_value(
+                        node, bit, std::move(v), hash),
                     true
                 };
             }
@@ -219,11 +277,137 @@ struct champ
     champ add(T v) const
     {
         auto hash = Hash{}(v);
+        return add(std::move(v), hash);
+    }
+
+    champ add(T v, hash_t hash) const
+    {
         auto res = do_add(root, std::move(v), hash, 0);
         auto new_size = size + (res.second ? 1 : 0);
         return { res.first, new_size };
     }
 
+    // The `*_mut` operations update the tree in place, mutating the
+    // nodes that they can mutate with the edit token `e`, and copying
+    // the path to the rest.  `mutated` tells whether the node passed
+    // in was taken over, otherwise the caller still has to release it.
+    struct mut_result
+    {
+        node_t* node;
+        bool added;
+        bool mutated;
+    };
+
+    // Copies the inner node `src`, that can not be mutated, into a new
+    // node owned by `e`.  The copy also references the child at
+    // `offset`, so the child is not unique anymore and the descent
+    // into it will copy it in turn, unless it is owned by `e` too.
+    static node_t* copy_owned(edit_t e, node_t* src, count_t offset)
+    {
+        auto child = src->children() [offset];
+        auto dst   = node_t::copy_inner_replace(src, offset, child);
+        child->inc();
+        return node_t::owned(dst, e);
+    }
+
+    mut_result do_add_mut(edit_t e, node_t* node, T v,
+                          hash_t hash, shift_t shift) const
+    {
+        if (shift == max_shift<B>) {
+            auto fst = node->collisions();
+            auto lst = fst + node->collision_count();
+            for (; fst != lst; ++fst)
+                if (Equal{}(*fst, v)) {
+                    if (node->can_mutate(e)) {
+                        *fst = std::move(v);
+                        return { node, false, true };
+                    } else {
+                        auto r = node_t::copy_collision_replace(
+                            node, fst, std::move(v));
+                        return { node_t::owned(r, e), false, false };
+                    }
+                }
+            auto mutate = node->can_mutate(e);
+            auto r = mutate
+                ? node_t::move_collision_insert(node, std::move(v))
+                : node_t::copy_collision_insert(node, std::move(v));
+            return { node_t::owned(r, e), true, mutate };
+        } else {
+            auto idx = (hash & (mask<B> << shift)) >> shift;
+            auto bit = bitmap_t{1u} << idx;
+            if (node->nodemap() & bit) {
+                auto offset = popcount(node->nodemap() & (bit - 1));
+                auto child  = node->children() [offset];
+                auto mutate = node->can_mutate(e);
+                auto dst    = mutate ? node : copy_owned(e, node, offset);
+                try {
+                    auto result = do_add_mut(e, child, std::move(v), hash,
+                                             shift + B);
+                    dst->children() [offset] = result.node;
+                    if (!result.mutated && child->dec())
+                        node_t::delete_deep_shift(child, shift + B);
+                    return { dst, result.added, mutate };
+                } catch (...) {
+                    if (!mutate)
+                        node_t::delete_deep_shift(dst, shift);
+                    throw;
+                }
+            } else if (node->datamap() & bit) {
+                auto offset = popcount(node->datamap() & (bit - 1));
+                auto val    = node->values() + offset;
+                if (node->hash_matches(offset, hash) && Equal{}(*val, v)) {
+                    if (node->can_mutate(e)) {
+                        node->ensure_mutable_values(e) [offset] = std::move(v);
+                        return { node, false, true };
+                    } else {
+                        auto r = node_t::copy_inner_replace_value(
+                            node, offset, std::move(v));
+                        return { node_t::owned_values(r, e), false, false };
+                    }
+                } else {
+                    auto mutate = node->can_mutate(e);
+                    auto child  = node_t::make_merged(shift + B,
+                                                      std::move(v), hash,
+                                                      *val, node->value_hash(offset));
+                    try {
+                        auto r = mutate
+                            ? node_t::move_inner_replace_merged(
+                                e, node, bit, offset, child)
+                            : node_t::copy_inner_replace_merged(
+                                node, bit, offset, child);
+                        return { node_t::owned_values(r, e), true, mutate };
+                    } catch (...) {
+                        node_t::delete_deep_shift(child, shift + B);
+                        throw;
+                    }
+                }
+            } else {
+                auto mutate = node->can_mutate(e);
+                auto r = mutate
+                    ? node_t::move_inner_insert_value(
+                        e, node, bit, std::move(v), hash)
+                    : node_t::copy_inner_insert_value(
+                        node, bit, std::move(v), hash);
+                return { node_t::owned_values(r, e), true, mutate };
+            }
+        }
+    }
+
+    void add_mut(edit_t e, T v)
+    {
+        auto hash = Hash{}(v);
+        add_mut(e, std::move(v), hash);
+    }
+
+    void add_mut(edit_t e, T v, hash_t hash)
+    {
+        auto res = do_add_mut(e, root, std::move(v), hash, 0);
+        if (!res.mutated)
+            dec();
+        root = res.node;
+        size += res.added ? 1 : 0;
+    }
+
     template <typename Project, typename Default, typename Combine,
               typename K, typename Fn>
     std::pair<node_t*, bool>
@@ -268,7 +452,7 @@ struct champ
             } else if (node->datamap() & bit) {
                 auto offset = popcount(node->datamap() & (bit - 1));
                 auto val    = node->values() + offset;
-                if (Equal{}(*val, k))
+                if (node->hash_matches(offset, hash) && Equal{}(*val, k))
                     return {
                         node_t::copy_inner_replace_value(
                             node, offset, Combine{}(std::forward<K>(k),
@@ -281,7 +465,7 @@ struct champ
                         shift + B, Combine{}(std::forward<K>(k),
                                              std::forward<Fn>(fn)(
                                                  Default{}())),
-                        hash, *val, Hash{}(*val));
+                        hash, *val, node->value_hash(offset));
                     try {
                         return {
                             node_t::copy_inner_replace_merged(
@@ -298,7 +482,8 @@ struct champ
                     node_t::copy_inner_insert_value(
                         node, bit, Combine{}(std::forward<K>(k),
                                              std::forward<Fn>(fn)(
-                                                 Default{}()))),
+                                                 Default{}())),
+                        hash),
                     true
                 };
             }
@@ -316,6 +501,116 @@ struct champ
         return { res.first, new_size };
     }
 
+    template <typename Project, typename Default, typename Combine,
+              typename K, typename Fn>
+    mut_result do_update_mut(edit_t e, node_t* node, K&& k, Fn&& fn,
+                             hash_t hash, shift_t shift) const
+    {
+        if (shift == max_shift<B>) {
+            auto fst = node->collisions();
+            auto lst = fst + node->collision_count();
+            for (; fst != lst; ++fst)
+                if (Equal{}(*fst, k)) {
+                    auto v = Combine{}(std::forward<K>(k),
+                                       std::forward<Fn>(fn)(
+                                           Project{}(*fst)));
+                    if (node->can_mutate(e)) {
+                        *fst = std::move(v);
+                        return { node, false, true };
+                    } else {
+                        auto r = node_t::copy_collision_replace(
+                            node, fst, std::move(v));
+                        return { node_t::owned(r, e), false, false };
+                    }
+                }
+            auto v = Combine{}(std::forward<K>(k),
+                               std::forward<Fn>(fn)(Default{}()));
+            auto mutate = node->can_mutate(e);
+            auto r = mutate
+                ? node_t::move_collision_insert(node, std::move(v))
+                : node_t::copy_collision_insert(node, std::move(v));
+            return { node_t::owned(r, e), true, mutate };
+        } else {
+            auto idx = (hash & (mask<B> << shift)) >> shift;
+            auto bit = bitmap_t{1u} << idx;
+            if (node->nodemap() & bit) {
+                auto offset = popcount(node->nodemap() & (bit - 1));
+                auto child  = node->children() [offset];
+                auto mutate = node->can_mutate(e);
+                auto dst    = mutate ? node : copy_owned(e, node, offset);
+                try {
+                    auto result = do_update_mut<Project, Default, Combine>(
+                        e, child, k, std::forward<Fn>(fn), hash, shift + B);
+                    dst->children() [offset] = result.node;
+                    if (!result.mutated && child->dec())
+                        node_t::delete_deep_shift(child, shift + B);
+                    return { dst, result.added, mutate };
+                } catch (...) {
+                    if (!mutate)
+                        node_t::delete_deep_shift(dst, shift);
+                    throw;
+                }
+            } else if (node->datamap() & bit) {
+                auto offset = popcount(node->datamap() & (bit - 1));
+                auto val    = node->values() + offset;
+                if (node->hash_matches(offset, hash) && Equal{}(*val, k)) {
+                    auto v = Combine{}(std::forward<K>(k),
+                                       std::forward<Fn>(fn)(
+                                           Project{}(*val)));
+                    if (node->can_mutate(e)) {
+                        node->ensure_mutable_values(e) [offset] = std::move(v);
+                        return { node, false, true };
+                    } else {
+                        auto r = node_t::copy_inner_replace_value(
+                            node, offset, std::move(v));
+                        return { node_t::owned_values(r, e), false, false };
+                    }
+                } else {
+                    auto mutate = node->can_mutate(e);
+                    auto child  = node_t::make_merged(
+                        shift + B, Combine{}(std::forward<K>(k),
+                                             std::forward<Fn>(fn)(
+                                                 Default{}())),
+                        hash, *val, node->value_hash(offset));
+                    try {
+                        auto r = mutate
+                            ? node_t::move_inner_replace_merged(
+                                e, node, bit, offset, child)
+                            : node_t::copy_inner_replace_merged(
+                                node, bit, offset, child);
+                        return { node_t::owned_values(r, e), true, mutate };
+                    } catch (...) {
+                        node_t::delete_deep_shift(child, shift + B);
+                        throw;
+                    }
+                }
+            } else {
+                auto v = Combine{}(std::forward<K>(k),
+                                   std::forward<Fn>(fn)(Default{}()));
+                auto mutate = node->can_mutate(e);
+                auto r = mutate
+                    ? node_t::move_inner_insert_value(
+                        e, node, bit, std::move(v), hash)
+                    : node_t::copy_inner_insert_value(
+                        node, bit, std::move(v), hash);
+                return { node_t::owned_values(r, e), true, mutate };
+            }
+        }
+    }
+
+    template <typename Project, typename Default, typename Combine,
+              typename K, typename Fn>
+    void update_mut(edit_t e, const K& k, Fn&& fn)
+    {
+        auto hash = Hash{}(k);
+        auto res = do_update_mut<Project, Default, Combine>(
+            e, root, k, std::forward<Fn>(fn), hash, 0);
+        if (!res.mutated)
+            dec();
+        root = res.node;
+        size += res.added ? 1 : 0;
+    }
+
     // basically:
     //      variant<monostate_t, T*, node_t*>
     // boo bad we are not using... C++17 :'(
@@ -336,9 +631,12 @@ struct champ
 
         kind_t kind;
         data_t data;
+        // the hash of the singleton, when the nodes store them
+        hash_t hash;
 
         sub_result()          : kind{nothing}   {};
-        sub_result(T* x)      : kind{singleton} { data.singleton = x; };
+        sub_result(T* x, hash_t h) : kind{singleton}, hash{h}
+        { data.singleton = x; };
         sub_result(node_t* x) : kind{tree}      { data.tree = x; };
     };
 
@@ -352,7 +650,7 @@ struct champ
                 if (Equal{}(*cur, k))
                     return node->collision_count() > 2
                         ? node_t::copy_collision_remove(node, cur)
-                        : sub_result{fst + (cur == fst)};
+                        : sub_result{fst + (cur == fst), hash};
             return {};
         } else {
             auto idx = (hash & (mask<B> << shift)) >> shift;
@@ -370,7 +668,8 @@ struct champ
                            shift > 0
                         ? result
                         : node_t::copy_inner_replace_inline(
-                            node, bit, offset, *result.data.singleton);
+                            node, bit, offset, *result.data.singleton,
+                            result.hash);
                 case sub_result::tree:
                     try {
                         return node_t::copy_inner_replace(node, offset,
@@ -383,16 +682,18 @@ struct champ
             } else if (node->datamap() & bit) {
                 auto offset = popcount(node->datamap() & (bit - 1));
                 auto val    = node->values() + offset;
-                if (Equal{}(*val, k)) {
+                if (node->hash_matches(offset, hash) && Equal{}(*val, k)) {
                     auto nv = popcount(node->datamap());
                     if (node->nodemap() || nv > 2)
                         return node_t::copy_inner_remove_value(node, bit, offset);
                     else if (nv == 2) {
                         return shift > 0
-                            ? sub_result{node->values() + !offset}
+                            ? sub_result{node->values() + !offset,
+                                         node->stored_hash(!offset)}
                             : node_t::make_inner_n(0,
                                                   node->datamap() & ~bit,
-                                                  node->values()[!offset]);
+                                                  node->values()[!offset],
+                                                  node->stored_hash(!offset));
                     } else {
                         assert(shift == 0);
                         return empty().root->inc();
@@ -405,8 +706,11 @@ struct champ
 
     template <typename K>
     champ sub(const K& k) const
+    { return sub(k, Hash{}(k)); }
+
+    template <typename K>
+    champ sub(const K& k, hash_t hash) const
     {
-        auto hash = Hash{}(k);
         auto res = do_sub(root, k, hash, 0);
         switch (res.kind) {
         case sub_result::nothing:
@@ -421,6 +725,826 @@ struct champ
         }
     }
 
+    // A singleton always points into a node that has not been taken
+    // over, so the caller can still read it before releasing the node.
+    struct sub_mut_result
+    {
+        sub_result result;
+        bool mutated;
+    };
+
+    template <typename K>
+    sub_mut_result do_sub_mut(edit_t e, node_t* node, const K& k,
+                              hash_t hash, shift_t shift) const
+    {
+        if (!node->can_mutate(e))
+            return { do_sub(node, k, hash, shift), false };
+        if (shift == max_shift<B>) {
+            auto fst = node->collisions();
+            auto lst = fst + node->collision_count();
+            for (auto cur = fst; cur != lst; ++cur)
+                if (Equal{}(*cur, k)) {
+                    if (node->collision_count() > 2) {
+                        auto r = node_t::move_collision_remove(node, cur);
+                        return { node_t::owned(r, e), true };
+                    } else
+                        return { sub_result{fst + (cur == fst), hash},
+                                 false };
+                }
+            return {};
+        } else {
+            auto idx = (hash & (mask<B> << shift)) >> shift;
+            auto bit = bitmap_t{1u} << idx;
+            if (node->nodemap() & bit) {
+                auto offset = popcount(node->nodemap() & (bit - 1));
+                auto child  = node->children() [offset];
+                auto result = do_sub_mut(e, child, k, hash, shift + B);
+                switch (result.result.kind) {
+                case sub_result::nothing:
+                    return {};
+                case sub_result::singleton:
+                    if (node->datamap() == 0 &&
+                        popcount(node->nodemap()) == 1 &&
+                        shift > 0)
+                        return { result.result, false };
+                    else {
+                        auto r = node_t::move_inner_replace_inline(
+                            e, node, bit, offset,
+                            *result.result.data.singleton,
+                            result.result.hash);
+                        if (child->dec())
+                            node_t::delete_deep_shift(child, shift + B);
+                        return { node_t::owned_values(r, e), true };
+                    }
+                case sub_result::tree:
+                    node->children() [offset] = result.result.data.tree;
+                    if (!result.mutated && child->dec())
+                        node_t::delete_deep_shift(child, shift + B);
+                    return { node, true };
+                }
+            } else if (node->datamap() & bit) {
+                auto offset = popcount(node->datamap() & (bit - 1));
+                auto val    = node->values() + offset;
+                if (node->hash_matches(offset, hash) && Equal{}(*val, k)) {
+                    auto nv = popcount(node->datamap());
+                    if (node->nodemap() || nv > 2) {
+                        auto r = node_t::move_inner_remove_value(
+                            e, node, bit, offset);
+                        return { node_t::owned_values(r, e), true };
+                    } else if (nv == 2) {
+                        return {
+                            shift > 0
+                                ? sub_result{node->values() + !offset,
+                                             node->stored_hash(!offset)}
+                                : node_t::make_inner_n(0,
+                                                       node->datamap() & ~bit,
+                                                       node->values()[!offset],
+                                                       node->stored_hash(!offset)),
+                            false
+                        };
+                    } else {
+                        assert(shift == 0);
+                        return { empty().root->inc(), false };
+                    }
+                }
+            }
+            return {};
+        }
+    }
+
+    template <typename K>
+    void sub_mut(edit_t e, const K& k)
+    { sub_mut(e, k, Hash{}(k)); }
+
+    template <typename K>
+    void sub_mut(edit_t e, const K& k, hash_t hash)
+    {
+        auto res = do_sub_mut(e, root, k, hash, 0);
+        switch (res.result.kind) {
+        case sub_result::nothing:
+            break;
+        case sub_result::tree:
+            if (!res.mutated)
+                dec();
+            root = res.result.data.tree;
+            --size;
+            break;
+        default:
+            IMMER_UNREACHABLE;
+        }
+    }
+
+    // Applies a batch of updates with an edit token of their own, so
+    // every node in their paths is copied the first time that it is
+    // touched, and then updated in place by the rest of the batch.
+    template <typename Iter, typename Sent>
+    champ add_many(Iter first, Sent last) const
+    {
+        auto e = owner_t{};
+        auto result = *this;
+        result.add_many_mut(e, first, last);
+        return result;
+    }
+
+    template <typename Iter, typename Sent>
+    void add_many_mut(edit_t e, Iter first, Sent last)
+    {
+        for (; first != last; ++first)
+            add_mut(e, *first);
+    }
+
+    template <typename Iter, typename Sent>
+    champ sub_many(Iter first, Sent last) const
+    {
+        auto e = owner_t{};
+        auto result = *this;
+        result.sub_many_mut(e, first, last);
+        return result;
+    }
+
+    template <typename Iter, typename Sent>
+    void sub_many_mut(edit_t e, Iter first, Sent last)
+    {
+        for (; first != last; ++first)
+            sub_mut(e, *first);
+    }
+
+    // Builds the trie bottom-up.  At every level, the values are
+    // distributed by the chunk of their hash with a counting sort,
+    // such that the ones that go under the same child are next to
+    // each other, and then every node is allocated only once, with its
+    // final size.  When some values are equal, the last one is kept.
+    template <typename Iter, typename Sent,
+              std::enable_if_t
+              <compatible_sentinel_v<Iter, Sent>, bool> = true>
+    static champ from_range(Iter first, Sent last)
+    {
+        auto values = std::vector<T>{};
+        for (; first != last; ++first)
+            values.push_back(*first);
+        if (values.empty())
+            return empty();
+        auto entries = std::vector<build_entry>{};
+        entries.reserve(values.size());
+        for (auto& v : values)
+            entries.push_back({ Hash{}(v), &v });
+        auto scratch = std::vector<build_entry>(entries.size());
+        auto size = values.size();
+        auto res  = do_build(entries.data(), entries.data() + entries.size(),
+                             scratch.data(), 0, size);
+        assert(res.kind == sub_result::tree);
+        return { res.data.tree, size };
+    }
+
+    struct build_entry
+    {
+        hash_t hash;
+        T*     value;
+    };
+
+    // Builds the node at `shift` for the values in `[first, last)`,
+    // using the same amount of entries at `scratch` to sort them.  It
+    // decrements `size` for every value that is dropped because a later
+    // one is equal to it.
+    static sub_result do_build(build_entry* first, build_entry* last,
+                               build_entry* scratch, shift_t shift,
+                               size_t& size)
+    {
+        if (shift == max_shift<B>) {
+            auto n = count_t{};
+            for (auto it = first; it != last; ++it) {
+                auto later = std::find_if(it + 1, last, [&] (auto& e) {
+                    return Equal{}(*e.value, *it->value);
+                });
+                if (later == last)
+                    first[n++] = *it;
+            }
+            size -= (last - first) - n;
+            if (n == 1)
+                return { first->value, first->hash };
+            auto node = node_t::make_collision_n(n);
+            auto i    = count_t{};
+            try {
+                for (; i < n; ++i)
+                    new (node->collisions() + i) T{std::move(*first[i].value)};
+            } catch (...) {
+                destroy_n(node->collisions(), i);
+                node_t::deallocate_collision(node, n);
+                throw;
+            }
+            return node;
+        } else {
+            size_t offsets[branches<B> + 1] = {};
+            for (auto it = first; it != last; ++it)
+                ++offsets[((it->hash >> shift) & mask<B>) + 1];
+            for (auto i = count_t{}; i < branches<B>; ++i)
+                offsets[i + 1] += offsets[i];
+            size_t next[branches<B>];
+            std::copy(offsets, offsets + branches<B>, next);
+            for (auto it = first; it != last; ++it)
+                scratch[next[(it->hash >> shift) & mask<B>]++] = *it;
+            node_builder builder{shift};
+            for (auto i = count_t{}; i < branches<B>; ++i) {
+                auto count = offsets[i + 1] - offsets[i];
+                auto bit   = bitmap_t{1u} << i;
+                auto group = scratch + offsets[i];
+                if (count == 1)
+                    builder.add_value(bit, group->value, group->hash);
+                else if (count > 1)
+                    builder.add(bit, do_build(group, group + count,
+                                              first + offsets[i],
+                                              shift + B, size));
+            }
+            if (shift > 0 && !builder.nodemap && builder.nv == 1)
+                return { builder.values[0], builder.hashes[0] };
+            std::move_iterator<T*> values[branches<B>];
+            for (auto i = count_t{}; i < builder.nv; ++i)
+                values[i] = std::make_move_iterator(builder.values[i]);
+            auto node = node_t::make_inner_from(builder.datamap,
+                                                builder.nodemap,
+                                                values,
+                                                builder.hashes,
+                                                builder.children);
+            builder.n = 0;
+            return node;
+        }
+    }
+
+    // The set operations walk both tries together, and they reuse
+    // whole the subtrees that are the same in both of them, and the
+    // nodes of the result that would be equal to the ones in `a` or
+    // `b`.  This way, they only allocate where the inputs differ.
+    // The size of the result is tracked as a difference with the size
+    // of `a`, so the shared subtrees do not need to be counted.
+
+    // Gathers the values and the children of an inner node of the
+    // result, in the order of their bits.  The children are
+    // references, that are released unless they are taken by
+    // `finish()`.
+    struct node_builder
+    {
+        shift_t  shift;
+        bitmap_t datamap = 0;
+        bitmap_t nodemap = 0;
+        count_t  nv      = 0;
+        count_t  n       = 0;
+        T*       values[branches<B>];
+        T*       alts[branches<B>];
+        hash_t   hashes[branches<B>];
+        node_t*  children[branches<B>];
+
+        node_builder(shift_t s) : shift{s} {}
+        node_builder(const node_builder&) = delete;
+
+        ~node_builder()
+        {
+            for (auto i = count_t{}; i < n; ++i)
+                if (children[i]->dec())
+                    node_t::delete_deep_shift(children[i], shift + B);
+        }
+
+        // `alt` is an equivalent value in the other trie, if any.
+        void add_value(bitmap_t bit, T* v, hash_t hash, T* alt = nullptr)
+        {
+            datamap |= bit;
+            values[nv] = v;
+            alts[nv] = alt;
+            hashes[nv++] = hash;
+        }
+
+        void add_child(bitmap_t bit, node_t* child)
+        {
+            nodemap |= bit;
+            children[n++] = child;
+        }
+
+        void add(bitmap_t bit, const sub_result& r)
+        {
+            switch (r.kind) {
+            case sub_result::nothing:
+                break;
+            case sub_result::singleton:
+                add_value(bit, r.data.singleton, r.hash);
+                break;
+            case sub_result::tree:
+                add_child(bit, r.data.tree);
+                break;
+            }
+        }
+
+        bool same_as(const node_t* x) const
+        {
+            if (datamap != x->datamap() || nodemap != x->nodemap())
+                return false;
+            for (auto i = count_t{}; i < nv; ++i)
+                if (values[i] != x->values() + i &&
+                    alts[i] != x->values() + i)
+                    return false;
+            return std::equal(children, children + n, x->children());
+        }
+
+        // Like in `do_sub`, a single value is moved up to the parent.
+        sub_result finish(node_t* a, node_t* b = nullptr)
+        {
+            if (!datamap && !nodemap)
+                return {};
+            else if (shift > 0 && !nodemap && nv == 1)
+                return { values[0], hashes[0] };
+            else if (same_as(a))
+                return a->inc();
+            else if (b && same_as(b))
+                return b->inc();
+            auto r = node_t::make_inner_from(datamap, nodemap,
+                                             values, hashes, children);
+            n = 0;
+            return r;
+        }
+    };
+
+    // Holds the values made by the combining function of `merge`, that
+    // are neither of its arguments, until they are copied to a node.
+    struct merge_buffer
+    {
+        aligned_storage_for<T> data[branches<B>];
+        count_t size = 0;
+
+        merge_buffer() = default;
+        merge_buffer(const merge_buffer&) = delete;
+        ~merge_buffer() { destroy_n((T*) &data[0], size); }
+
+        template <typename U>
+        T* push(U&& v)
+        {
+            auto p = new (&data[size]) T{std::forward<U>(v)};
+            ++size;
+            return p;
+        }
+    };
+
+    static size_t count_deep(const node_t* node, shift_t shift)
+    {
+        if (shift == max_shift<B>)
+            return node->collision_count();
+        auto r = size_t{popcount(node->datamap())};
+        auto n = popcount(node->nodemap());
+        for (auto i = count_t{}; i < n; ++i)
+            r += count_deep(node->children()[i], shift + B);
+        return r;
+    }
+
+    template <typename K>
+    static T* find_at(node_t* node, const K& k, hash_t hash, shift_t shift)
+    {
+        for (; shift < max_shift<B>; shift += B) {
+            auto idx = (hash & (mask<B> << shift)) >> shift;
+            auto bit = bitmap_t{1u} << idx;
+            if (node->nodemap() & bit) {
+                auto offset = popcount(node->nodemap() & (bit - 1));
+                node = node->children() [offset];
+            } else if (node->datamap() & bit) {
+                auto offset = popcount(node->datamap() & (bit - 1));
+                auto val    = node->values() + offset;
+                return node->hash_matches(offset, hash) && Equal{}(*val, k)
+                    ? val
+                    : nullptr;
+            } else
+                return nullptr;
+        }
+        auto fst = node->collisions();
+        auto lst = fst + node->collision_count();
+        for (; fst != lst; ++fst)
+            if (Equal{}(*fst, k))
+                return fst;
+        return nullptr;
+    }
+
+    static T* find_collision(node_t* node, const T& v)
+    {
+        auto fst = node->collisions();
+        auto lst = fst + node->collision_count();
+        for (; fst != lst; ++fst)
+            if (Equal{}(*fst, v))
+                return fst;
+        return nullptr;
+    }
+
+    // Adds the value `v` of one trie to the subtree `node` of the
+    // other, that may contain it already.
+    template <typename Fn>
+    node_t* merge_value(node_t* node, T* v, hash_t hash, shift_t shift,
+                        bool v_in_a, Fn&& fn, size_t& added) const
+    {
+        auto found = find_at(node, *v, hash, shift);
+        if (v_in_a)
+            added += count_deep(node, shift) - (found ? 1 : 0);
+        else if (!found)
+            ++added;
+        if (!found)
+            return do_add(node, *v, hash, shift).first;
+        auto&& r = v_in_a ? fn(*v, *found) : fn(*found, *v);
+        if (std::addressof(r) == found ||
+            (v_in_a && std::addressof(r) == v))
+            return node->inc();
+        return do_add(node, std::forward<decltype(r)>(r), hash, shift).first;
+    }
+
+    template <typename Fn>
+    node_t* merge_collisions(node_t* a, node_t* b, Fn&& fn,
+                             size_t& added) const
+    {
+        auto na    = a->collision_count();
+        auto nb    = b->collision_count();
+        auto extra = count_t{};
+        for (auto i = count_t{}; i < nb; ++i)
+            if (!find_collision(a, b->collisions()[i]))
+                ++extra;
+        auto dst  = node_t::make_collision_n(na + extra);
+        auto dstp = dst->collisions();
+        auto i    = count_t{};
+        try {
+            for (; i < na; ++i) {
+                auto va = a->collisions() + i;
+                if (auto vb = find_collision(b, *va))
+                    new (dstp + i) T{fn(*va, *vb)};
+                else
+                    new (dstp + i) T{*va};
+            }
+            for (auto j = count_t{}; j < nb; ++j) {
+                auto vb = b->collisions() + j;
+                if (!find_collision(a, *vb))
+                    new (dstp + i++) T{*vb};
+            }
+        } catch (...) {
+            destroy_n(dstp, i);
+            node_t::heap::deallocate(node_t::sizeof_collision_n(na + extra),
+                                     dst);
+            throw;
+        }
+        added += extra;
+        return dst;
+    }
+
+    template <typename Fn>
+    sub_result do_merge(node_t* a, node_t* b, shift_t shift,
+                        Fn&& fn, size_t& added) const
+    {
+        if (a == b)
+            return a->inc();
+        else if (shift == max_shift<B>)
+            return merge_collisions(a, b, fn, added);
+        merge_buffer buffer;
+        node_builder builder{shift};
+        for (auto idx = count_t{}; idx < branches<B>; ++idx) {
+            auto bit    = bitmap_t{1u} << idx;
+            auto a_node = a->nodemap() & bit;
+            auto b_node = b->nodemap() & bit;
+            auto a_val  = a->datamap() & bit;
+            auto b_val  = b->datamap() & bit;
+            auto ca = popcount(a->nodemap() & (bit - 1));
+            auto cb = popcount(b->nodemap() & (bit - 1));
+            auto oa = popcount(a->datamap() & (bit - 1));
+            auto ob = popcount(b->datamap() & (bit - 1));
+            if (a_node && b_node) {
+                builder.add(bit, do_merge(a->children()[ca],
+                                          b->children()[cb],
+                                          shift + B, fn, added));
+            } else if (a_node && b_val) {
+                builder.add_child(bit, merge_value(
+                    a->children()[ca], b->values() + ob,
+                    b->value_hash(ob), shift + B, false, fn, added));
+            } else if (a_val && b_node) {
+                builder.add_child(bit, merge_value(
+                    b->children()[cb], a->values() + oa,
+                    a->value_hash(oa), shift + B, true, fn, added));
+            } else if (a_val && b_val) {
+                auto va = a->values() + oa;
+                auto vb = b->values() + ob;
+                if (a->hash_matches(oa, b->stored_hash(ob)) &&
+                    Equal{}(*va, *vb)) {
+                    auto&& r = fn(*va, *vb);
+                    if (std::addressof(r) == va)
+                        builder.add_value(bit, va, a->stored_hash(oa), vb);
+                    else if (std::addressof(r) == vb)
+                        builder.add_value(bit, vb, b->stored_hash(ob));
+                    else
+                        builder.add_value(
+                            bit, buffer.push(std::forward<decltype(r)>(r)),
+                            a->stored_hash(oa));
+                } else {
+                    ++added;
+                    builder.add_child(bit, node_t::make_merged(
+                        shift + B,
+                        *va, a->value_hash(oa),
+                        *vb, b->value_hash(ob)));
+                }
+            } else if (a_node) {
+                builder.add_child(bit, a->children()[ca]->inc());
+            } else if (a_val) {
+                builder.add_value(bit, a->values() + oa, a->stored_hash(oa));
+            } else if (b_node) {
+                added += count_deep(b->children()[cb], shift + B);
+                builder.add_child(bit, b->children()[cb]->inc());
+            } else if (b_val) {
+                ++added;
+                builder.add_value(bit, b->values() + ob, b->stored_hash(ob));
+            }
+        }
+        return builder.finish(a, b);
+    }
+
+    /*!
+     * Returns the union of this trie and `other`.  The values that
+     * are in both are replaced by `fn(a, b)`.  When it returns a
+     * reference to one of its arguments, the subtrees that contain it
+     * can be reused.  Returning `a` means that `a` and `b` are
+     * interchangeable, so the subtrees of either trie can be reused.
+     */
+    template <typename Fn>
+    champ merge(const champ& other, Fn&& fn) const
+    {
+        auto added = size_t{};
+        auto res   = do_merge(root, other.root, 0, fn, added);
+        assert(res.kind == sub_result::tree);
+        return { res.data.tree, size + added };
+    }
+
+    sub_result do_intersect(node_t* a, node_t* b, shift_t shift,
+                            size_t& removed) const
+    {
+        if (a == b)
+            return a->inc();
+        else if (shift == max_shift<B>)
+            return filter_collisions(a, b, true, removed);
+        node_builder builder{shift};
+        for (auto idx = count_t{}; idx < branches<B>; ++idx) {
+            auto bit    = bitmap_t{1u} << idx;
+            auto a_node = a->nodemap() & bit;
+            auto b_node = b->nodemap() & bit;
+            auto a_val  = a->datamap() & bit;
+            auto b_val  = b->datamap() & bit;
+            auto ca = popcount(a->nodemap() & (bit - 1));
+            auto cb = popcount(b->nodemap() & (bit - 1));
+            auto oa = popcount(a->datamap() & (bit - 1));
+            auto ob = popcount(b->datamap() & (bit - 1));
+            if (a_node && b_node) {
+                builder.add(bit, do_intersect(a->children()[ca],
+                                              b->children()[cb],
+                                              shift + B, removed));
+            } else if (a_node && b_val) {
+                auto child = a->children()[ca];
+                auto found = find_at(child, b->values()[ob],
+                                     b->value_hash(ob), shift + B);
+                removed += count_deep(child, shift + B) - (found ? 1 : 0);
+                if (found)
+                    builder.add_value(bit, found, b->stored_hash(ob));
+            } else if (a_val && b_node) {
+                auto va = a->values() + oa;
+                if (find_at(b->children()[cb], *va,
+                            a->value_hash(oa), shift + B))
+                    builder.add_value(bit, va, a->stored_hash(oa));
+                else
+                    ++removed;
+            } else if (a_val && b_val) {
+                auto va = a->values() + oa;
+                if (a->hash_matches(oa, b->stored_hash(ob)) &&
+                    Equal{}(*va, b->values()[ob]))
+                    builder.add_value(bit, va, a->stored_hash(oa));
+                else
+                    ++removed;
+            } else if (a_node) {
+                removed += count_deep(a->children()[ca], shift + B);
+            } else if (a_val) {
+                ++removed;
+            }
+        }
+        return builder.finish(a);
+    }
+
+    /*!
+     * Returns the values of this trie that are also in `other`.
+     */
+    champ intersect(const champ& other) const
+    {
+        auto removed = size_t{};
+        auto res     = do_intersect(root, other.root, 0, removed);
+        return make_result(res, size - removed);
+    }
+
+    sub_result do_difference(node_t* a, node_t* b, shift_t shift,
+                             size_t& removed) const
+    {
+        if (a == b) {
+            removed += count_deep(a, shift);
+            return {};
+        } else if (shift == max_shift<B>)
+            return filter_collisions(a, b, false, removed);
+        node_builder builder{shift};
+        for (auto idx = count_t{}; idx < branches<B>; ++idx) {
+            auto bit    = bitmap_t{1u} << idx;
+            auto a_node = a->nodemap() & bit;
+            auto b_node = b->nodemap() & bit;
+            auto a_val  = a->datamap() & bit;
+            auto b_val  = b->datamap() & bit;
+            auto ca = popcount(a->nodemap() & (bit - 1));
+            auto cb = popcount(b->nodemap() & (bit - 1));
+            auto oa = popcount(a->datamap() & (bit - 1));
+            auto ob = popcount(b->datamap() & (bit - 1));
+            if (a_node && b_node) {
+                builder.add(bit, do_difference(a->children()[ca],
+                                               b->children()[cb],
+                                               shift + B, removed));
+            } else if (a_node && b_val) {
+                auto child = a->children()[ca];
+                auto res   = do_sub(child, b->values()[ob],
+                                    b->value_hash(ob), shift + B);
+                if (res.kind == sub_result::nothing)
+                    builder.add_child(bit, child->inc());
+                else {
+                    ++removed;
+                    builder.add(bit, res);
+                }
+            } else if (a_val && b_node) {
+                auto va = a->values() + oa;
+                if (find_at(b->children()[cb], *va,
+                            a->value_hash(oa), shift + B))
+                    ++removed;
+                else
+                    builder.add_value(bit, va, a->stored_hash(oa));
+            } else if (a_val && b_val) {
+                auto va = a->values() + oa;
+                if (a->hash_matches(oa, b->stored_hash(ob)) &&
+                    Equal{}(*va, b->values()[ob]))
+                    ++removed;
+                else
+                    builder.add_value(bit, va, a->stored_hash(oa));
+            } else if (a_node) {
+                builder.add_child(bit, a->children()[ca]->inc());
+            } else if (a_val) {
+                builder.add_value(bit, a->values() + oa, a->stored_hash(oa));
+            }
+        }
+        return builder.finish(a);
+    }
+
+    /*!
+     * Returns the values of this trie that are not in `other`.
+     */
+    champ difference(const champ& other) const
+    {
+        auto removed = size_t{};
+        auto res     = do_difference(root, other.root, 0, removed);
+        return make_result(res, size - removed);
+    }
+
+    // Keeps the values of the collision node `a` that are in `b`, or
+    // the ones that are not, depending on `keep_found`.
+    sub_result filter_collisions(node_t* a, node_t* b, bool keep_found,
+                                 size_t& removed) const
+    {
+        auto na   = a->collision_count();
+        auto keep = [&] (const T& v) {
+            return (find_collision(b, v) != nullptr) == keep_found;
+        };
+        auto fst = a->collisions();
+        auto n   = static_cast<count_t>(std::count_if(fst, fst + na, keep));
+        removed += na - n;
+        if (n == na)
+            return a->inc();
+        else if (n == 0)
+            return {};
+        else if (n == 1) {
+            auto v = std::find_if(fst, fst + na, keep);
+            return { v, node_t::store_hashes ? Hash{}(*v) : 0 };
+        } else
+            return node_t::copy_collision_filter(a, n, keep);
+    }
+
+    static champ make_result(const sub_result& res, size_t size)
+    {
+        switch (res.kind) {
+        case sub_result::nothing:
+            return empty();
+        case sub_result::tree:
+            return { res.data.tree, size };
+        default:
+            IMMER_UNREACHABLE;
+        }
+    }
+
+    template <typename Fn>
+    static void for_each_deep(const node_t* node, shift_t shift, Fn&& fn)
+    {
+        if (shift == max_shift<B>) {
+            auto fst = node->collisions();
+            auto lst = fst + node->collision_count();
+            for (; fst != lst; ++fst)
+                fn(*fst);
+        } else {
+            auto fst = node->values();
+            auto lst = fst + popcount(node->datamap());
+            for (; fst != lst; ++fst)
+                fn(*fst);
+            auto n = popcount(node->nodemap());
+            for (auto i = count_t{}; i < n; ++i)
+                for_each_deep(node->children()[i], shift + B, fn);
+        }
+    }
+
+    /*!
+     * Calls `added`, `removed` and `changed` with the values that are
+     * only in `other`, only in this trie, or in both but different
+     * according to `Eq`.  Like `equals`, it skips the subtrees that
+     * are shared by both tries.
+     */
+    template <typename Eq,
+              typename Added, typename Removed, typename Changed>
+    void diff(const champ& other,
+              Added&& added, Removed&& removed, Changed&& changed) const
+    {
+        diff_tree<Eq>(root, other.root, 0, added, removed, changed);
+    }
+
+    template <typename Eq,
+              typename Added, typename Removed, typename Changed>
+    static void diff_tree(node_t* a, node_t* b, shift_t shift,
+                          Added& added, Removed& removed, Changed& changed)
+    {
+        if (a == b)
+            return;
+        else if (shift == max_shift<B>) {
+            for_each_deep(a, shift, [&] (const T& x) {
+                auto y = find_collision(b, x);
+                if (!y)
+                    removed(x);
+                else if (!Eq{}(x, *y))
+                    changed(x, *y);
+            });
+            for_each_deep(b, shift, [&] (const T& y) {
+                if (!find_collision(a, y))
+                    added(y);
+            });
+            return;
+        }
+        for (auto idx = count_t{}; idx < branches<B>; ++idx) {
+            auto bit    = bitmap_t{1u} << idx;
+            auto a_node = a->nodemap() & bit;
+            auto b_node = b->nodemap() & bit;
+            auto a_val  = a->datamap() & bit;
+            auto b_val  = b->datamap() & bit;
+            auto ca = popcount(a->nodemap() & (bit - 1));
+            auto cb = popcount(b->nodemap() & (bit - 1));
+            auto oa = popcount(a->datamap() & (bit - 1));
+            auto ob = popcount(b->datamap() & (bit - 1));
+            if (a_node && b_node) {
+                diff_tree<Eq>(a->children()[ca], b->children()[cb],
+                              shift + B, added, removed, changed);
+            } else if (a_node && b_val) {
+                auto child = a->children()[ca];
+                auto& y    = b->values()[ob];
+                auto found = find_at(child, y, b->value_hash(ob), shift + B);
+                for_each_deep(child, shift + B, [&] (const T& x) {
+                    if (&x != found)
+                        removed(x);
+                    else if (!Eq{}(x, y))
+                        changed(x, y);
+                });
+                if (!found)
+                    added(y);
+            } else if (a_val && b_node) {
+                auto child = b->children()[cb];
+                auto& x    = a->values()[oa];
+                auto found = find_at(child, x, a->value_hash(oa), shift + B);
+                for_each_deep(child, shift + B, [&] (const T& y) {
+                    if (&y != found)
+                        added(y);
+                    else if (!Eq{}(x, y))
+                        changed(x, y);
+                });
+                if (!found)
+                    removed(x);
+            } else if (a_val && b_val) {
+                auto& x = a->values()[oa];
+                auto& y = b->values()[ob];
+                if (a->hash_matches(oa, b->stored_hash(ob)) &&
+                    Equal{}(x, y)) {
+                    if (!Eq{}(x, y))
+                        changed(x, y);
+                } else {
+                    removed(x);
+                    added(y);
+                }
+            } else if (a_node) {
+                for_each_deep(a->children()[ca], shift + B, removed);
+            } else if (a_val) {
+                removed(a->values()[oa]);
+            } else if (b_node) {
+                for_each_deep(b->children()[cb], shift + B, added);
+            } else if (b_val) {
+                added(b->values()[ob]);
+            }
+        }
+    }
+
     template <typename Eq=Equal>
     bool equals(const champ& other) const
     {
@@ -9,10 +9,15 @@
 #pragma once
 
 #include "detail/combine_standard_layout.hpp"
+#include "detail/delete_deep.hpp"
+#include "detail/type_traits.hpp"
 #include "detail/util.hpp"
 #include "detail/hamts/bits.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <iterator>
+#include <type_traits>
 
 #ifdef NDEBUG
 #define IMMER_HAMTS_TAGGED_NODE 0
@@ -24,6 +29,18 @@ namespace immer {
 namespace detail {
 namespace hamts {
 
+/*!
+ * Whether the nodes keep the hash of their values next to them.  This
+ * is the case when the `Hash` function declares a `static constexpr
+ * bool cache_hash` member that is `true`.
+ */
+template <typename Hash, typename Enable=void>
+struct get_cache_hash : std::false_type {};
+
+template <typename Hash>
+struct get_cache_hash<Hash, void_t<decltype(Hash::cache_hash)>>
+    : std::integral_constant<bool, Hash::cache_hash> {};
+
 template <typename T,
           typename Hash,
           typename Equal,
@@ -43,6 +60,9 @@ struct node
     using value_t     = T;
     using bitmap_t    = typename get_bitmap_type<B>::type;
 
+    static constexpr bool embed_values = memory::prefer_fewer_bigger_objects;
+    static constexpr bool store_hashes = get_cache_hash<Hash>::value;
+
     enum class kind_t
     {
         collision,
@@ -60,8 +80,15 @@ struct node
         aligned_storage_for<T> buffer;
     };
 
-    using values_t = combine_standard_layout_t<
-        values_data_t, refs_t>;
+    using values_data_with_meta_t =
+        combine_standard_layout_t<values_data_t, refs_t, ownee_t>;
+
+    using values_data_no_meta_t =
+        combine_standard_layout_t<values_data_t>;
+
+    using values_t = std::conditional_t<embed_values,
+                                        values_data_no_meta_t,
+                                        values_data_with_meta_t>;
 
     struct inner_t
     {
@@ -86,14 +113,24 @@ struct node
     };
 
     using impl_t = combine_standard_layout_t<
-        impl_data_t, refs_t>;
+        impl_data_t, refs_t, ownee_t>;
 
     impl_t impl;
 
+    constexpr static std::size_t hashes_offset(count_t count)
+    {
+        return (immer_offsetof(values_t, d.buffer)
+                + sizeof(values_data_t::buffer) * count
+                + alignof(hash_t) - 1)
+            & ~(alignof(hash_t) - 1);
+    }
+
     constexpr static std::size_t sizeof_values_n(count_t count)
     {
-        return immer_offsetof(values_t, d.buffer)
-            + sizeof(values_data_t::buffer) * count;
+        return store_hashes
+            ? hashes_offset(count) + sizeof(hash_t) * count
+            : immer_offsetof(values_t, d.buffer)
+              + sizeof(values_data_t::buffer) * count;
     }
 
     constexpr static std::size_t sizeof_collision_n(count_t count)
@@ -108,6 +145,19 @@ struct node
             + sizeof(inner_t::buffer) * count;
     }
 
+    constexpr static std::size_t embedded_values_offset(count_t count)
+    {
+        return (sizeof_inner_n(count) + alignof(values_t) - 1)
+            & ~(alignof(values_t) - 1);
+    }
+
+    constexpr static std::size_t sizeof_inner_n(count_t count, count_t nv)
+    {
+        return embed_values && nv
+            ? embedded_values_offset(count) + sizeof_values_n(nv)
+            : sizeof_inner_n(count);
+    }
+
 #if IMMER_HAMTS_TAGGED_NODE
     kind_t kind() const
     {
@@ -127,6 +177,54 @@ struct node
         return (const T*) &impl.d.data.inner.values->d.buffer;
     }
 
+    /*!
+     * When `store_hashes`, the `nv` values in `vp` are followed by
+     * their hashes.
+     */
+    static hash_t* hashes(const values_t* vp, count_t nv)
+    {
+        return (hash_t*) ((const char*) vp + hashes_offset(nv));
+    }
+
+    hash_t* hashes()
+    {
+        assert(kind() == kind_t::inner);
+        return hashes(impl.d.data.inner.values, popcount(datamap()));
+    }
+
+    const hash_t* hashes() const
+    {
+        assert(kind() == kind_t::inner);
+        return hashes(impl.d.data.inner.values, popcount(datamap()));
+    }
+
+    /*!
+     * Returns the hash of the value at `offset`, or `0` when the
+     * hashes are not stored.
+     */
+    hash_t stored_hash(count_t offset) const
+    {
+        return store_hashes ? hashes()[offset] : 0;
+    }
+
+    /*!
+     * Returns the hash of the value at `offset`, computing it only
+     * when it is not stored.
+     */
+    hash_t value_hash(count_t offset) const
+    {
+        return store_hashes ? hashes()[offset] : Hash{}(values()[offset]);
+    }
+
+    /*!
+     * Whether the value at `offset` may be equal to a value with hash
+     * `hash`.  It is always the case when the hashes are not stored.
+     */
+    bool hash_matches(count_t offset, hash_t hash) const
+    {
+        return !store_hashes || hashes()[offset] == hash;
+    }
+
     auto children()
     {
         assert(kind() == kind_t::inner);
@@ -180,7 +278,11 @@ struct node
     static node_t* make_inner_n(count_t n)
     {
         assert(n <= branches<B>);
-        auto m = heap::allocate(sizeof_inner_n(n));
+        return make_inner_at(heap::allocate(sizeof_inner_n(n)));
+    }
+
+    static node_t* make_inner_at(void* m)
+    {
         auto p = new (m) node_t;
 #if IMMER_HAMTS_TAGGED_NODE
         p->impl.d.kind = node_t::kind_t::inner;
@@ -191,24 +293,54 @@ struct node
         return p;
     }
 
-    static node_t* make_inner_n(count_t n, values_t* values)
+    /*!
+     * Makes an inner node with room for `n` children and the values
+     * of `src`.  The values are shared with `src`, unless they are
+     * embedded in the nodes, in which case they are copied.
+     */
+    static node_t* make_inner_n(count_t n, const node_t* src)
     {
-        auto p = make_inner_n(n);
-        if (values) {
-            p->impl.d.data.inner.values = values;
-            refs(values).inc();
-        }
-        return p;
+        return static_if<embed_values, node_t*>(
+            [&] (auto) {
+                auto nv = popcount(src->datamap());
+                auto p  = make_inner_n(n, nv);
+                try {
+                    std::uninitialized_copy(
+                        src->values(), src->values() + nv, p->values());
+                } catch (...) {
+                    heap::deallocate(sizeof_inner_n(n, nv), p);
+                    throw;
+                }
+                if (store_hashes && nv)
+                    copy_hashes(src->impl.d.data.inner.values,
+                                p->impl.d.data.inner.values, nv);
+                return p;
+            },
+            [&] (auto) {
+                auto p = make_inner_n(n);
+                if (auto values = src->impl.d.data.inner.values) {
+                    p->impl.d.data.inner.values = values;
+                    refs(values).inc();
+                }
+                return p;
+            });
     }
 
     static node_t* make_inner_n(count_t n, count_t nv)
     {
         assert(nv <= branches<B>);
+        if (embed_values && nv) {
+            auto m = heap::allocate(sizeof_inner_n(n, nv));
+            auto p = make_inner_at(m);
+            p->impl.d.data.inner.values = new (
+                static_cast<char*>(m) + embedded_values_offset(n)) values_t;
+            return p;
+        }
         auto p = make_inner_n(n);
         if (nv) {
             try {
                 p->impl.d.data.inner.values =
-                    new (heap::allocate(sizeof_values_n(nv))) values_t{};
+                    new (heap::allocate(sizeof_values_n(nv))) values_t;
             } catch (...) {
                 deallocate_inner(p, n);
                 throw;
@@ -228,7 +360,7 @@ struct node
 
     static node_t* make_inner_n(count_t n,
                                 bitmap_t bitmap,
-                                T x)
+                                T x, hash_t hash)
     {
         auto p = make_inner_n(n, 1);
         p->impl.d.data.inner.datamap = bitmap;
@@ -238,16 +370,22 @@ struct node
             deallocate_inner(p, n, 1);
             throw;
         }
+        if (store_hashes)
+            p->hashes()[0] = hash;
         return p;
     }
 
     static node_t* make_inner_n(count_t n,
-                                count_t idx1, T x1,
-                                count_t idx2, T x2)
+                                count_t idx1, T x1, hash_t hash1,
+                                count_t idx2, T x2, hash_t hash2)
     {
         assert(idx1 != idx2);
         auto p = make_inner_n(n, 2);
         p->impl.d.data.inner.datamap = (bitmap_t{1u} << idx1) | (bitmap_t{1u} << idx2);
+        if (store_hashes) {
+            p->hashes()[idx1 > idx2] = hash1;
+            p->hashes()[idx1 < idx2] = hash2;
+        }
         auto assign = [&] (auto&& x1, auto&& x2) {
             auto vp = p->values();
             try {
@@ -270,9 +408,44 @@ struct node
         return p;
     }
 
+    /*!
+     * Makes an inner node with the given bitmaps, with copies of the
+     * values pointed to by `values`, and taking over the `children`.
+     * The values are moved instead when `values` holds move iterators.
+     */
+    template <typename Ptr>
+    static node_t* make_inner_from(bitmap_t datamap, bitmap_t nodemap,
+                                   const Ptr* values, const hash_t* hashes,
+                                   node_t* const* children)
+    {
+        auto n  = popcount(nodemap);
+        auto nv = popcount(datamap);
+        auto p  = make_inner_n(n, nv);
+        p->impl.d.data.inner.datamap = datamap;
+        p->impl.d.data.inner.nodemap = nodemap;
+        auto i = count_t{};
+        try {
+            for (; i < nv; ++i)
+                new (p->values() + i) T{*values[i]};
+        } catch (...) {
+            destroy_n(p->values(), i);
+            if (embed_values)
+                heap::deallocate(sizeof_inner_n(n, nv), p);
+            else {
+                heap::deallocate(sizeof_values_n(nv),
+                                 p->impl.d.data.inner.values);
+                deallocate_inner(p, n);
+            }
+            throw;
+        }
+        if (store_hashes && nv)
+            std::copy(hashes, hashes + nv, p->hashes());
+        std::copy(children, children + n, p->children());
+        return p;
+    }
+
     static node_t* make_collision_n(count_t n)
     {
-        assert(n <= branches<B>);
         auto m = heap::allocate(sizeof_collision_n(n));
         auto p = new (m) node_t;
 #if IMMER_HAMTS_TAGGED_NODE
@@ -328,6 +501,30 @@ struct node
         return dst;
     }
 
+    /*!
+     * Makes a collision node with copies of the `n` values of `src`
+     * that satisfy `pred`.
+     */
+    template <typename Pred>
+    static node_t* copy_collision_filter(node_t* src, count_t n, Pred&& pred)
+    {
+        assert(src->kind() == kind_t::collision);
+        auto dst  = make_collision_n(n);
+        auto srcp = src->collisions();
+        auto dstp = dst->collisions();
+        auto i    = count_t{};
+        try {
+            for (auto j = count_t{}; i < n; ++j)
+                if (pred(srcp[j]))
+                    new (dstp + i++) T{srcp[j]};
+        } catch (...) {
+            destroy_n(dstp, i);
+            heap::deallocate(sizeof_collision_n(n), dst);
+            throw;
+        }
+        return dst;
+    }
+
     static node_t* copy_collision_remove(node_t* src, T* v)
     {
         assert(src->kind() == kind_t::collision);
@@ -385,7 +582,7 @@ struct node
     {
         assert(src->kind() == kind_t::inner);
         auto n    = popcount(src->nodemap());
-        auto dst  = make_inner_n(n, src->impl.d.data.inner.values);
+        auto dst  = make_inner_n(n, src);
         auto srcp = src->children();
         auto dstp = dst->children();
         dst->impl.d.data.inner.datamap = src->datamap();
@@ -420,6 +617,9 @@ struct node
             deallocate_inner(dst, n, nv);
             throw;
         }
+        if (store_hashes)
+            copy_hashes(src->impl.d.data.inner.values,
+                        dst->impl.d.data.inner.values, nv);
         inc_nodes(src->children(), n);
         std::uninitialized_copy(
             src->children(), src->children() + n, dst->children());
@@ -455,6 +655,8 @@ struct node
             deallocate_inner(dst, n + 1, nv - 1);
             throw;
         }
+        if (store_hashes)
+            remove_hash(src, voffset, dst);
         inc_nodes(src->children(), n);
         std::uninitialized_copy(
             src->children(), src->children() + noffset,
@@ -467,7 +669,7 @@ struct node
     }
 
     static node_t* copy_inner_replace_inline(
-        node_t* src, bitmap_t bit, count_t noffset, T value)
+        node_t* src, bitmap_t bit, count_t noffset, T value, hash_t hash)
     {
         assert(src->kind() == kind_t::inner);
         assert(!(src->datamap() & bit));
@@ -501,6 +703,8 @@ struct node
             deallocate_inner(dst, n - 1, nv + 1);
             throw;
         }
+        if (store_hashes)
+            insert_hash(src, voffset, hash, dst);
         inc_nodes(src->children(), n);
         src->children()[noffset]->dec_unsafe();
         std::uninitialized_copy(
@@ -540,13 +744,16 @@ struct node
             deallocate_inner(dst, n, nv - 1);
             throw;
         }
+        if (store_hashes)
+            remove_hash(src, voffset, dst);
         inc_nodes(src->children(), n);
         std::uninitialized_copy(
             src->children(), src->children() + n, dst->children());
         return dst;
     }
 
-    static node_t* copy_inner_insert_value(node_t* src, bitmap_t bit, T v)
+    static node_t* copy_inner_insert_value(node_t* src, bitmap_t bit,
+                                           T v, hash_t hash)
     {
         assert(src->kind() == kind_t::inner);
         auto n      = popcount(src->nodemap());
@@ -576,12 +783,296 @@ struct node
             deallocate_inner(dst, n, nv + 1);
             throw;
         }
+        if (store_hashes)
+            insert_hash(src, offset, hash, dst);
         inc_nodes(src->children(), n);
         std::uninitialized_copy(
             src->children(), src->children() + n, dst->children());
         return dst;
     }
 
+    static void copy_hashes(const values_t* src, values_t* dst, count_t nv)
+    {
+        auto srcp = hashes(src, nv);
+        std::copy(srcp, srcp + nv, hashes(dst, nv));
+    }
+
+    /*!
+     * Writes in `dst` the hashes of `src`, with `hash` inserted at
+     * `offset`.  The bitmaps of both nodes must be set already.
+     */
+    static void insert_hash(const node_t* src, count_t offset,
+                            hash_t hash, node_t* dst)
+    {
+        auto nv   = popcount(src->datamap());
+        auto dstp = dst->hashes();
+        if (nv) {
+            auto srcp = src->hashes();
+            std::copy(srcp, srcp + offset, dstp);
+            std::copy(srcp + offset, srcp + nv, dstp + offset + 1);
+        }
+        dstp[offset] = hash;
+    }
+
+    /*!
+     * Writes in `dst` the hashes of `src`, but the one at `offset`.
+     * The bitmaps of both nodes must be set already.
+     */
+    static void remove_hash(const node_t* src, count_t offset, node_t* dst)
+    {
+        auto nv = popcount(src->datamap());
+        if (nv > 1) {
+            auto srcp = src->hashes();
+            auto dstp = dst->hashes();
+            std::copy(srcp, srcp + offset, dstp);
+            std::copy(srcp + offset + 1, srcp + nv, dstp + offset);
+        }
+    }
+
+    /*!
+     * Whether the values of `src`, that is about to be released by a
+     * `move_*` operation, can be moved instead of copied.  They are
+     * only moved when that can not throw, so a failed operation leaves
+     * `src` untouched.
+     */
+    static bool can_move_values(const node_t* src, edit_t e)
+    {
+        return std::is_nothrow_move_constructible<T>::value
+            && src->can_mutate_values(e);
+    }
+
+    /*!
+     * Constructs in `dst` the `n` values from `src`, with `v` inserted
+     * at `offset`.
+     */
+    template <typename Iter>
+    static void uninitialized_insert(Iter src, count_t n, count_t offset,
+                                     T&& v, T* dst)
+    {
+        std::uninitialized_copy(src, src + offset, dst);
+        try {
+            new (dst + offset) T{std::move(v)};
+            try {
+                std::uninitialized_copy(src + offset, src + n,
+                                        dst + offset + 1);
+            } catch (...) {
+                dst[offset].~T();
+                throw;
+            }
+        } catch (...) {
+            destroy_n(dst, offset);
+            throw;
+        }
+    }
+
+    /*!
+     * Constructs in `dst` the `n` values from `src`, but the one at
+     * `offset`.
+     */
+    template <typename Iter>
+    static void uninitialized_remove(Iter src, count_t n, count_t offset,
+                                     T* dst)
+    {
+        std::uninitialized_copy(src, src + offset, dst);
+        try {
+            std::uninitialized_copy(src + offset + 1, src + n, dst + offset);
+        } catch (...) {
+            destroy_n(dst, offset);
+            throw;
+        }
+    }
+
+    /*
+     * The `move_*` operations are like their `copy_*` counterparts,
+     * but they take over `src`, that must be mutable with the edit
+     * token `e`.  The children of `src` are moved to the new node
+     * without touching their reference counts, its values are moved
+     * when possible, and `src` is deallocated.
+     */
+
+    static node_t* move_collision_insert(node_t* src, T v)
+    {
+        assert(src->kind() == kind_t::collision);
+        auto n    = src->collision_count();
+        auto dst  = make_collision_n(n + 1);
+        auto srcp = src->collisions();
+        try {
+            if (std::is_nothrow_move_constructible<T>::value)
+                uninitialized_insert(std::make_move_iterator(srcp),
+                                     n, 0, std::move(v), dst->collisions());
+            else
+                uninitialized_insert(srcp, n, 0, std::move(v),
+                                     dst->collisions());
+        } catch (...) {
+            heap::deallocate(node_t::sizeof_collision_n(n + 1), dst);
+            throw;
+        }
+        delete_collision(src);
+        return dst;
+    }
+
+    static node_t* move_collision_remove(node_t* src, T* v)
+    {
+        assert(src->kind() == kind_t::collision);
+        assert(src->collision_count() > 1);
+        auto n      = src->collision_count();
+        auto dst    = make_collision_n(n - 1);
+        auto srcp   = src->collisions();
+        auto offset = static_cast<count_t>(v - srcp);
+        try {
+            if (std::is_nothrow_move_constructible<T>::value)
+                uninitialized_remove(std::make_move_iterator(srcp),
+                                     n, offset, dst->collisions());
+            else
+                uninitialized_remove(srcp, n, offset, dst->collisions());
+        } catch (...) {
+            heap::deallocate(node_t::sizeof_collision_n(n - 1), dst);
+            throw;
+        }
+        delete_collision(src);
+        return dst;
+    }
+
+    static node_t* move_inner_insert_value(edit_t e, node_t* src,
+                                           bitmap_t bit, T v, hash_t hash)
+    {
+        assert(src->kind() == kind_t::inner);
+        auto n      = popcount(src->nodemap());
+        auto nv     = popcount(src->datamap());
+        auto offset = popcount(src->datamap() & (bit - 1));
+        auto dst    = make_inner_n(n, nv + 1);
+        dst->impl.d.data.inner.datamap = src->datamap() | bit;
+        dst->impl.d.data.inner.nodemap = src->nodemap();
+        try {
+            if (can_move_values(src, e))
+                uninitialized_insert(std::make_move_iterator(src->values()),
+                                     nv, offset, std::move(v), dst->values());
+            else
+                uninitialized_insert(src->values(), nv, offset, std::move(v),
+                                     dst->values());
+        } catch (...) {
+            deallocate_inner(dst, n, nv + 1);
+            throw;
+        }
+        if (store_hashes)
+            insert_hash(src, offset, hash, dst);
+        std::uninitialized_copy(
+            src->children(), src->children() + n, dst->children());
+        delete_inner(src);
+        return dst;
+    }
+
+    static node_t* move_inner_replace_merged(
+        edit_t e, node_t* src, bitmap_t bit, count_t voffset, node_t* node)
+    {
+        assert(src->kind() == kind_t::inner);
+        assert(!(src->nodemap() & bit));
+        assert(src->datamap() & bit);
+        assert(voffset == popcount(src->datamap() & (bit - 1)));
+        auto n       = popcount(src->nodemap());
+        auto nv      = popcount(src->datamap());
+        auto dst     = make_inner_n(n + 1, nv - 1);
+        auto noffset = popcount(src->nodemap() & (bit - 1));
+        dst->impl.d.data.inner.datamap = src->datamap() & ~bit;
+        dst->impl.d.data.inner.nodemap = src->nodemap() | bit;
+        try {
+            if (can_move_values(src, e))
+                uninitialized_remove(std::make_move_iterator(src->values()),
+                                     nv, voffset, dst->values());
+            else
+                uninitialized_remove(src->values(), nv, voffset,
+                                     dst->values());
+        } catch (...) {
+            deallocate_inner(dst, n + 1, nv - 1);
+            throw;
+        }
+        if (store_hashes)
+            remove_hash(src, voffset, dst);
+        std::uninitialized_copy(
+            src->children(), src->children() + noffset,
+            dst->children());
+        std::uninitialized_copy(
+            src->children() + noffset, src->children() + n,
+            dst->children() + noffset + 1);
+        dst->children()[noffset] = node;
+        delete_inner(src);
+        return dst;
+    }
+
+    /*!
+     * The child at `noffset` is dropped from the new node, but it is
+     * not released: this is left to the caller, that probably took
+     * `value` from it.
+     */
+    static node_t* move_inner_replace_inline(
+        edit_t e, node_t* src, bitmap_t bit, count_t noffset, T value,
+        hash_t hash)
+    {
+        assert(src->kind() == kind_t::inner);
+        assert(!(src->datamap() & bit));
+        assert(src->nodemap() & bit);
+        assert(noffset == popcount(src->nodemap() & (bit - 1)));
+        auto n       = popcount(src->nodemap());
+        auto nv      = popcount(src->datamap());
+        auto dst     = make_inner_n(n - 1, nv + 1);
+        auto voffset = popcount(src->datamap() & (bit - 1));
+        dst->impl.d.data.inner.nodemap = src->nodemap() & ~bit;
+        dst->impl.d.data.inner.datamap = src->datamap() | bit;
+        try {
+            if (can_move_values(src, e))
+                uninitialized_insert(std::make_move_iterator(src->values()),
+                                     nv, voffset, std::move(value),
+                                     dst->values());
+            else
+                uninitialized_insert(src->values(), nv, voffset,
+                                     std::move(value), dst->values());
+        } catch (...) {
+            deallocate_inner(dst, n - 1, nv + 1);
+            throw;
+        }
+        if (store_hashes)
+            insert_hash(src, voffset, hash, dst);
+        std::uninitialized_copy(
+            src->children(), src->children() + noffset,
+            dst->children());
+        std::uninitialized_copy(
+            src->children() + noffset + 1, src->children() + n,
+            dst->children() + noffset);
+        delete_inner(src);
+        return dst;
+    }
+
+    static node_t* move_inner_remove_value(
+        edit_t e, node_t* src, bitmap_t bit, count_t voffset)
+    {
+        assert(src->kind() == kind_t::inner);
+        assert(!(src->nodemap() & bit));
+        assert(src->datamap() & bit);
+        assert(voffset == popcount(src->datamap() & (bit - 1)));
+        auto n       = popcount(src->nodemap());
+        auto nv      = popcount(src->datamap());
+        auto dst     = make_inner_n(n, nv - 1);
+        dst->impl.d.data.inner.datamap = src->datamap() & ~bit;
+        dst->impl.d.data.inner.nodemap = src->nodemap();
+        try {
+            if (can_move_values(src, e))
+                uninitialized_remove(std::make_move_iterator(src->values()),
+                                     nv, voffset, dst->values());
+            else
+                uninitialized_remove(src->values(), nv, voffset,
+                                     dst->values());
+        } catch (...) {
+            deallocate_inner(dst, n, nv - 1);
+            throw;
+        }
+        if (store_hashes)
+            remove_hash(src, voffset, dst);
+        std::uninitialized_copy(
+            src->children(), src->children() + n, dst->children());
+        delete_inner(src);
+        return dst;
+    }
+
     static node_t* make_merged(shift_t shift,
                                T v1, hash_t hash1,
                                T v2, hash_t hash2)
@@ -601,8 +1092,8 @@ struct node
                 }
             } else {
                 return make_inner_n(0,
-                                    idx1 >> shift, std::move(v1),
-                                    idx2 >> shift, std::move(v2));
+                                    idx1 >> shift, std::move(v1), hash1,
+                                    idx2 >> shift, std::move(v2), hash2);
             }
         } else {
             return make_collision(std::move(v1), std::move(v2));
@@ -621,9 +1112,87 @@ struct node
         return this;
     }
 
+    bool can_mutate(edit_t e) const
+    {
+        return refs(this).unique()
+            || ownee(this).can_mutate(e);
+    }
+
+    bool can_mutate_values(edit_t e) const
+    {
+        assert(kind() == kind_t::inner);
+        auto vp = impl.d.data.inner.values;
+        return vp && static_if<embed_values, bool>(
+            [&] (auto) { return can_mutate(e); },
+            [&] (auto) {
+                return refs(vp).unique() || ownee(vp).can_mutate(e);
+            });
+    }
+
+    /*!
+     * Returns the values of this node, that must be mutable with the
+     * edit token `e`, copying them first if they are shared with
+     * other nodes.
+     */
+    T* ensure_mutable_values(edit_t e)
+    {
+        assert(can_mutate(e));
+        static_if<!embed_values>([&] (auto) {
+            if (this->can_mutate_values(e))
+                return;
+            auto src = impl.d.data.inner.values;
+            auto nv  = popcount(this->datamap());
+            auto dst = new (heap::allocate(sizeof_values_n(nv))) values_t;
+            try {
+                std::uninitialized_copy(
+                    (const T*) &src->d.buffer, (const T*) &src->d.buffer + nv,
+                    (T*) &dst->d.buffer);
+            } catch (...) {
+                heap::deallocate(sizeof_values_n(nv), dst);
+                throw;
+            }
+            if (store_hashes)
+                copy_hashes(src, dst, nv);
+            node_t::ownee(dst) = e;
+            impl.d.data.inner.values = dst;
+            if (node_t::refs(src).dec())
+                delete_values(src, nv);
+        });
+        return values();
+    }
+
+    /*!
+     * Marks the new node `p` as owned by the edit token `e`.
+     */
+    static node_t* owned(node_t* p, edit_t e)
+    {
+        ownee(p) = e;
+        return p;
+    }
+
+    /*!
+     * Marks the new inner node `p`, and its values if it has any, as
+     * owned by the edit token `e`.
+     */
+    static node_t* owned_values(node_t* p, edit_t e)
+    {
+        ownee(p) = e;
+        static_if<!embed_values>([&] (auto) {
+            if (auto vp = p->impl.d.data.inner.values)
+                node_t::ownee(vp) = e;
+        });
+        return p;
+    }
+
     bool dec() const { return refs(this).dec(); }
     void dec_unsafe() const { refs(this).dec_unsafe(); }
 
+    node_t* make_immortal()
+    {
+        make_refs_immortal(refs(this));
+        return this;
+    }
+
     static void inc_nodes(node_t** p, count_t n)
     {
         for (auto i = p, e = i + n; i != e; ++i)
@@ -640,10 +1209,20 @@ struct node
     {
         assert(p);
         assert(p->kind() == kind_t::inner);
-        auto vp = p->impl.d.data.inner.values;
-        if (vp && refs(vp).dec())
-            delete_values(vp, popcount(p->datamap()));
-        deallocate_inner(p, popcount(p->nodemap()));
+        static_if<embed_values>(
+            [&] (auto) {
+                auto nv = popcount(p->datamap());
+                if (nv)
+                    destroy_n(p->values(), nv);
+                heap::deallocate(
+                    node_t::sizeof_inner_n(popcount(p->nodemap()), nv), p);
+            },
+            [&] (auto) {
+                auto vp = p->impl.d.data.inner.values;
+                if (vp && node_t::refs(vp).dec())
+                    delete_values(vp, popcount(p->datamap()));
+                deallocate_inner(p, popcount(p->nodemap()));
+            });
     }
 
     static void delete_collision(node_t* p)
@@ -654,32 +1233,63 @@ struct node
         deallocate_collision(p, n);
     }
 
-    static void delete_deep(node_t* p, shift_t s)
+    /*!
+     * Describes the tree to `detail::delete_deep`.  Entries are
+     * released nodes, with their depth and the next child to visit.
+     */
+    struct delete_traits
     {
-        if (s == max_depth<B>)
-            delete_collision(p);
-        else {
-            auto fst = p->children();
-            auto lst = fst + popcount(p->nodemap());
-            for (; fst != lst; ++fst)
-                if ((*fst)->dec())
-                    delete_deep(*fst, s + 1);
-            delete_inner(p);
+        struct entry
+        {
+            node_t* node;
+            shift_t depth;
+            count_t next;
+        };
+
+        static constexpr auto max_depth = hamts::max_depth<B> + 1;
+
+        static bool next_child(entry& e, entry& child)
+        {
+            if (e.depth == hamts::max_depth<B>)
+                return false;
+            auto children = e.node->children();
+            auto n = popcount(e.node->nodemap());
+            while (e.next < n) {
+                auto c = children[e.next++];
+                if (c->dec()) {
+                    child = { c, e.depth + 1, 0 };
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static void destroy(const entry& e)
+        {
+            if (e.depth == hamts::max_depth<B>)
+                delete_collision(e.node);
+            else
+                delete_inner(e.node);
         }
+    };
+
+    template <typename Suspend>
+    static std::size_t delete_deep(typename delete_traits::entry e,
+                                   std::size_t budget,
+                                   Suspend&& suspend)
+    {
+        return detail::delete_deep<delete_traits>(
+            e, budget, std::forward<Suspend>(suspend));
+    }
+
+    static void delete_deep(node_t* p, shift_t depth)
+    {
+        detail::delete_deep<delete_traits>({ p, depth, 0 });
     }
 
     static void delete_deep_shift(node_t* p, shift_t s)
     {
-        if (s == max_shift<B>)
-            delete_collision(p);
-        else {
-            auto fst = p->children();
-            auto lst = fst + popcount(p->nodemap());
-            for (; fst != lst; ++fst)
-                if ((*fst)->dec())
-                    delete_deep_shift(*fst, s + B);
-            delete_inner(p);
-        }
+        delete_deep(p, s / B);
     }
 
     static void deallocate_values(values_t* p, count_t n)
@@ -699,10 +1309,16 @@ struct node
         heap::deallocate(node_t::sizeof_inner_n(n), p);
     }
 
+    /*!
+     * Releases the memory of a node made with `make_inner_n(n, nv)`
+     * whose values are not constructed, or already destroyed.
+     */
     static void deallocate_inner(node_t* p, count_t n, count_t nv)
     {
-        deallocate_values(p->impl.d.data.inner.values, nv);
-        heap::deallocate(node_t::sizeof_inner_n(n), p);
+        if (!embed_values && nv)
+            heap::deallocate(node_t::sizeof_values_n(nv),
+                             p->impl.d.data.inner.values);
+        heap::deallocate(node_t::sizeof_inner_n(n, nv), p);
     }
 };
 
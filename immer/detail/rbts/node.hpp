@@ -712,6 +712,37 @@ struct node
         return dst;
     }
 
+    template <typename U>
+    static node_t* copy_leaf_emplace_front(node_t* src, count_t n, U&& x)
+    {
+        auto dst = make_leaf_n(n + 1, std::forward<U>(x));
+        try {
+            std::uninitialized_copy(src->leaf(), src->leaf() + n,
+                                    dst->leaf() + 1);
+        } catch (...) {
+            destroy_n(dst->leaf(), 1);
+            heap::deallocate(node_t::sizeof_leaf_n(n + 1), dst);
+            throw;
+        }
+        return dst;
+    }
+
+    template <typename U>
+    static node_t* copy_leaf_emplace_front_e(edit_t e, node_t* src, count_t n,
+                                             U&& x)
+    {
+        auto dst = make_leaf_e(e, std::forward<U>(x));
+        try {
+            std::uninitialized_copy(src->leaf(), src->leaf() + n,
+                                    dst->leaf() + 1);
+        } catch (...) {
+            destroy_n(dst->leaf(), 1);
+            heap::deallocate(node_t::max_sizeof_leaf, dst);
+            throw;
+        }
+        return dst;
+    }
+
     static void delete_inner(node_t* p, count_t n)
     {
         assert(p->kind() == kind_t::inner);
@@ -861,6 +892,12 @@ struct node
     bool dec() const { return refs(this).dec(); }
     void dec_unsafe() const { refs(this).dec_unsafe(); }
 
+    node_t* make_immortal()
+    {
+        make_refs_immortal(refs(this));
+        return this;
+    }
+
     static void inc_nodes(node_t** p, count_t n)
     {
         for (auto i = p, e = i + n; i != e; ++i)
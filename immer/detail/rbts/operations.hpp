@@ -16,6 +16,7 @@
 #include "config.hpp"
 #include "heap/tags.hpp"
 #include "detail/util.hpp"
+#include "detail/delete_deep.hpp"
 #include "detail/rbts/position.hpp"
 #include "detail/rbts/visitor.hpp"
 
@@ -52,6 +53,21 @@ struct region_for_visitor : visitor_base<region_for_visitor<T>>
     { return { pos.node()->leaf(), pos.index(idx), pos.count() }; }
 };
 
+template <typename NodeT>
+struct leaf_for_visitor : visitor_base<leaf_for_visitor<NodeT>>
+{
+    using this_t = leaf_for_visitor;
+    using result_t = std::tuple<NodeT*, count_t>;
+
+    template <typename PosT>
+    static result_t visit_inner(PosT&& pos, size_t idx)
+    { return pos.towards(this_t{}, idx); }
+
+    template <typename PosT>
+    static result_t visit_leaf(PosT&& pos, size_t)
+    { return { pos.node(), pos.count() }; }
+};
+
 template <typename T>
 struct get_visitor : visitor_base<get_visitor<T>>
 {
@@ -501,6 +517,110 @@ struct update_visitor : visitor_base<update_visitor<NodeT>>
     }
 };
 
+/*!
+ * Describes the tree to `detail::delete_deep`.  Entries are released
+ * nodes with the information that positions would carry about them,
+ * plus the next child to visit.
+ */
+template <typename NodeT>
+struct delete_traits
+{
+    using node_t = NodeT;
+    static constexpr auto B  = NodeT::bits;
+    static constexpr auto BL = NodeT::bits_leaf;
+
+    enum kind_t : std::uint8_t { leaf_kind, regular_kind, relaxed_kind };
+
+    struct entry
+    {
+        node_t* node;
+        size_t  size;
+        shift_t shift;
+        count_t next;
+        kind_t  kind;
+    };
+
+    static constexpr auto max_depth = (sizeof(size_t) * 8 - BL) / B + 2;
+
+    static entry make_leaf(node_t* n, count_t count)
+    { return { n, count, 0, 0, leaf_kind }; }
+
+    static entry make_regular(node_t* n, shift_t shift, size_t size)
+    { return { n, size, shift, 0, regular_kind }; }
+
+    static entry make_relaxed(node_t* n, shift_t shift)
+    { return { n, 0, shift, 0, relaxed_kind }; }
+
+    static count_t regular_count(const entry& e)
+    {
+        return e.size
+            ? (((e.size - 1) >> e.shift) & mask<B>) + 1
+            : 0;
+    }
+
+    static bool next_child(entry& e, entry& child)
+    {
+        switch (e.kind) {
+        case regular_kind: {
+            auto children = e.node->inner();
+            auto n = regular_count(e);
+            while (e.next < n) {
+                auto i = e.next++;
+                auto c = children[i];
+                if (c->dec()) {
+                    auto last = i + 1 == n;
+                    child = e.shift == BL
+                        ? make_leaf(c, last
+                                    ? ((e.size - 1) & mask<BL>) + 1
+                                    : branches<BL>)
+                        : make_regular(c, e.shift - B, last
+                                       ? e.size
+                                       : size_t{1} << e.shift);
+                    return true;
+                }
+            }
+            return false;
+        }
+        case relaxed_kind: {
+            auto children = e.node->inner();
+            auto r = e.node->relaxed();
+            auto n = r->d.count;
+            while (e.next < n) {
+                auto i = e.next++;
+                auto c = children[i];
+                if (c->dec()) {
+                    auto size = r->d.sizes[i] - (i ? r->d.sizes[i - 1] : 0);
+                    child = e.shift == BL
+                        ? make_leaf(c, static_cast<count_t>(size))
+                        : c->relaxed()
+                        ? make_relaxed(c, e.shift - B)
+                        : make_regular(c, e.shift - B, size);
+                    return true;
+                }
+            }
+            return false;
+        }
+        default:
+            return false;
+        }
+    }
+
+    static void destroy(const entry& e)
+    {
+        switch (e.kind) {
+        case regular_kind:
+            node_t::delete_inner(e.node, regular_count(e));
+            break;
+        case relaxed_kind:
+            node_t::delete_inner_r(e.node, e.node->relaxed()->d.count);
+            break;
+        default:
+            node_t::delete_leaf(e.node, static_cast<count_t>(e.size));
+            break;
+        }
+    }
+};
+
 struct dec_visitor : visitor_base<dec_visitor>
 {
     using this_t = dec_visitor;
@@ -508,33 +628,31 @@ struct dec_visitor : visitor_base<dec_visitor>
     template <typename Pos>
     static void visit_relaxed(Pos&& p)
     {
-        using node_t = node_type<Pos>;
+        using traits = delete_traits<node_type<Pos>>;
         auto node = p.node();
-        if (node->dec()) {
-            p.each(this_t{});
-            node_t::delete_inner_r(node, p.count());
-        }
+        if (node->dec())
+            detail::delete_deep<traits>(
+                traits::make_relaxed(node, p.shift()));
     }
 
     template <typename Pos>
     static void visit_regular(Pos&& p)
     {
-        using node_t = node_type<Pos>;
+        using traits = delete_traits<node_type<Pos>>;
         auto node = p.node();
-        if (node->dec()) {
-            p.each(this_t{});
-            node_t::delete_inner(node, p.count());
-        }
+        if (node->dec())
+            detail::delete_deep<traits>(
+                traits::make_regular(node, p.shift(), p.size()));
     }
 
     template <typename Pos>
     static void visit_leaf(Pos&& p)
     {
-        using node_t = node_type<Pos>;
+        using traits = delete_traits<node_type<Pos>>;
         auto node = p.node();
-        if (node->dec()) {
-            node_t::delete_leaf(node, p.count());
-        }
+        if (node->dec())
+            detail::delete_deep<traits>(
+                traits::make_leaf(node, p.count()));
     }
 };
 
@@ -13,6 +13,8 @@
 #include "detail/rbts/operations.hpp"
 
 #include "detail/type_traits.hpp"
+#include "heap/arena_heap.hpp"
+#include "refcount/deferred_refcount_policy.hpp"
 
 #include <cassert>
 #include <memory>
@@ -42,8 +44,12 @@ struct rbtree
         static const rbtree empty_ {
             0,
             BL,
-            node_t::make_inner_n(0u),
-            node_t::make_leaf_n(0u)
+            without_arena([] {
+                return node_t::make_inner_n(0u)->make_immortal();
+            }),
+            without_arena([] {
+                return node_t::make_leaf_n(0u)->make_immortal();
+            })
         };
         return empty_;
     }
@@ -132,7 +138,23 @@ struct rbtree
 
     void dec() const
     {
-        traverse(dec_visitor());
+        if (is_deferred_refcount_v<typename MemoryPolicy::refcount>)
+            dec_deferred();
+        else
+            traverse(dec_visitor());
+    }
+
+    void dec_deferred() const
+    {
+        using refcount = typename MemoryPolicy::refcount;
+        using traits = delete_traits<node_t>;
+        auto tail_off = tail_offset();
+        if (root->dec())
+            defer_delete_deep<refcount, traits>(
+                traits::make_regular(root, shift, tail_off));
+        if (tail->dec())
+            defer_delete_deep<refcount, traits>(
+                traits::make_leaf(tail, count_t(size - tail_off)));
     }
 
     auto tail_size() const
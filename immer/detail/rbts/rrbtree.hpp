@@ -14,7 +14,10 @@
 #include "detail/rbts/operations.hpp"
 
 #include "detail/type_traits.hpp"
+#include "heap/arena_heap.hpp"
+#include "refcount/deferred_refcount_policy.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <memory>
 #include <numeric>
@@ -41,16 +44,22 @@ struct rrbtree
 
     size_t  size;
     shift_t shift;
+    count_t head_size;
     node_t* root;
     node_t* tail;
+    node_t* head;
 
     static const rrbtree& empty()
     {
         static const rrbtree empty_ {
             0,
             BL,
-            node_t::make_inner_n(0u),
-            node_t::make_leaf_n(0u)
+            without_arena([] {
+                return node_t::make_inner_n(0u)->make_immortal();
+            }),
+            without_arena([] {
+                return node_t::make_leaf_n(0u)->make_immortal();
+            })
         };
         return empty_;
     }
@@ -87,13 +96,21 @@ struct rrbtree
     }
 
     rrbtree(size_t sz, shift_t sh, node_t* r, node_t* t)
-        : size{sz}, shift{sh}, root{r}, tail{t}
+        : size{sz}, shift{sh}, head_size{0}, root{r}, tail{t}, head{nullptr}
+    {
+        assert(check_tree());
+    }
+
+    rrbtree(size_t sz, shift_t sh, node_t* r, node_t* t,
+            node_t* h, count_t hs)
+        : size{sz}, shift{sh}, head_size{hs}, root{r}, tail{t}, head{h}
     {
         assert(check_tree());
     }
 
     rrbtree(const rrbtree& other)
-        : rrbtree{other.size, other.shift, other.root, other.tail}
+        : rrbtree{other.size, other.shift, other.root, other.tail,
+                  other.head, other.head_size}
     {
         inc();
     }
@@ -124,6 +141,8 @@ struct rrbtree
         swap(x.shift, y.shift);
         swap(x.root,  y.root);
         swap(x.tail,  y.tail);
+        swap(x.head,  y.head);
+        swap(x.head_size, y.head_size);
     }
 
     ~rrbtree()
@@ -135,33 +154,132 @@ struct rrbtree
     {
         root->inc();
         tail->inc();
+        if (head_size)
+            head->inc();
     }
 
     void dec() const
     {
-        traverse(dec_visitor());
+        if (is_deferred_refcount_v<typename MemoryPolicy::refcount>)
+            dec_deferred();
+        else
+            traverse(dec_visitor());
+    }
+
+    void dec_deferred() const
+    {
+        using refcount = typename MemoryPolicy::refcount;
+        using traits = delete_traits<node_t>;
+        auto tail_off = tail_offset();
+        if (root->dec())
+            defer_delete_deep<refcount, traits>(
+                tail_off && root->relaxed()
+                ? traits::make_relaxed(root, shift)
+                : traits::make_regular(root, shift, tail_off));
+        if (tail->dec())
+            defer_delete_deep<refcount, traits>(
+                traits::make_leaf(tail, count_t(size - head_size - tail_off)));
+        if (head_size && head->dec())
+            defer_delete_deep<refcount, traits>(
+                traits::make_leaf(head, head_size));
     }
 
+    // The tree may have a *head* leaf with the first `head_size`
+    // elements, mirroring the tail, so that `push_front()` is
+    // amortized O(1).  The rest of the elements, the *body*, are laid
+    // out as in a tree without head: the offsets computed below are
+    // relative to the start of the body.
     auto tail_size() const
     {
-        return size - tail_offset();
+        return size - head_size - tail_offset();
     }
 
     auto tail_offset() const
     {
         auto r = root->relaxed();
+        auto body_size = size - head_size;
         assert(r == nullptr || r->d.count);
         return
             r               ? r->d.sizes[r->d.count - 1] :
-            size            ? (size - 1) & ~mask<BL>
+            body_size       ? (body_size - 1) & ~mask<BL>
             /* otherwise */ : 0;
     }
 
+    rrbtree body() const
+    {
+        return { size - head_size, shift, root->inc(), tail->inc() };
+    }
+
+    // Returns `b`, which must not have a head, with the head of this
+    // tree in front of it.
+    rrbtree with_head(rrbtree b) const
+    {
+        assert(b.head_size == 0);
+        if (head_size) {
+            b.size     += head_size;
+            b.head      = head->inc();
+            b.head_size = head_size;
+        }
+        return b;
+    }
+
+    // Returns an equivalent tree without head, by concatenating the
+    // head to the body.  This is O(log(size)).
+    rrbtree without_head() const
+    {
+        if (!head_size)
+            return *this;
+        auto h = rrbtree{head_size, BL, empty().root->inc(), head->inc()};
+        return h.concat(body());
+    }
+
+    // Runs `fn`, that mutates this tree, with the head temporarily
+    // detached from it.
+    template <typename Fn>
+    void mutate_body(Fn&& fn)
+    {
+        auto h  = head;
+        auto hs = head_size;
+        head      = nullptr;
+        head_size = 0;
+        size     -= hs;
+        try {
+            std::forward<Fn>(fn)();
+        } catch (...) {
+            size     += hs;
+            head      = h;
+            head_size = hs;
+            throw;
+        }
+        assert(head_size == 0);
+        size     += hs;
+        head      = h;
+        head_size = hs;
+    }
+
+    // The first leaf of the body, which must not be the tail.
+    std::tuple<node_t*, count_t> first_leaf() const
+    {
+        return visit_maybe_relaxed_sub(root, shift, tail_offset(),
+                                       leaf_for_visitor<node_t>(), 0);
+    }
+
+    void ensure_mutable_head(edit_t e)
+    {
+        if (!head->can_mutate(e)) {
+            auto new_head = node_t::copy_leaf_e(e, head, head_size);
+            dec_leaf(head, head_size);
+            head = new_head;
+        }
+    }
+
     template <typename Visitor, typename... Args>
     void traverse(Visitor v, Args&&... args) const
     {
         auto tail_off  = tail_offset();
-        auto tail_size = size - tail_off;
+        auto tail_size = size - head_size - tail_off;
+
+        if (head_size) make_leaf_sub_pos(head, head_size).visit(v, args...);
 
         if (tail_off) visit_maybe_relaxed_sub(root, shift, tail_off, v, args...);
         else make_empty_regular_pos(root).visit(v, args...);
@@ -174,7 +292,20 @@ struct rrbtree
     void traverse(Visitor v, size_t first, size_t last, Args&&... args) const
     {
         auto tail_off  = tail_offset();
-        auto tail_size = size - tail_off;
+        auto tail_size = size - head_size - tail_off;
+
+        if (head_size) {
+            if (first < head_size)
+                make_leaf_sub_pos(head, head_size).visit(
+                    v,
+                    first,
+                    last < head_size ? last : head_size,
+                    args...);
+            if (last <= head_size)
+                return;
+            first = first > head_size ? first - head_size : 0;
+            last  = last - head_size;
+        }
 
         if (first < tail_off)
             visit_maybe_relaxed_sub(root, shift, tail_off, v,
@@ -193,8 +324,11 @@ struct rrbtree
     bool traverse_p(Visitor v, Args&&... args) const
     {
         auto tail_off  = tail_offset();
-        auto tail_size = size - tail_off;
-        return (tail_off
+        auto tail_size = size - head_size - tail_off;
+        return (head_size
+                ? make_leaf_sub_pos(head, head_size).visit(v, args...)
+                : true)
+            && (tail_off
                 ? visit_maybe_relaxed_sub(root, shift, tail_off, v, args...)
                 : make_empty_regular_pos(root).visit(v, args...))
             && (tail_size
@@ -206,7 +340,22 @@ struct rrbtree
     bool traverse_p(Visitor v, size_t first, size_t last, Args&&... args) const
     {
         auto tail_off  = tail_offset();
-        auto tail_size = size - tail_off;
+        auto tail_size = size - head_size - tail_off;
+
+        if (head_size) {
+            if (first < head_size &&
+                !make_leaf_sub_pos(head, head_size).visit(
+                    v,
+                    first,
+                    last < head_size ? last : head_size,
+                    args...))
+                return false;
+            if (last <= head_size)
+                return true;
+            first = first > head_size ? first - head_size : 0;
+            last  = last - head_size;
+        }
+
         return
             (first < tail_off
              ? visit_maybe_relaxed_sub(root, shift, tail_off, v,
@@ -226,6 +375,9 @@ struct rrbtree
     template <typename Visitor>
     decltype(auto) descend(Visitor v, size_t idx) const
     {
+        if (idx < head_size)
+            return make_leaf_descent_pos(head).visit(v, idx);
+        idx -= head_size;
         auto tail_off  = tail_offset();
         return idx >= tail_off
             ? make_leaf_descent_pos(tail).visit(v, idx - tail_off)
@@ -261,6 +413,14 @@ struct rrbtree
         using iter_t = rrbtree_iterator<T, MemoryPolicy, B, BL>;
         if (size != other.size) return false;
         if (size == 0) return true;
+        if (head_size || other.head_size) {
+            auto iter = iter_t{other};
+            return for_each_chunk_p([&] (auto first, auto last) {
+                auto r = std::equal(first, last, iter);
+                iter += last - first;
+                return r;
+            });
+        }
         auto tail_off = tail_offset();
         auto tail_off_other = other.tail_offset();
         // compare trees
@@ -396,6 +556,10 @@ struct rrbtree
 
     void push_back_mut(edit_t e, T value)
     {
+        if (head_size) {
+            mutate_body([&] { push_back_mut(e, std::move(value)); });
+            return;
+        }
         auto ts = tail_size();
         if (ts < branches<BL>) {
             ensure_mutable_tail(e, ts);
@@ -417,6 +581,8 @@ struct rrbtree
 
     rrbtree push_back(T value) const
     {
+        if (head_size)
+            return with_head(body().push_back(std::move(value)));
         auto ts = tail_size();
         if (ts < branches<BL>) {
             auto new_tail = node_t::copy_leaf_emplace(tail, ts,
@@ -438,17 +604,83 @@ struct rrbtree
         }
     }
 
+    void push_front_mut(edit_t e, T value)
+    {
+        if (size == 0) {
+            push_back_mut(e, std::move(value));
+            return;
+        } else if (head_size == 0) {
+            head = node_t::make_leaf_e(e, std::move(value));
+        } else if (head_size < branches<BL> &&
+                   std::is_nothrow_move_constructible<T>::value) {
+            ensure_mutable_head(e);
+            auto data = head->leaf();
+            new (data + head_size) T{std::move(data[head_size - 1])};
+            std::move_backward(data, data + head_size - 1,
+                               data + head_size);
+            data[0] = std::move(value);
+        } else if (head_size < branches<BL>) {
+            auto new_head = node_t::copy_leaf_emplace_front_e(
+                e, head, head_size, std::move(value));
+            dec_leaf(head, head_size);
+            head = new_head;
+        } else {
+            auto new_head = node_t::make_leaf_e(e, std::move(value));
+            try {
+                *this = without_head();
+            } catch (...) {
+                node_t::delete_leaf(new_head, 1u);
+                throw;
+            }
+            head      = new_head;
+            head_size = 0;
+        }
+        ++head_size;
+        ++size;
+    }
+
+    rrbtree push_front(T value) const
+    {
+        if (size == 0) {
+            return push_back(std::move(value));
+        } else if (head_size == 0) {
+            auto new_head = node_t::make_leaf_n(1u, std::move(value));
+            return { size + 1, shift, root->inc(), tail->inc(),
+                     new_head, 1u };
+        } else if (head_size < branches<BL>) {
+            auto new_head = node_t::copy_leaf_emplace_front(
+                head, head_size, std::move(value));
+            return { size + 1, shift, root->inc(), tail->inc(),
+                     new_head, head_size + 1 };
+        } else {
+            // the head is full, move it into the tree
+            auto new_head = node_t::make_leaf_n(1u, std::move(value));
+            try {
+                auto r = without_head();
+                r.size     += 1;
+                r.head      = new_head;
+                r.head_size = 1;
+                return r;
+            } catch (...) {
+                node_t::delete_leaf(new_head, 1u);
+                throw;
+            }
+        }
+    }
+
     std::tuple<const T*, size_t, size_t>
     region_for(size_t idx) const
     {
         using std::get;
         auto tail_off = tail_offset();
-        if (idx >= tail_off) {
-            return { tail->leaf(), tail_off, size };
+        if (idx < head_size) {
+            return { head->leaf(), 0, head_size };
+        } else if (idx - head_size >= tail_off) {
+            return { tail->leaf(), head_size + tail_off, size };
         } else {
             auto subs = visit_maybe_relaxed_sub(
                 root, shift, tail_off,
-                region_for_visitor<T>(), idx);
+                region_for_visitor<T>(), idx - head_size);
             auto first = idx - get<1>(subs);
             auto end   = first + get<2>(subs);
             return { get<0>(subs), first, end };
@@ -457,6 +689,15 @@ struct rrbtree
 
     T& get_mut(edit_t e, size_t idx)
     {
+        if (idx < head_size) {
+            ensure_mutable_head(e);
+            return head->leaf() [idx];
+        } else if (head_size) {
+            auto r = static_cast<T*>(nullptr);
+            auto body_idx = idx - head_size;
+            mutate_body([&] { r = &get_mut(e, body_idx); });
+            return *r;
+        }
         auto tail_off = tail_offset();
         if (idx >= tail_off) {
             ensure_mutable_tail(e, size - tail_off);
@@ -500,6 +741,15 @@ struct rrbtree
     template <typename FnT>
     rrbtree update(size_t idx, FnT&& fn) const
     {
+        if (idx < head_size) {
+            auto new_head = make_leaf_sub_pos(head, head_size)
+                .visit(update_visitor<node_t>{}, idx, fn);
+            return { size, shift, root->inc(), tail->inc(),
+                     new_head, head_size };
+        } else if (head_size) {
+            return with_head(body().update(idx - head_size,
+                                           std::forward<FnT>(fn)));
+        }
         auto tail_off  = tail_offset();
         if (idx >= tail_off) {
             auto tail_size = size - tail_off;
@@ -535,6 +785,11 @@ struct rrbtree
             *this = empty();
         } else if (new_size >= size) {
             return;
+        } else if (new_size <= head_size) {
+            *this = take(new_size);
+        } else if (head_size) {
+            auto body_size = new_size - head_size;
+            mutate_body([&] { take_mut(e, body_size); });
         } else if (new_size > tail_off) {
             auto ts    = size - tail_off;
             auto newts = new_size - tail_off;
@@ -576,6 +831,11 @@ struct rrbtree
             return empty();
         } else if (new_size >= size) {
             return *this;
+        } else if (new_size <= head_size) {
+            auto new_tail = node_t::copy_leaf(head, new_size);
+            return { new_size, BL, empty().root->inc(), new_tail };
+        } else if (head_size) {
+            return with_head(body().take(new_size - head_size));
         } else if (new_size > tail_off) {
             auto new_tail = node_t::copy_leaf(tail, new_size - tail_off);
             return { new_size, shift, root->inc(), new_tail };
@@ -605,6 +865,52 @@ struct rrbtree
             return;
         } else if (elems >= size) {
             *this = empty();
+        } else if (elems < head_size) {
+            if (std::is_nothrow_move_constructible<T>::value &&
+                head->can_mutate(e)) {
+                auto data = head->leaf();
+                std::move(data + elems, data + head_size, data);
+                destroy_n(data + head_size - elems, elems);
+            } else {
+                auto new_head = node_t::copy_leaf_e(e, head, elems,
+                                                    head_size);
+                dec_leaf(head, head_size);
+                head = new_head;
+            }
+            head_size -= elems;
+            size      -= elems;
+        } else if (head_size) {
+            // not using mutate_body(), the body may get a new head
+            auto h  = head;
+            auto hs = head_size;
+            head      = nullptr;
+            head_size = 0;
+            size     -= hs;
+            try {
+                drop_mut(e, elems - hs);
+            } catch (...) {
+                size     += hs;
+                head      = h;
+                head_size = hs;
+                throw;
+            }
+            dec_leaf(h, hs);
+        } else if (elems < tail_off && elems < get<1>(first_leaf())) {
+            // dropping from the front of the first leaf, make the rest
+            // of it the head, so that following drops are cheap
+            auto leaf      = first_leaf();
+            auto leaf_size = get<1>(leaf);
+            auto new_head  = node_t::copy_leaf_e(e, get<0>(leaf),
+                                                 elems, leaf_size);
+            try {
+                drop_mut(e, leaf_size);
+            } catch (...) {
+                node_t::delete_leaf(new_head, leaf_size - elems);
+                throw;
+            }
+            head      = new_head;
+            head_size = leaf_size - elems;
+            size     += head_size;
         } else if (elems == tail_off) {
             dec_inner(root, shift, tail_off);
             shift = BL;
@@ -634,10 +940,33 @@ struct rrbtree
 
     rrbtree drop(size_t elems) const
     {
+        using std::get;
         if (elems == 0) {
             return *this;
         } else if (elems >= size) {
             return empty();
+        } else if (elems < head_size) {
+            auto new_head = node_t::copy_leaf(head, elems, head_size);
+            return { size - elems, shift, root->inc(), tail->inc(),
+                     new_head, count_t(head_size - elems) };
+        } else if (head_size) {
+            return body().drop(elems - head_size);
+        } else if (elems < tail_offset() && elems < get<1>(first_leaf())) {
+            // dropping from the front of the first leaf, make the rest
+            // of it the head, so that following drops are cheap
+            auto leaf      = first_leaf();
+            auto leaf_size = get<1>(leaf);
+            auto new_head  = node_t::copy_leaf(get<0>(leaf), elems, leaf_size);
+            try {
+                auto r = drop(leaf_size);
+                r.size     += leaf_size - elems;
+                r.head      = new_head;
+                r.head_size = leaf_size - elems;
+                return r;
+            } catch (...) {
+                node_t::delete_leaf(new_head, leaf_size - elems);
+                throw;
+            }
         } else if (elems == tail_offset()) {
             return { size - elems, BL, empty().root->inc(), tail->inc() };
         } else if (elems > tail_offset()) {
@@ -664,6 +993,10 @@ struct rrbtree
             return r;
         else if (r.size == 0)
             return *this;
+        else if (r.head_size)
+            return concat(r.without_head());
+        else if (head_size)
+            return with_head(body().concat(r));
         else if (r.tail_offset() == 0) {
             // just concat the tail, similar to push_back
             auto tail_offst = tail_offset();
@@ -735,6 +1068,10 @@ struct rrbtree
             l = r;
         else if (r.size == 0)
             return;
+        else if (r.head_size)
+            concat_mut_l(l, el, r.without_head());
+        else if (l.head_size)
+            l.mutate_body([&] { concat_mut_l(l, el, r); });
         else if (r.tail_offset() == 0) {
             // just concat the tail, similar to push_back
             auto tail_offst = l.tail_offset();
@@ -833,7 +1170,13 @@ struct rrbtree
             r = std::move(l);
         else if (l.size == 0)
             return;
-        else if (r.tail_offset() == 0) {
+        else if (r.head_size) {
+            r = r.without_head();
+            concat_mut_r(l, r, er);
+        } else if (l.head_size) {
+            concat_mut_r(l.body(), r, er);
+            r = l.with_head(std::move(r));
+        } else if (r.tail_offset() == 0) {
             // just concat the tail, similar to push_back
             auto tail_offst = l.tail_offset();
             auto tail_size  = l.size - tail_offst;
@@ -948,6 +1291,11 @@ struct rrbtree
             l = r;
         else if (r.size == 0)
             return;
+        else if (r.head_size) {
+            r = r.without_head();
+            concat_mut_lr_l(l, el, r, er);
+        } else if (l.head_size)
+            l.mutate_body([&] { concat_mut_lr_l(l, el, r, er); });
         else if (r.tail_offset() == 0) {
             // just concat the tail, similar to push_back
             auto tail_offst = l.tail_offset();
@@ -1056,7 +1404,28 @@ struct rrbtree
             r = l;
         else if (l.size == 0)
             return;
-        else if (r.tail_offset() == 0) {
+        else if (r.head_size) {
+            r = r.without_head();
+            concat_mut_lr_r(l, el, r, er);
+        } else if (l.head_size) {
+            // the head of `l` becomes the head of the result
+            auto h  = l.head;
+            auto hs = l.head_size;
+            l.head      = nullptr;
+            l.head_size = 0;
+            l.size     -= hs;
+            try {
+                concat_mut_lr_r(l, el, r, er);
+            } catch (...) {
+                l.size     += hs;
+                l.head      = h;
+                l.head_size = hs;
+                throw;
+            }
+            r.size     += hs;
+            r.head      = h;
+            r.head_size = hs;
+        } else if (r.tail_offset() == 0) {
             // just concat the tail, similar to push_back
             auto tail_offst = l.tail_offset();
             auto tail_size  = l.size - tail_offst;
@@ -1168,17 +1537,23 @@ struct rrbtree
         shift = empty_.shift;
         root = empty_.root;
         tail = empty_.tail;
+        head = nullptr;
+        head_size = 0;
     }
 
     bool check_tree() const
     {
         assert(shift <= sizeof(size_t) * 8 - BL);
         assert(shift >= BL);
-        assert(tail_offset() <= size);
+        assert(head_size <= branches<BL>);
+        assert(!head_size == !head);
+        assert(!head_size || head_size < size);
+        assert(tail_offset() <= size - head_size);
         assert(tail_size() <= branches<BL>);
 #if IMMER_DEBUG_DEEP_CHECK
         assert(check_root());
         assert(check_tail());
+        assert(check_head());
 #endif
         return true;
     }
@@ -1192,6 +1567,15 @@ struct rrbtree
         return true;
     }
 
+    bool check_head() const
+    {
+#if IMMER_DEBUG_DEEP_CHECK
+        if (head_size > 0)
+            assert(head->check(endshift<B, BL>, head_size));
+#endif
+        return true;
+    }
+
     bool check_root() const
     {
 #if IMMER_DEBUG_DEEP_CHECK
@@ -1212,8 +1596,12 @@ struct rrbtree
             << "--" << std::endl
             << "{" << std::endl
             << "  size  = " << size << std::endl
-            << "  shift = " << shift << std::endl
-            << "  root  = " << std::endl;
+            << "  shift = " << shift << std::endl;
+        if (head_size) {
+            out << "  head  = " << std::endl;
+            debug_print_node(out, head, endshift<B, BL>, head_size);
+        }
+        out << "  root  = " << std::endl;
         debug_print_node(out, root, shift, tail_offset());
         out << "  tail  = " << std::endl;
         debug_print_node(out, tail, endshift<B, BL>, tail_size());
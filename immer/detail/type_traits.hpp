@@ -9,10 +9,12 @@
 #pragma once
 
 #include <algorithm>
+#include <functional>
 #include <iterator>
 #include <memory>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 namespace immer {
 namespace detail {
@@ -83,6 +85,37 @@ struct is_subtractable
 template <typename T, typename U = T>
 constexpr bool is_subtractable_v = is_subtractable<T, U>::value;
 
+template <typename T, typename = void>
+struct is_transparent : std::false_type {};
+
+template <typename T>
+struct is_transparent<T, void_t<typename T::is_transparent>> :
+    std::true_type {};
+
+template <typename T>
+constexpr bool is_transparent_v = is_transparent<T>::value;
+
+template <typename T, typename = void>
+struct is_executor : std::false_type {};
+
+template <typename T>
+struct is_executor
+<T, void_t<decltype(std::declval<std::decay_t<T>&>()(
+        std::declval<std::vector<std::function<void()>>&>()))>> :
+    std::true_type {};
+
+template <typename T>
+constexpr bool is_executor_v = is_executor<T>::value;
+
+/*!
+ * Is `Key` when both `Hash` and `Equal` are transparent, so the
+ * containers can be looked up with keys of other types than their
+ * own.  Otherwise, it is ill-formed.
+ */
+template <typename Hash, typename Equal, typename Key>
+using transparent_key_t = std::enable_if_t<
+    is_transparent_v<Hash> && is_transparent_v<Equal>, Key>;
+
 namespace swappable {
 
 using std::swap;
@@ -187,5 +220,16 @@ template<typename T, typename U, typename V>
 constexpr bool std_uninitialized_copy_supports_v = 
   std_uninitialized_copy_supports<T, U, V>::value;
 
+template<typename T, typename = void>
+struct has_make_immortal : std::false_type {};
+
+template<typename T>
+struct has_make_immortal
+<T, void_t<decltype(std::declval<T&>().make_immortal())>> :
+  std::true_type {};
+
+template<typename T>
+constexpr bool has_make_immortal_v = has_make_immortal<T>::value;
+
 }
 }
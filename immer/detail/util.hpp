@@ -124,6 +124,20 @@ template <bool b, typename R=void, typename F1, typename F2>
 auto static_if(F1&& f1, F2&& f2) -> std::enable_if_t<!b, R>
 { return std::forward<F2>(f2)(empty_t{}); }
 
+/*!
+ * Makes the reference count `r` immortal.  Refcount policies without
+ * a `make_immortal()` method keep the count they have, that is never
+ * released by the shared empty nodes.
+ */
+template <typename RefcountPolicy>
+auto make_refs_immortal(RefcountPolicy& r)
+    -> std::enable_if_t<has_make_immortal_v<RefcountPolicy>>
+{ r.make_immortal(); }
+template <typename RefcountPolicy>
+auto make_refs_immortal(RefcountPolicy&)
+    -> std::enable_if_t<!has_make_immortal_v<RefcountPolicy>>
+{}
+
 template <typename T, T value>
 struct constantly
 {
@@ -0,0 +1,101 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace immer {
+
+/**
+ * @defgroup executors
+ * @{
+ */
+
+/*!
+ * Executor that runs the tasks one after the other in the calling
+ * thread.
+ *
+ * An *executor* is a function object that is called with a
+ * `std::vector<std::function<void()>>&` and runs all the tasks in it,
+ * in any order and possibly at the same time, returning once all of
+ * them are done.  The parallel algorithms in `immer/algorithm.hpp`
+ * take one to run the parts of the traversal in.
+ */
+struct sequential_executor
+{
+    void operator() (std::vector<std::function<void()>>& tasks) const
+    {
+        for (auto& task : tasks)
+            task();
+    }
+};
+
+/*!
+ * Executor that runs the tasks on up to `concurrency` threads, the
+ * calling thread being one of them.  The other threads are started
+ * for every call, which is cheap compared to the traversal of big
+ * containers.  If some task throws, the other tasks are still run and
+ * the first exception is rethrown in the calling thread.
+ */
+class thread_executor
+{
+public:
+    explicit thread_executor(
+        unsigned concurrency = std::thread::hardware_concurrency())
+        : concurrency_{std::max(concurrency, 1u)}
+    {}
+
+    unsigned concurrency() const { return concurrency_; }
+
+    void operator() (std::vector<std::function<void()>>& tasks) const
+    {
+        std::atomic<std::size_t> next{0};
+        auto error = std::exception_ptr{};
+        std::mutex error_mutex;
+        auto work = [&] {
+            for (auto i = next++; i < tasks.size(); i = next++) {
+                try {
+                    tasks[i]();
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock{error_mutex};
+                    if (!error)
+                        error = std::current_exception();
+                }
+            }
+        };
+        auto threads = std::vector<std::thread>{};
+        auto n = std::min<std::size_t>(concurrency_, tasks.size());
+        try {
+            threads.reserve(n);
+            for (auto i = std::size_t{1}; i < n; ++i)
+                threads.emplace_back(work);
+        } catch (...) {
+            // the tasks that did not get a thread are run below
+        }
+        work();
+        for (auto& t : threads)
+            t.join();
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+private:
+    unsigned concurrency_;
+};
+
+/** @} */ // group: executors
+
+} // namespace immer
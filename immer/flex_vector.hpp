@@ -12,6 +12,8 @@
 #include "detail/rbts/rrbtree_iterator.hpp"
 #include "memory_policy.hpp"
 
+#include <functional>
+
 namespace immer {
 
 template <typename T,
@@ -221,8 +223,8 @@ public:
     { return push_back_move(move_t{}, std::move(value)); }
 
     /*!
-     * Returns a flex_vector with `value` inserted at the frony.  It may
-     * allocate memory and its complexity is @f$ O(log(size)) @f$.
+     * Returns a flex_vector with `value` inserted at the front.  It may
+     * allocate memory and its complexity is *effectively* @f$ O(1) @f$.
      *
      * @rst
      *
@@ -235,8 +237,11 @@ public:
      *
      * @endrst
      */
-    flex_vector push_front(value_type value) const
-    { return flex_vector{}.push_back(value) + *this; }
+    flex_vector push_front(value_type value) const&
+    { return impl_.push_front(std::move(value)); }
+
+    decltype(auto) push_front(value_type value) &&
+    { return push_front_move(move_t{}, std::move(value)); }
 
     /*!
      * Returns a flex_vector containing value `value` at position `index`.
@@ -261,6 +266,28 @@ public:
     decltype(auto) set(size_type index, value_type value) &&
     { return set_move(move_t{}, index, std::move(value)); }
 
+    /*!
+     * Like `set(index, value)`, but when `value` is equal to the
+     * element at position `index`, as compared by `eq`, it returns the
+     * same flex_vector without allocating memory.
+     */
+    template <typename Eq = std::equal_to<T>>
+    flex_vector set_if_changed(size_type index, value_type value,
+                               Eq&& eq = Eq{}) const&
+    {
+        if (eq(impl_.get(index), value))
+            return *this;
+        return impl_.assoc(index, std::move(value));
+    }
+
+    template <typename Eq = std::equal_to<T>>
+    decltype(auto) set_if_changed(size_type index, value_type value,
+                                  Eq&& eq = Eq{}) &&
+    {
+        return set_if_changed_move(move_t{}, index, std::move(value),
+                                   std::forward<Eq>(eq));
+    }
+
     /*!
      * Returns a vector containing the result of the expression
      * `fn((*this)[idx])` at position `idx`.
@@ -465,11 +492,29 @@ private:
     flex_vector push_back_move(std::false_type, value_type value)
     { return impl_.push_back(std::move(value)); }
 
+    flex_vector&& push_front_move(std::true_type, value_type value)
+    { impl_.push_front_mut({}, std::move(value)); return std::move(*this); }
+    flex_vector push_front_move(std::false_type, value_type value)
+    { return impl_.push_front(std::move(value)); }
+
     flex_vector&& set_move(std::true_type, size_type index, value_type value)
     { impl_.assoc_mut({}, index, std::move(value)); return std::move(*this); }
     flex_vector set_move(std::false_type, size_type index, value_type value)
     { return impl_.assoc(index, std::move(value)); }
 
+    template <typename Eq>
+    flex_vector&& set_if_changed_move(std::true_type, size_type index,
+                                     value_type value, Eq&& eq)
+    {
+        if (!eq(impl_.get(index), value))
+            impl_.assoc_mut({}, index, std::move(value));
+        return std::move(*this);
+    }
+    template <typename Eq>
+    flex_vector set_if_changed_move(std::false_type, size_type index,
+                                   value_type value, Eq&& eq)
+    { return set_if_changed(index, std::move(value), std::forward<Eq>(eq)); }
+
     template <typename Fn>
     flex_vector&& update_move(std::true_type, size_type index, Fn&& fn)
     { impl_.update_mut({}, index, std::forward<Fn>(fn)); return std::move(*this); }
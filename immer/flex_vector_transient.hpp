@@ -145,6 +145,13 @@ public:
     void push_back(value_type value)
     { impl_.push_back_mut(*this, std::move(value)); }
 
+    /*!
+     * Inserts `value` at the front.  It may allocate memory and its
+     * complexity is *effectively* @f$ O(1) @f$.
+     */
+    void push_front(value_type value)
+    { impl_.push_front_mut(*this, std::move(value)); }
+
     /*!
      * Sets to the value `value` at position `idx`.
      * Undefined for `index >= size()`.
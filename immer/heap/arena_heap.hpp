@@ -0,0 +1,197 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#pragma once
+
+#include "config.hpp"
+#include "heap/malloc_heap.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+namespace immer {
+
+class arena;
+
+namespace detail {
+
+inline arena*& current_arena()
+{
+    thread_local static arena* current_ = nullptr;
+    return current_;
+}
+
+/*!
+ * Disables the current arena of the thread for as long as it lives.
+ * Used to allocate objects that must outlive any arena, like the
+ * shared empty nodes of the containers.
+ */
+struct arena_bypass
+{
+    arena* previous = current_arena();
+
+    arena_bypass() { current_arena() = nullptr; }
+    ~arena_bypass() { current_arena() = previous; }
+    arena_bypass(const arena_bypass&) = delete;
+    arena_bypass& operator=(const arena_bypass&) = delete;
+};
+
+template <typename Fn>
+auto without_arena(Fn&& fn)
+{
+    arena_bypass bypass;
+    return std::forward<Fn>(fn)();
+}
+
+} // namespace detail
+
+/*!
+ * A region of memory where objects are allocated by just bumping a
+ * pointer, and that is released as a whole, in one go, when the
+ * arena is destroyed.
+ *
+ * While an arena is alive, it is the *current arena* of the thread
+ * that created it, and it is used by all the @ref arena_heap
+ * allocations of that thread.  Arenas nest: when an arena is
+ * destroyed, the one that was current when it was created becomes
+ * current again.  Thus, arenas must be destroyed in the reverse order
+ * of their creation, in the same thread, which happens naturally
+ * when they are used as scoped variables.
+ *
+ * The memory is requested from `std::malloc` in chunks of
+ * `chunk_size` bytes, or bigger when an object does not fit in one.
+ */
+class arena
+{
+public:
+    explicit arena(std::size_t chunk_size = default_arena_chunk_size)
+        : chunk_size_{chunk_size}
+        , previous_{detail::current_arena()}
+    {
+        detail::current_arena() = this;
+    }
+
+    ~arena()
+    {
+        assert(detail::current_arena() == this);
+        detail::current_arena() = previous_;
+        while (chunks_) {
+            auto next = chunks_->next;
+            std::free(chunks_);
+            chunks_ = next;
+        }
+    }
+
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    /*!
+     * Returns a pointer to a memory region of size `size` inside the
+     * arena.  It throws `std::bad_alloc` when it can not be allocated.
+     */
+    void* allocate(std::size_t size)
+    {
+        size = (size + alignment - 1) & ~(alignment - 1);
+        if (IMMER_UNLIKELY(size > std::size_t(end_ - cur_)))
+            grow(size);
+        auto p = cur_;
+        cur_ += size;
+        return p;
+    }
+
+private:
+    static constexpr std::size_t alignment = alignof(std::max_align_t);
+
+    union chunk_t
+    {
+        chunk_t* next;
+        std::max_align_t align_;
+    };
+
+    void grow(std::size_t size)
+    {
+        auto n = std::max(size, chunk_size_);
+        auto c = static_cast<chunk_t*>(std::malloc(sizeof(chunk_t) + n));
+        if (IMMER_UNLIKELY(!c))
+            throw std::bad_alloc{};
+        c->next = chunks_;
+        chunks_ = c;
+        cur_    = reinterpret_cast<char*>(c + 1);
+        end_    = cur_ + n;
+    }
+
+    std::size_t chunk_size_;
+    arena* previous_;
+    chunk_t* chunks_ = nullptr;
+    char* cur_ = nullptr;
+    char* end_ = nullptr;
+};
+
+/*!
+ * A heap that allocates from the current @ref arena of the thread,
+ * or from `Base` when there is none.  Deallocating memory from an
+ * arena does nothing: it is only released when the arena is
+ * destroyed.  Memory that is taken from `Base` is returned to it.
+ * Every allocation is preceded by a header that records how to
+ * release it.
+ *
+ * @rst
+ *
+ * .. tip:: This heap is meant to be used together with a
+ *    :cpp:class:`no_refcount_policy`.  This way, containers never
+ *    traverse their nodes when they are destroyed, and the cost of
+ *    releasing all the containers built inside an arena is that of
+ *    releasing its few big chunks of memory.
+ *
+ * .. caution:: Containers allocated in an arena must not be used
+ *    once it has been destroyed.  Also, when reference counting is
+ *    disabled, the destructors of the contained objects will never be
+ *    called, as with a :cpp:class:`gc_heap`, and the memory taken
+ *    from `Base` outside of an arena is never released.
+ *
+ * @endrst
+ */
+template <typename Base = malloc_heap>
+struct arena_heap
+{
+    template <typename... Tags>
+    static void* allocate(std::size_t size, Tags... tags)
+    {
+        auto a = detail::current_arena();
+        auto p = static_cast<header_t*>(
+            a ? a->allocate(sizeof(header_t) + size)
+              : Base::allocate(sizeof(header_t) + size, tags...));
+        p->release = a ? nullptr : &release_base;
+        return p + 1;
+    }
+
+    template <typename... Tags>
+    static void deallocate(std::size_t size, void* data, Tags...)
+    {
+        auto p = static_cast<header_t*>(data) - 1;
+        if (p->release)
+            p->release(sizeof(header_t) + size, p);
+    }
+
+private:
+    struct alignas(std::max_align_t) header_t
+    {
+        void (*release) (std::size_t, void*);
+    };
+
+    static void release_base(std::size_t size, void* p)
+    {
+        Base::deallocate(size, p);
+    }
+};
+
+} // namespace immer
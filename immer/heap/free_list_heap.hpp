@@ -8,11 +8,14 @@
 
 #pragma once
 
+#include "config.hpp"
 #include "heap/with_data.hpp"
 #include "heap/free_list_node.hpp"
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <thread>
 
 namespace immer {
 
@@ -21,30 +24,104 @@ namespace immer {
  * instead it keeps the memory in a thread-safe global free list. Must
  * be preceded by a `with_data<free_list_node, ...>` heap adaptor.
  *
- * @tparam Size Maximum size of the objects to be allocated.
- * @tparam Base Type of the parent heap.
+ * The free list is split in `Shards` independent stacks, each living
+ * in its own cache line and protected by a tiny lock that is only
+ * ever *tried*, never waited on.  Every thread has a home shard that
+ * it visits first, and it moves on to the next shard when the lock
+ * is taken or the shard can not serve the request, falling back to
+ * the parent heap after a full round.  Since nodes are only ever
+ * unlinked while holding the lock of their shard, the free list is
+ * not subject to the ABA problem of a naive lock-free stack, and
+ * threads working on different shards do not contend.
+ *
+ * Besides single nodes, whole chains of nodes can be moved in and
+ * out with `allocate_batch()` and `deallocate_batch()` at the cost of
+ * a single lock acquisition.  This is used by @ref
+ * thread_local_free_list_heap to exchange *magazines* of nodes with
+ * this global *depot*.  A shard that is empty always accepts a batch,
+ * even if it is bigger than its share of the limit.
+ *
+ * The free list can be filled in advance with `reserve()`, and
+ * emptied with `trim()`, for example after a burst of allocations.
+ * Its limit can be changed at runtime with `set_limit()`.
+ *
+ * @tparam Size   Maximum size of the objects to be allocated.
+ * @tparam Limit  Initial maximum number of elements to keep in the
+ *                free list.
+ * @tparam Base   Type of the parent heap.
+ * @tparam Shards Number of independent stacks the free list is split in.
  */
-template <std::size_t Size, std::size_t Limit, typename Base>
+template <std::size_t Size,
+          std::size_t Limit,
+          typename Base,
+          std::size_t Shards = default_free_list_shards>
 struct free_list_heap : Base
 {
     using base_t = Base;
 
+    static_assert(Shards > 0, "");
+
     template <typename... Tags>
     static void* allocate(std::size_t size, Tags...)
     {
         assert(size <= sizeof(free_list_node) + Size);
         assert(size >= sizeof(free_list_node));
 
-        free_list_node* n;
-        do {
-            n = head().data;
-            if (!n) {
-                auto p = base_t::allocate(Size + sizeof(free_list_node));
-                return static_cast<free_list_node*>(p);
+        auto idx = home();
+        for (auto i = std::size_t{}; i < Shards; ++i) {
+            auto& s = shard(idx + i);
+            if (s.count.load(std::memory_order_relaxed) && s.try_lock()) {
+                if (!s.data && s.batches) {
+                    auto b    = s.batches;
+                    s.batches = free_list_batch::of(b).next;
+                    s.data    = b;
+                }
+                auto n = s.data;
+                if (n) {
+                    s.data = n->next;
+                    s.count.store(s.count.load(std::memory_order_relaxed) - 1,
+                                  std::memory_order_relaxed);
+                }
+                s.unlock();
+                if (n)
+                    return n;
             }
-        } while (!head().data.compare_exchange_weak(n, n->next));
-        head().count.fetch_sub(1u, std::memory_order_relaxed);
-        return n;
+        }
+        auto p = base_t::allocate(Size + sizeof(free_list_node));
+        return static_cast<free_list_node*>(p);
+    }
+
+    /*!
+     * Takes a whole chain of free nodes out of the free list, storing
+     * its length in `count`.  Returns `nullptr` when there are no free
+     * nodes available.  Batches are only available when the nodes
+     * are big enough to hold a `free_list_batch`.
+     */
+    template <std::size_t S = Size,
+              std::enable_if_t<(S >= sizeof(free_list_batch)), bool> = true>
+    static free_list_node* allocate_batch(std::size_t& count)
+    {
+        auto idx = home();
+        for (auto i = std::size_t{}; i < Shards; ++i) {
+            auto& s = shard(idx + i);
+            if (s.count.load(std::memory_order_relaxed) && s.try_lock()) {
+                auto n = s.batches;
+                auto c = s.count.load(std::memory_order_relaxed);
+                if (n) {
+                    s.batches = free_list_batch::of(n).next;
+                    count     = free_list_batch::of(n).count;
+                } else {
+                    n      = s.data;
+                    count  = c;
+                    s.data = nullptr;
+                }
+                s.count.store(c - count, std::memory_order_relaxed);
+                s.unlock();
+                if (n)
+                    return n;
+            }
+        }
+        return nullptr;
     }
 
     template <typename... Tags>
@@ -55,28 +132,196 @@ struct free_list_heap : Base
 
         // we use relaxed, because we are fine with temporarily having
         // a few more/less buffers in free list
-        if (head().count.load(std::memory_order_relaxed) >= Limit) {
-            base_t::deallocate(Size + sizeof(free_list_node), data);
-        } else {
-            auto n = static_cast<free_list_node*>(data);
-            do {
-                n->next = head().data;
-            } while (!head().data.compare_exchange_weak(n->next, n));
-            head().count.fetch_add(1u, std::memory_order_relaxed);
+        auto n   = static_cast<free_list_node*>(data);
+        auto idx = home();
+        for (auto i = std::size_t{}; i < Shards; ++i) {
+            auto& s = shard(idx + i);
+            if (s.count.load(std::memory_order_relaxed) < shard_limit() &&
+                s.try_lock()) {
+                auto count = s.count.load(std::memory_order_relaxed);
+                auto fits  = count < shard_limit();
+                if (fits) {
+                    n->next = s.data;
+                    s.data  = n;
+                    s.count.store(count + 1, std::memory_order_relaxed);
+                }
+                s.unlock();
+                if (fits)
+                    return;
+            }
+        }
+        base_t::deallocate(Size + sizeof(free_list_node), data);
+    }
+
+    /*!
+     * Puts a whole chain of `count` free nodes, linked through their
+     * `next` pointers and starting at `n`, into the free list.  When
+     * there is no room for it, the nodes are released to the parent
+     * heap.
+     */
+    template <std::size_t S = Size,
+              std::enable_if_t<(S >= sizeof(free_list_batch)), bool> = true>
+    static void deallocate_batch(free_list_node* n, std::size_t count)
+    {
+        assert(n && count);
+
+        auto idx = home();
+        for (auto i = std::size_t{}; i < Shards; ++i) {
+            auto& s = shard(idx + i);
+            if (fits(s.count.load(std::memory_order_relaxed), count) &&
+                s.try_lock()) {
+                auto c  = s.count.load(std::memory_order_relaxed);
+                auto ok = fits(c, count);
+                if (ok) {
+                    free_list_batch::of(n) = { s.batches, count };
+                    s.batches = n;
+                    s.count.store(c + count, std::memory_order_relaxed);
+                }
+                s.unlock();
+                if (ok)
+                    return;
+            }
+        }
+        release(n);
+    }
+
+    /*!
+     * Allocates nodes from the parent heap and puts them in the free
+     * list until it holds `n` nodes, or as many as its limit allows.
+     */
+    static void reserve(std::size_t n)
+    {
+        auto per_shard = std::min((n + Shards - 1) / Shards, shard_limit());
+        for (auto i = std::size_t{}; i < Shards; ++i) {
+            auto& s = shard(i);
+            auto count = s.count.load(std::memory_order_relaxed);
+            auto chain = static_cast<free_list_node*>(nullptr);
+            auto added = std::size_t{};
+            for (; count + added < per_shard; ++added) {
+                auto p = base_t::allocate(Size + sizeof(free_list_node));
+                auto node  = static_cast<free_list_node*>(p);
+                node->next = chain;
+                chain      = node;
+            }
+            if (chain) {
+                s.lock();
+                auto last = chain;
+                while (last->next)
+                    last = last->next;
+                last->next = s.data;
+                s.data     = chain;
+                s.count.store(s.count.load(std::memory_order_relaxed) + added,
+                              std::memory_order_relaxed);
+                s.unlock();
+            }
+        }
+    }
+
+    /*!
+     * Releases all the nodes in the free list to the parent heap.
+     */
+    static void trim()
+    {
+        for (auto i = std::size_t{}; i < Shards; ++i) {
+            auto& s = shard(i);
+            s.lock();
+            auto data    = s.data;
+            auto batches = s.batches;
+            s.data    = nullptr;
+            s.batches = nullptr;
+            s.count.store(0, std::memory_order_relaxed);
+            s.unlock();
+            release(data);
+            while (batches) {
+                auto next = free_list_batch::of(batches).next;
+                release(batches);
+                batches = next;
+            }
         }
     }
 
+    /*!
+     * Returns the maximum number of elements kept in the free list.
+     */
+    static std::size_t limit()
+    {
+        return limit_().load(std::memory_order_relaxed);
+    }
+
+    /*!
+     * Changes the maximum number of elements kept in the free list.
+     * When it is lowered, the nodes that are already in the free list
+     * stay there until they are allocated or `trim()` is called.
+     */
+    static void set_limit(std::size_t n)
+    {
+        limit_().store(n, std::memory_order_relaxed);
+    }
+
 private:
-    struct head_t
+    static std::atomic<std::size_t>& limit_()
     {
-        std::atomic<free_list_node*> data;
+        static std::atomic<std::size_t> limit_{Limit};
+        return limit_;
+    }
+
+    static std::size_t shard_limit()
+    {
+        return (limit() + Shards - 1) / Shards;
+    }
+
+    static bool fits(std::size_t count, std::size_t n)
+    {
+        auto limit = shard_limit();
+        return limit && (count == 0 || count + n <= limit);
+    }
+
+    static void release(free_list_node* n)
+    {
+        while (n) {
+            auto next = n->next;
+            base_t::deallocate(Size + sizeof(free_list_node), n);
+            n = next;
+        }
+    }
+
+    struct alignas(cache_line_size) shard_t
+    {
+        std::atomic<bool> locked;
         std::atomic<std::size_t> count;
+        free_list_node* data;
+        free_list_node* batches;
+
+        bool try_lock()
+        {
+            return !locked.load(std::memory_order_relaxed) &&
+                !locked.exchange(true, std::memory_order_acquire);
+        }
+
+        void lock()
+        {
+            while (!try_lock())
+                std::this_thread::yield();
+        }
+
+        void unlock()
+        {
+            locked.store(false, std::memory_order_release);
+        }
     };
 
-    static head_t& head()
+    static shard_t& shard(std::size_t idx)
+    {
+        static shard_t shards_[Shards] = {};
+        return shards_[idx % Shards];
+    }
+
+    static std::size_t home()
     {
-        static head_t head_{{nullptr}, {0}};
-        return head_;
+        static std::atomic<std::size_t> next_{0};
+        thread_local static auto home_ =
+            next_.fetch_add(1u, std::memory_order_relaxed);
+        return home_;
     }
 };
 
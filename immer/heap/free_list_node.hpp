@@ -17,6 +17,23 @@ struct free_list_node
     free_list_node* next;
 };
 
+/*!
+ * Bookkeeping for a whole chain of free nodes, linked through their
+ * `next` pointers, that is moved between free lists at once.  It is
+ * stored in the otherwise unused memory of the first node of the
+ * chain, right after its `free_list_node`.
+ */
+struct free_list_batch
+{
+    free_list_node* next;
+    std::size_t count;
+
+    static free_list_batch& of(free_list_node* n)
+    {
+        return *reinterpret_cast<free_list_batch*>(n + 1);
+    }
+};
+
 template <typename Base>
 struct with_free_list_node
     : with_data<free_list_node, Base>
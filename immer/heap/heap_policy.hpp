@@ -8,14 +8,21 @@
 
 #pragma once
 
+#include "heap/arena_heap.hpp"
 #include "heap/debug_size_heap.hpp"
 #include "heap/free_list_heap.hpp"
+#include "heap/remote_free_list_heap.hpp"
 #include "heap/split_heap.hpp"
+#include "heap/stats_heap.hpp"
 #include "heap/thread_local_free_list_heap.hpp"
 #include "config.hpp"
 
 #include <cstdlib>
 #include <algorithm>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <vector>
 
 namespace immer {
 
@@ -34,6 +41,141 @@ struct heap_policy
     };
 };
 
+namespace detail {
+
+/*!
+ * Keeps track of the free lists, one per object size, that the heaps
+ * of `HeapPolicy` have used so far, so that they can be managed all
+ * at once.
+ */
+template <typename HeapPolicy>
+class free_list_registry
+{
+public:
+    template <typename FreeLists>
+    static bool add()
+    {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock{s.mutex};
+        if (s.limit != no_limit)
+            FreeLists::set_limit(s.limit);
+        s.entries.push_back({&FreeLists::reserve,
+                             &FreeLists::trim,
+                             &FreeLists::set_limit});
+        return true;
+    }
+
+    static void reserve(std::size_t n)
+    {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock{s.mutex};
+        for (auto& e : s.entries)
+            e.reserve(n);
+    }
+
+    static void trim()
+    {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock{s.mutex};
+        for (auto& e : s.entries)
+            e.trim();
+    }
+
+    static void set_limit(std::size_t n)
+    {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock{s.mutex};
+        s.limit = n;
+        for (auto& e : s.entries)
+            e.set_limit(n);
+    }
+
+private:
+    static constexpr auto no_limit = std::numeric_limits<std::size_t>::max();
+
+    struct entry
+    {
+        void (*reserve)(std::size_t);
+        void (*trim)();
+        void (*set_limit)(std::size_t);
+    };
+
+    struct state_t
+    {
+        std::mutex mutex;
+        std::vector<entry> entries;
+        std::size_t limit = no_limit;
+    };
+
+    static state_t& state()
+    {
+        // never destroyed, since containers with static storage may
+        // allocate after it otherwise
+        static auto state_ = new state_t{};
+        return *state_;
+    }
+};
+
+/*!
+ * Adds `FreeLists` to the `Registry` during static initialization,
+ * when the heap is instantiated, so that allocating does not need to
+ * check whether they have been added already.
+ */
+template <typename Registry, typename FreeLists, typename Heap>
+struct registered_heap : Heap
+{
+    template <typename... Tags>
+    static void* allocate(std::size_t size, Tags... tags)
+    {
+        // odr-using the member is what instantiates it
+        (void) &registered;
+        return Heap::allocate(size, tags...);
+    }
+
+private:
+    static const bool registered;
+};
+
+template <typename Registry, typename FreeLists, typename Heap>
+const bool registered_heap<Registry, FreeLists, Heap>::registered =
+    Registry::template add<FreeLists>();
+
+/*!
+ * The free lists of the @ref free_list_heap_policy for objects of
+ * `Size`: a thread local one on top of a global one.
+ */
+template <std::size_t Size, std::size_t Limit, typename Heap>
+struct shared_free_lists
+{
+    using global = free_list_heap<Size, Limit, debug_size_heap<Heap>>;
+    using local  = thread_local_free_list_heap<Size, Limit, global>;
+
+    static void reserve(std::size_t n) { global::reserve(n); }
+    static void trim() { local::trim(); global::trim(); }
+
+    static void set_limit(std::size_t n)
+    {
+        local::set_limit(n);
+        global::set_limit(n);
+    }
+};
+
+/*!
+ * The free list of the @ref unsafe_free_list_heap_policy for objects
+ * of `Size`.
+ */
+template <std::size_t Size, std::size_t Limit, typename Heap>
+struct unsafe_free_lists
+{
+    using local = unsafe_free_list_heap<Size, Limit, debug_size_heap<Heap>>;
+
+    static void reserve(std::size_t n) { local::reserve(n); }
+    static void trim() { local::trim(); }
+    static void set_limit(std::size_t n) { local::set_limit(n); }
+};
+
+} // namespace detail
+
 template <typename Deriv, typename HeapPolicy>
 struct enable_optimized_heap_policy
 {
@@ -78,7 +220,8 @@ struct enable_optimized_heap_policy
  *   kind of synchronization and is very fast.  When the thread
  *   finishes, its contents are returned to the next free list.
  *
- * - A global free list using lock-free access via atomics.
+ * - A global free list, sharded to avoid contention, that threads
+ *   access without ever blocking on each other.
  *
  * @tparam Heap Heap to be used when the free list is empty.
  *
@@ -97,6 +240,24 @@ struct enable_optimized_heap_policy
  *    return a node that was just accessed.  When batches of immutable
  *    updates are made, this can make a significant difference.
  *
+ * .. note:: The free lists can be managed at runtime with the static
+ *    methods of the policy, which apply to the free lists of every
+ *    size that the policy has used so far.  However, ``trim()``
+ *    only empties the thread local free lists of the calling thread:
+ *    those of other threads keep their nodes until they overflow
+ *    into the global ones or the thread finishes.  Creating an empty
+ *    container is enough to use the sizes of its nodes, so a service
+ *    can warm up the free lists at startup with:
+ *
+ *    .. code-block:: c++
+ *
+ *       using policy_t = immer::free_list_heap_policy<immer::cpp_heap>;
+ *       immer::vector<int, immer::memory_policy<policy_t, ...>>{};
+ *       policy_t::reserve(1000);
+ *
+ *    and give the memory back after a burst of allocations with
+ *    ``policy_t::trim()``.
+ *
  * @endrst
  */
 template <typename Heap,
@@ -105,10 +266,128 @@ struct free_list_heap_policy
 {
     using type = debug_size_heap<Heap>;
 
+    template <std::size_t Size>
+    struct optimized
+    {
+        using free_lists = detail::shared_free_lists<Size, Limit, Heap>;
+
+        using type = detail::registered_heap<
+            detail::free_list_registry<free_list_heap_policy>,
+            free_lists,
+            split_heap<
+                Size,
+                with_free_list_node<typename free_lists::local>,
+                debug_size_heap<Heap>>>;
+    };
+
+    /*!
+     * Fills the global free lists with `n` nodes each, or as many as
+     * their limit allows.
+     */
+    static void reserve(std::size_t n) { registry::reserve(n); }
+
+    /*!
+     * Releases the nodes in the free lists of the current thread and
+     * in the global ones to the underlying `Heap`.  The thread local
+     * free lists of other threads are left alone.
+     */
+    static void trim() { registry::trim(); }
+
+    /*!
+     * Changes the maximum number of nodes kept in every free list,
+     * that is `Limit` initially.
+     */
+    static void set_limit(std::size_t n) { registry::set_limit(n); }
+
+private:
+    using registry = detail::free_list_registry<free_list_heap_policy>;
+};
+
+/*!
+ * Similar to @ref free_list_heap_policy, but every node returns to
+ * the free list of the thread that allocated it, using a @ref
+ * remote_free_list_heap.  This is useful when some threads produce
+ * data structures that other threads release, in which case the
+ * producers can reuse the memory instead of hitting the underlying
+ * `Heap` over and over.
+ */
+template <typename Heap,
+          std::size_t Limit = default_free_list_size>
+struct remote_free_list_heap_policy
+{
+    using type = debug_size_heap<Heap>;
+
     template <std::size_t Size>
     struct optimized
     {
         using type = split_heap<
+            Size,
+            with_free_list_node<
+                remote_free_list_heap<
+                    Size, Limit,
+                    debug_size_heap<Heap>>>,
+            debug_size_heap<Heap>>;
+    };
+};
+
+/*!
+ * Heap policy that allocates every object from the current @ref arena
+ * of the thread using an @ref arena_heap, or from `Heap` when there
+ * is none.  Combine it with a @ref no_refcount_policy to release all
+ * the containers built inside an arena at once when it is destroyed.
+ * Destructors are then never called, so the contained values should
+ * be trivially destructible, or own no memory outside of the arena.
+ *
+ * @rst
+ *
+ * **Example**
+ *   .. code-block:: c++
+ *
+ *      using arena_memory = immer::memory_policy<
+ *          immer::arena_heap_policy<>,
+ *          immer::no_refcount_policy>;
+ *
+ *      void handle(const request& req)
+ *      {
+ *          immer::arena scope;
+ *          auto m = immer::map<int, int,
+ *                              std::hash<int>,
+ *                              std::equal_to<int>,
+ *                              arena_memory>{};
+ *          ...
+ *      } // everything is released here
+ *
+ * @endrst
+ */
+template <typename Heap = malloc_heap>
+struct arena_heap_policy
+{
+    using type = arena_heap<Heap>;
+
+    template <std::size_t>
+    struct optimized
+    {
+        using type = arena_heap<Heap>;
+    };
+};
+
+/*!
+ * Similar to @ref free_list_heap_policy, but every allocation goes
+ * through a @ref stats_heap, and the parent heaps of the free lists
+ * are wrapped in a @ref stats_fallback_heap, so the hits and misses of
+ * the free lists are counted too.  The counters can be read with @ref
+ * get_heap_stats.
+ */
+template <typename Heap,
+          std::size_t Limit = default_free_list_size>
+struct stats_heap_policy
+{
+    using type = stats_heap<stats_fallback_heap<debug_size_heap<Heap>>>;
+
+    template <std::size_t Size>
+    struct optimized
+    {
+        using type = stats_heap<split_heap<
             Size,
             with_free_list_node<
                 thread_local_free_list_heap<
@@ -116,8 +395,8 @@ struct free_list_heap_policy
                     Limit,
                     free_list_heap<
                         Size, Limit,
-                        debug_size_heap<Heap>>>>,
-            debug_size_heap<Heap>>;
+                        stats_fallback_heap<debug_size_heap<Heap>>>>>,
+            stats_fallback_heap<debug_size_heap<Heap>>>>;
     };
 };
 
@@ -135,14 +414,36 @@ struct unsafe_free_list_heap_policy
     template <std::size_t Size>
     struct optimized
     {
-        using type = split_heap<
-            Size,
-            with_free_list_node<
-                unsafe_free_list_heap<
-                    Size, Limit,
-                    debug_size_heap<Heap>>>,
-            debug_size_heap<Heap>>;
+        using free_lists = detail::unsafe_free_lists<Size, Limit, Heap>;
+
+        using type = detail::registered_heap<
+            detail::free_list_registry<unsafe_free_list_heap_policy>,
+            free_lists,
+            split_heap<
+                Size,
+                with_free_list_node<typename free_lists::local>,
+                debug_size_heap<Heap>>>;
     };
+
+    /*!
+     * Fills the free lists with `n` nodes each, or as many as their
+     * limit allows.
+     */
+    static void reserve(std::size_t n) { registry::reserve(n); }
+
+    /*!
+     * Releases the nodes in the free lists to the underlying `Heap`.
+     */
+    static void trim() { registry::trim(); }
+
+    /*!
+     * Changes the maximum number of nodes kept in every free list,
+     * that is `Limit` initially.
+     */
+    static void set_limit(std::size_t n) { registry::set_limit(n); }
+
+private:
+    using registry = detail::free_list_registry<unsafe_free_list_heap_policy>;
 };
 
 } // namespace immer
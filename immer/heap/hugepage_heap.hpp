@@ -0,0 +1,224 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#pragma once
+
+#include "config.hpp"
+#include "heap/malloc_heap.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#ifndef IMMER_HAS_MMAP
+#if defined(__unix__) || defined(__APPLE__)
+#define IMMER_HAS_MMAP 1
+#else
+#define IMMER_HAS_MMAP 0
+#endif
+#endif
+
+#if IMMER_HAS_MMAP
+#include <sys/mman.h>
+#endif
+
+namespace immer {
+
+namespace detail {
+
+/*!
+ * Returns a memory region of `size` bytes aligned to `align`, which
+ * must be a power of two, asking the kernel to back it with huge
+ * pages when possible.
+ */
+inline void* map_aligned(std::size_t size, std::size_t align)
+{
+#if IMMER_HAS_MMAP
+    auto total = size + align;
+    auto p = ::mmap(nullptr, total, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (IMMER_UNLIKELY(p == MAP_FAILED))
+        throw std::bad_alloc{};
+    auto first = reinterpret_cast<std::uintptr_t>(p);
+    auto start = (first + align - 1) & ~std::uintptr_t(align - 1);
+    auto head  = start - first;
+    auto tail  = total - head - size;
+    if (head) ::munmap(p, head);
+    if (tail) ::munmap(reinterpret_cast<void*>(start + size), tail);
+#ifdef MADV_HUGEPAGE
+    ::madvise(reinterpret_cast<void*>(start), size, MADV_HUGEPAGE);
+#endif
+    return reinterpret_cast<void*>(start);
+#else
+    auto p = std::malloc(size + align);
+    if (IMMER_UNLIKELY(!p))
+        throw std::bad_alloc{};
+    auto first = reinterpret_cast<std::uintptr_t>(p) + sizeof(void*);
+    auto start = (first + align - 1) & ~std::uintptr_t(align - 1);
+    reinterpret_cast<void**>(start)[-1] = p;
+    return reinterpret_cast<void*>(start);
+#endif
+}
+
+/*!
+ * Releases a region previously returned by `map_aligned`.
+ */
+inline void unmap_aligned(void* data, std::size_t size)
+{
+#if IMMER_HAS_MMAP
+    ::munmap(data, size);
+#else
+    std::free(static_cast<void**>(data)[-1]);
+#endif
+}
+
+} // namespace detail
+
+/*!
+ * A heap that carves objects out of big regions of `RegionSize`
+ * bytes, aligned to their size, and that are backed by transparent
+ * huge pages where the operating system supports it.  Putting nodes
+ * that are allocated together in the same huge pages reduces the TLB
+ * misses when traversing big containers.
+ *
+ * Each thread bumps a pointer in its own region.  A region is
+ * returned to the system once all the objects in it have been
+ * deallocated, which may happen from any thread.  Objects bigger than
+ * `max_size` are allocated from `Base`.
+ *
+ * @rst
+ *
+ * .. tip:: Since regions are only released once they are completely
+ *    empty, this heap is best used as the base of a
+ *    :cpp:class:`free_list_heap_policy`, such that freed nodes are
+ *    recycled instead, or as the small heap of a
+ *    :cpp:class:`split_heap`.
+ *
+ * @endrst
+ */
+template <std::size_t RegionSize = default_hugepage_region_size,
+          typename Base = malloc_heap>
+struct hugepage_heap
+{
+    static_assert((RegionSize & (RegionSize - 1)) == 0,
+                  "RegionSize must be a power of two");
+
+    struct region
+    {
+        std::atomic<std::size_t> live;
+    };
+
+    static constexpr std::size_t alignment   = alignof(std::max_align_t);
+    static constexpr std::size_t header_size =
+        (sizeof(region) + alignment - 1) & ~(alignment - 1);
+    static constexpr std::size_t max_size    = RegionSize / 16;
+
+    static_assert(header_size + max_size <= RegionSize,
+                  "RegionSize is too small");
+
+    template <typename... Tags>
+    static void* allocate(std::size_t size, Tags... tags)
+    {
+        if (size > max_size)
+            return Base::allocate(size, tags...);
+        size = (size + alignment - 1) & ~(alignment - 1);
+        auto& l = local();
+        if (IMMER_UNLIKELY(size > std::size_t(l.end - l.cur)))
+            l.refill();
+        auto p = l.cur;
+        l.cur += size;
+        ++l.count;
+        return p;
+    }
+
+    template <typename... Tags>
+    static void deallocate(std::size_t size, void* data, Tags... tags)
+    {
+        if (size > max_size)
+            return Base::deallocate(size, data, tags...);
+        auto r = reinterpret_cast<region*>(
+            reinterpret_cast<std::uintptr_t>(data)
+            & ~std::uintptr_t(RegionSize - 1));
+        release(r, 1);
+    }
+
+private:
+    // While a region is owned by a thread, its counter holds this
+    // bias minus the number of deallocated objects, such that the
+    // owner does not need to touch it on every allocation.  It is
+    // bigger than the number of objects that fit in a region.
+    static constexpr std::size_t bias = RegionSize;
+
+    struct local_t
+    {
+        region* current = nullptr;
+        char* cur = nullptr;
+        char* end = nullptr;
+        std::size_t count = 0;
+
+        void refill()
+        {
+            retire();
+            current = acquire();
+            cur     = reinterpret_cast<char*>(current) + header_size;
+            end     = reinterpret_cast<char*>(current) + RegionSize;
+        }
+
+        void retire()
+        {
+            if (current) {
+                release(current, bias - count);
+                current = nullptr;
+                cur = end = nullptr;
+                count = 0;
+            }
+        }
+
+        ~local_t() { retire(); }
+    };
+
+    static local_t& local()
+    {
+        thread_local static local_t l;
+        return l;
+    }
+
+    // One empty region is kept around to avoid mapping and unmapping
+    // memory repeatedly when the heap is churning.
+    static std::atomic<region*>& spare()
+    {
+        static std::atomic<region*> spare_ {nullptr};
+        return spare_;
+    }
+
+    static region* acquire()
+    {
+        auto r = spare().exchange(nullptr, std::memory_order_acquire);
+        if (!r)
+            r = new (detail::map_aligned(RegionSize, RegionSize)) region{};
+        r->live.store(bias, std::memory_order_relaxed);
+        return r;
+    }
+
+    static void release(region* r, std::size_t n)
+    {
+        auto live = r->live.fetch_sub(n, std::memory_order_acq_rel);
+        assert(live >= n);
+        if (live == n) {
+            auto expected = static_cast<region*>(nullptr);
+            if (!spare().compare_exchange_strong(
+                    expected, r, std::memory_order_release))
+                detail::unmap_aligned(r, RegionSize);
+        }
+    }
+};
+
+} // namespace immer
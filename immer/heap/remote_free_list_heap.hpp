@@ -0,0 +1,203 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#pragma once
+
+#include "heap/free_list_node.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <mutex>
+
+namespace immer {
+namespace detail {
+
+/*!
+ * Free list state of a thread.  It outlives the thread: when it
+ * finishes, the record is kept aside to be adopted by the next thread
+ * that starts using the heap, since other threads may still be
+ * holding nodes that point to it.
+ */
+struct remote_free_list_owner
+{
+    // only accessed by the owner thread
+    free_list_node* data;
+    std::size_t count;
+    // pushed to by any thread, taken as a whole by the owner
+    std::atomic<free_list_node*> remote;
+    std::atomic<std::size_t> remote_count;
+    remote_free_list_owner* next_abandoned;
+};
+
+} // namespace detail
+
+/*!
+ * Adaptor that keeps a free list per thread and makes every node
+ * return to the free list of the thread that allocated it.  Must be
+ * preceded by a `with_data<free_list_node, ...>` heap adaptor.
+ *
+ * Every node is prefixed by a pointer to its *owner*, the free list
+ * of the thread that allocated it.  When a node is deallocated by its
+ * owner, it goes straight into the owner's free list, without any
+ * synchronization.  Otherwise, it is pushed to a lock-free queue of
+ * *remote frees* of the owner, which the owner takes as a whole the
+ * next time its free list runs empty.  This way, when one thread
+ * produces data structures that are released by another, the memory
+ * flows back to the producer instead of piling up in the consumer.
+ *
+ * When a thread finishes, its free list is released to the parent
+ * heap, and its owner record is kept aside so nodes freed later by
+ * other threads can be reused by the next thread that starts.
+ *
+ * @tparam Size  Maximum size of the objects to be allocated.
+ * @tparam Limit Maximum number of elements to keep in the free list
+ *               of every thread, and in its queue of remote frees.
+ * @tparam Base  Type of the parent heap.
+ */
+template <std::size_t Size, std::size_t Limit, typename Base>
+struct remote_free_list_heap : Base
+{
+    using base_t  = Base;
+    using owner_t = detail::remote_free_list_owner;
+
+    template <typename... Tags>
+    static void* allocate(std::size_t size, Tags...)
+    {
+        assert(size <= sizeof(free_list_node) + Size);
+        assert(size >= sizeof(free_list_node));
+
+        auto& o = owner();
+        if (!o.data && !drain(o)) {
+            auto p = static_cast<owner_t**>(
+                base_t::allocate(sizeof(owner_t*) +
+                                 sizeof(free_list_node) + Size));
+            *p = &o;
+            return p + 1;
+        }
+        auto n = o.data;
+        --o.count;
+        o.data = n->next;
+        return n;
+    }
+
+    template <typename... Tags>
+    static void deallocate(std::size_t size, void* data, Tags...)
+    {
+        assert(size <= sizeof(free_list_node) + Size);
+        assert(size >= sizeof(free_list_node));
+
+        auto n = static_cast<free_list_node*>(data);
+        auto& o = *(static_cast<owner_t**>(data)[-1]);
+        if (&o == &owner()) {
+            if (o.count >= Limit)
+                release(n);
+            else {
+                n->next = o.data;
+                o.data  = n;
+                ++o.count;
+            }
+        } else {
+            // we use relaxed, because we are fine with temporarily
+            // having a few more/less buffers in the remote queue
+            if (o.remote_count.fetch_add(1u, std::memory_order_relaxed)
+                >= Limit) {
+                o.remote_count.fetch_sub(1u, std::memory_order_relaxed);
+                release(n);
+            } else {
+                n->next = o.remote.load(std::memory_order_relaxed);
+                while (!o.remote.compare_exchange_weak(
+                           n->next, n,
+                           std::memory_order_release,
+                           std::memory_order_relaxed));
+            }
+        }
+    }
+
+private:
+    static void release(free_list_node* n)
+    {
+        base_t::deallocate(sizeof(owner_t*) + sizeof(free_list_node) + Size,
+                           reinterpret_cast<owner_t**>(n) - 1);
+    }
+
+    static bool drain(owner_t& o)
+    {
+        // taking the whole queue at once is not subject to ABA
+        auto n = o.remote.exchange(nullptr, std::memory_order_acquire);
+        auto c = std::size_t{};
+        for (auto i = n; i; i = i->next)
+            ++c;
+        o.remote_count.fetch_sub(c, std::memory_order_relaxed);
+        o.data  = n;
+        o.count = c;
+        return n != nullptr;
+    }
+
+    struct handle_t
+    {
+        owner_t* owner;
+
+        handle_t()
+            : owner{adopt()}
+        {}
+
+        ~handle_t()
+        {
+            do {
+                while (owner->data) {
+                    auto n = owner->data->next;
+                    release(owner->data);
+                    owner->data = n;
+                }
+            } while (drain(*owner));
+            owner->count = 0;
+            abandon(owner);
+        }
+    };
+
+    struct abandoned_t
+    {
+        std::mutex mutex;
+        owner_t* data;
+    };
+
+    static abandoned_t& abandoned()
+    {
+        static abandoned_t abandoned_ {{}, nullptr};
+        return abandoned_;
+    }
+
+    static owner_t* adopt()
+    {
+        auto& a = abandoned();
+        {
+            std::lock_guard<std::mutex> lock{a.mutex};
+            if (auto o = a.data) {
+                a.data = o->next_abandoned;
+                return o;
+            }
+        }
+        return new owner_t{nullptr, 0, {nullptr}, {0}, nullptr};
+    }
+
+    static void abandon(owner_t* o)
+    {
+        auto& a = abandoned();
+        std::lock_guard<std::mutex> lock{a.mutex};
+        o->next_abandoned = a.data;
+        a.data = o;
+    }
+
+    static owner_t& owner()
+    {
+        thread_local static handle_t handle_;
+        return *handle_.owner;
+    }
+};
+
+} // namespace immer
@@ -0,0 +1,417 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#pragma once
+
+#include "config.hpp"
+#include "heap/tags.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace immer {
+
+/*!
+ * Counters of the memory traffic seen by the @ref stats_heap.
+ */
+struct heap_stats_counters
+{
+    //! Number of objects that were allocated.
+    std::size_t allocations = 0;
+    //! Number of objects that were deallocated.
+    std::size_t deallocations = 0;
+    //! Bytes requested by the allocations.
+    std::size_t allocated_bytes = 0;
+    //! Bytes released by the deallocations.
+    std::size_t deallocated_bytes = 0;
+    //! Allocations that were not served by a free list.
+    std::size_t misses = 0;
+    //! Deallocations that did not fit in a free list.
+    std::size_t releases = 0;
+
+    std::size_t live() const { return allocations - deallocations; }
+    std::size_t live_bytes() const
+    { return allocated_bytes - deallocated_bytes; }
+    std::size_t hits() const { return allocations - misses; }
+
+    double hit_rate() const
+    {
+        return allocations
+            ? double(hits()) / allocations
+            : 0;
+    }
+
+    heap_stats_counters& operator+=(const heap_stats_counters& x)
+    {
+        allocations       += x.allocations;
+        deallocations     += x.deallocations;
+        allocated_bytes   += x.allocated_bytes;
+        deallocated_bytes += x.deallocated_bytes;
+        misses            += x.misses;
+        releases          += x.releases;
+        return *this;
+    }
+};
+
+/*!
+ * Tags under which the @ref stats_heap breaks down the allocations.
+ * Relaxed nodes of vectors are allocated with the `norefs_tag`.
+ */
+enum class heap_stats_tag : std::size_t
+{
+    none,
+    norefs,
+};
+
+/*!
+ * A snapshot of the counters of all the @ref stats_heap in the
+ * program, as returned by @ref get_heap_stats.  Allocations are
+ * broken down by tag and by *size class*, where the size class `i`
+ * holds the objects of `(2^(i-1), 2^i]` bytes, and the last one also
+ * holds all the objects that are bigger.
+ */
+struct heap_stats
+{
+    static constexpr std::size_t tags = 2;
+    static constexpr std::size_t size_classes = 24;
+
+    heap_stats_counters counters[tags][size_classes];
+
+    static std::size_t size_class(std::size_t size)
+    {
+        auto c = std::size_t{};
+        while (c + 1 < size_classes && (std::size_t{1} << c) < size)
+            ++c;
+        return c;
+    }
+
+    static std::size_t size_class_limit(std::size_t c)
+    {
+        return std::size_t{1} << c;
+    }
+
+    const heap_stats_counters& get(heap_stats_tag tag, std::size_t c) const
+    {
+        return counters[static_cast<std::size_t>(tag)][c];
+    }
+
+    heap_stats_counters by_tag(heap_stats_tag tag) const
+    {
+        auto r = heap_stats_counters{};
+        for (auto c = std::size_t{}; c < size_classes; ++c)
+            r += get(tag, c);
+        return r;
+    }
+
+    heap_stats_counters by_size_class(std::size_t c) const
+    {
+        auto r = heap_stats_counters{};
+        for (auto t = std::size_t{}; t < tags; ++t)
+            r += counters[t][c];
+        return r;
+    }
+
+    heap_stats_counters total() const
+    {
+        auto r = heap_stats_counters{};
+        for (auto t = std::size_t{}; t < tags; ++t)
+            for (auto c = std::size_t{}; c < size_classes; ++c)
+                r += counters[t][c];
+        return r;
+    }
+};
+
+namespace detail {
+
+template <typename... Tags>
+struct heap_stats_tag_of
+{
+    static constexpr auto value = heap_stats_tag::none;
+};
+
+template <>
+struct heap_stats_tag_of<norefs_tag>
+{
+    static constexpr auto value = heap_stats_tag::norefs;
+};
+
+/*!
+ * Counters of a thread.  They are only written by the thread that
+ * owns them, so they are updated with plain loads and stores, and
+ * they are atomic only so that snapshots can read them at any time.
+ */
+struct heap_stats_block
+{
+    enum field
+    {
+        allocations,
+        deallocations,
+        allocated_bytes,
+        deallocated_bytes,
+        misses,
+        releases,
+        fields
+    };
+
+    using counter_t = std::atomic<std::size_t>;
+
+    counter_t counters[heap_stats::tags][heap_stats::size_classes][fields];
+
+    heap_stats_block()
+    {
+        for (auto& t : counters)
+            for (auto& c : t)
+                for (auto& f : c)
+                    f.store(0, std::memory_order_relaxed);
+    }
+
+    void add_to(heap_stats_block& b) const
+    {
+        for (auto t = std::size_t{}; t < heap_stats::tags; ++t)
+            for (auto c = std::size_t{}; c < heap_stats::size_classes; ++c)
+                for (auto f = std::size_t{}; f < fields; ++f)
+                    b.counters[t][c][f].fetch_add(
+                        counters[t][c][f].load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+    }
+
+    void add_to(heap_stats& s) const
+    {
+        for (auto t = std::size_t{}; t < heap_stats::tags; ++t) {
+            for (auto c = std::size_t{}; c < heap_stats::size_classes; ++c) {
+                auto& f = counters[t][c];
+                auto x  = heap_stats_counters{};
+                x.allocations       = f[allocations].load(std::memory_order_relaxed);
+                x.deallocations     = f[deallocations].load(std::memory_order_relaxed);
+                x.allocated_bytes   = f[allocated_bytes].load(std::memory_order_relaxed);
+                x.deallocated_bytes = f[deallocated_bytes].load(std::memory_order_relaxed);
+                x.misses            = f[misses].load(std::memory_order_relaxed);
+                x.releases          = f[releases].load(std::memory_order_relaxed);
+                s.counters[t][c] += x;
+            }
+        }
+    }
+};
+
+/*!
+ * Keeps the counters of every thread that has used a @ref stats_heap.
+ * The counters of the threads that are gone are added to a shared
+ * block, that is also used by the threads that allocate while they
+ * are being destroyed.
+ */
+class heap_stats_registry
+{
+public:
+    static heap_stats_registry& instance()
+    {
+        // never destroyed, since containers with static storage may
+        // be released after it otherwise
+        static auto instance_ = new heap_stats_registry{};
+        return *instance_;
+    }
+
+    static void record(heap_stats_tag tag, std::size_t size,
+                       heap_stats_block::field count,
+                       heap_stats_block::field bytes,
+                       heap_stats_block::field fallback,
+                       bool fell_back)
+    {
+        auto b = local().get();
+        auto& f = b->counters[static_cast<std::size_t>(tag)]
+                             [heap_stats::size_class(size)];
+        if (IMMER_LIKELY(b != &instance().retired_)) {
+            bump(f[count], 1);
+            bump(f[bytes], size);
+            if (fell_back)
+                bump(f[fallback], 1);
+        } else {
+            f[count].fetch_add(1, std::memory_order_relaxed);
+            f[bytes].fetch_add(size, std::memory_order_relaxed);
+            if (fell_back)
+                f[fallback].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    heap_stats snapshot()
+    {
+        auto s = heap_stats{};
+        std::lock_guard<std::mutex> lock{mutex_};
+        retired_.add_to(s);
+        for (auto b : blocks_)
+            b->add_to(s);
+        return s;
+    }
+
+private:
+    struct local_t
+    {
+        heap_stats_registry& registry = instance();
+        heap_stats_block* block = nullptr;
+
+        heap_stats_block* get()
+        {
+            if (IMMER_UNLIKELY(!block))
+                block = registry.add_block();
+            return block;
+        }
+
+        ~local_t()
+        {
+            if (block)
+                registry.remove_block(block);
+            block = &registry.retired_;
+        }
+    };
+
+    static local_t& local()
+    {
+        thread_local static local_t l;
+        return l;
+    }
+
+    static void bump(heap_stats_block::counter_t& c, std::size_t n)
+    {
+        c.store(c.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+    }
+
+    heap_stats_block* add_block()
+    {
+        auto b = new heap_stats_block{};
+        std::lock_guard<std::mutex> lock{mutex_};
+        blocks_.push_back(b);
+        return b;
+    }
+
+    void remove_block(heap_stats_block* b)
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            b->add_to(retired_);
+            blocks_.erase(std::find(blocks_.begin(), blocks_.end(), b));
+        }
+        delete b;
+    }
+
+    heap_stats_registry() = default;
+
+    std::mutex mutex_;
+    std::vector<heap_stats_block*> blocks_;
+    heap_stats_block retired_;
+};
+
+/*!
+ * Whether the innermost @ref stats_heap call of the current thread
+ * has reached a @ref stats_fallback_heap.
+ */
+inline bool& heap_stats_fell_back()
+{
+    thread_local static bool fell_back = false;
+    return fell_back;
+}
+
+} // namespace detail
+
+/*!
+ * Adaptor that counts the objects allocated and deallocated through
+ * it, and their size, broken down by size class and tag.  When the
+ * parent heap keeps a free list, its own parent heap can be wrapped
+ * in a @ref stats_fallback_heap to also count the allocations that
+ * missed the free list and the deallocations that did not fit in it.
+ *
+ * Deallocations are counted under the tag they are passed with.
+ * Since the containers allocate with tags but deallocate without
+ * them, the number of live objects is only meaningful per size class
+ * or in total.
+ *
+ * Counters are kept per thread and updated without synchronization,
+ * so the overhead is a few plain memory operations per call.  The
+ * counters of all the threads are collected with @ref get_heap_stats.
+ *
+ * @tparam Base Type of the parent heap.
+ */
+template <typename Base>
+struct stats_heap : Base
+{
+    using base_t = Base;
+
+    template <typename... Tags>
+    static void* allocate(std::size_t size, Tags... tags)
+    {
+        using field = detail::heap_stats_block::field;
+        auto& fell_back = detail::heap_stats_fell_back();
+        auto outer = fell_back;
+        fell_back  = false;
+        auto p     = base_t::allocate(size, tags...);
+        detail::heap_stats_registry::record(
+            detail::heap_stats_tag_of<Tags...>::value, size,
+            field::allocations, field::allocated_bytes, field::misses,
+            fell_back);
+        fell_back = outer;
+        return p;
+    }
+
+    template <typename... Tags>
+    static void deallocate(std::size_t size, void* data, Tags... tags)
+    {
+        using field = detail::heap_stats_block::field;
+        auto& fell_back = detail::heap_stats_fell_back();
+        auto outer = fell_back;
+        fell_back  = false;
+        base_t::deallocate(size, data, tags...);
+        detail::heap_stats_registry::record(
+            detail::heap_stats_tag_of<Tags...>::value, size,
+            field::deallocations, field::deallocated_bytes, field::releases,
+            fell_back);
+        fell_back = outer;
+    }
+};
+
+/*!
+ * Adaptor that tells the enclosing @ref stats_heap that an allocation
+ * or deallocation has reached this heap.  It should wrap the parent
+ * heap of a free list, so the @ref stats_heap on top of the free list
+ * can count its misses.
+ *
+ * @tparam Base Type of the parent heap.
+ */
+template <typename Base>
+struct stats_fallback_heap : Base
+{
+    using base_t = Base;
+
+    template <typename... Tags>
+    static void* allocate(std::size_t size, Tags... tags)
+    {
+        detail::heap_stats_fell_back() = true;
+        return base_t::allocate(size, tags...);
+    }
+
+    template <typename... Tags>
+    static void deallocate(std::size_t size, void* data, Tags... tags)
+    {
+        detail::heap_stats_fell_back() = true;
+        base_t::deallocate(size, data, tags...);
+    }
+};
+
+/*!
+ * Returns the counters of all the @ref stats_heap of the program,
+ * added up over all the threads, including those that are gone.  It
+ * does not stop other threads from allocating, so the result may not
+ * be perfectly consistent while they do.
+ */
+inline heap_stats get_heap_stats()
+{
+    return detail::heap_stats_registry::instance().snapshot();
+}
+
+} // namespace immer
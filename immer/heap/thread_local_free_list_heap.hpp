@@ -20,13 +20,15 @@ struct thread_local_free_list_storage
     {
         free_list_node* data;
         std::size_t count;
+        free_list_node* full;
+        std::size_t full_count;
 
         ~head_t() { Heap::clear(); }
     };
 
     static head_t& head()
     {
-        thread_local static head_t head_{nullptr, 0};
+        thread_local static head_t head_{nullptr, 0, nullptr, 0};
         return head_;
     }
 };
@@ -40,8 +42,19 @@ struct thread_local_free_list_storage
  * adaptor.  When the current thread finishes, the memory is returned
  * to the parent heap.
  *
+ * When the parent heap is a @ref free_list_heap, nodes are moved
+ * between both in batches of half the limit: a thread that frees a
+ * lot hands over whole magazines to the global free list, and a
+ * thread that allocates a lot grabs them back, both with a single
+ * synchronized operation.
+ *
+ * The limit, that can be changed with `set_limit()`, is shared by all
+ * threads, but `reserve()` and `trim()` only affect the free list of
+ * the current thread.
+ *
  * @tparam Size  Maximum size of the objects to be allocated.
- * @tparam Limit Maximum number of elements to keep in the free list.
+ * @tparam Limit Initial maximum number of elements to keep in the
+ *               free list.
  * @tparam Base  Type of the parent heap.
  */
 template <std::size_t Size, std::size_t Limit, typename Base>
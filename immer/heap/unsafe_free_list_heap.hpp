@@ -10,11 +10,24 @@
 
 #include "config.hpp"
 #include "heap/free_list_node.hpp"
+#include "detail/type_traits.hpp"
+
+#include <atomic>
 #include <cassert>
 
 namespace immer {
 namespace detail {
 
+template <typename Heap, typename = void>
+struct has_free_list_batches : std::false_type {};
+
+template <typename Heap>
+struct has_free_list_batches<Heap, void_t<
+    decltype(Heap::deallocate_batch(std::declval<free_list_node*>(),
+                                    std::size_t{})),
+    decltype(Heap::allocate_batch(std::declval<std::size_t&>()))>>
+    : std::true_type {};
+
 template <typename Heap>
 struct unsafe_free_list_storage
 {
@@ -22,15 +35,24 @@ struct unsafe_free_list_storage
     {
         free_list_node* data;
         std::size_t count;
+        free_list_node* full;
+        std::size_t full_count;
     };
 
     static head_t& head()
     {
-        static head_t head_ {nullptr, 0};
+        static head_t head_ {nullptr, 0, nullptr, 0};
         return head_;
     }
 };
 
+/*!
+ * The free list is kept in two *magazines*: the nodes are taken from
+ * and returned to the `data` one, and when it overflows it is kept
+ * aside as the `full` one.  When the parent heap supports batches,
+ * like @ref free_list_heap does, full magazines are exchanged with it
+ * as a whole instead of moving nodes one by one.
+ */
 template <template<class>class Storage,
           std::size_t Size,
           std::size_t Limit,
@@ -38,6 +60,7 @@ template <template<class>class Storage,
 class unsafe_free_list_heap_impl : Base
 {
     using storage = Storage<unsafe_free_list_heap_impl>;
+    using batched = has_free_list_batches<Base>;
 
 public:
     using base_t = Base;
@@ -48,13 +71,14 @@ public:
         assert(size <= sizeof(free_list_node) + Size);
         assert(size >= sizeof(free_list_node));
 
-        auto n = storage::head().data;
-        if (!n) {
+        auto& h = storage::head();
+        if (!h.data && !refill(batched{})) {
             auto p = base_t::allocate(Size + sizeof(free_list_node));
             return static_cast<free_list_node*>(p);
         }
-        --storage::head().count;
-        storage::head().data = n->next;
+        auto n = h.data;
+        --h.count;
+        h.data = n->next;
         return n;
     }
 
@@ -64,25 +88,145 @@ public:
         assert(size <= sizeof(free_list_node) + Size);
         assert(size >= sizeof(free_list_node));
 
-        if (storage::head().count >= Limit)
+        auto& h = storage::head();
+        auto b  = batch_size();
+        if (!b || (h.count >= b && !spill(batched{})))
             base_t::deallocate(Size + sizeof(free_list_node), data);
         else {
             auto n = static_cast<free_list_node*>(data);
-            n->next = storage::head().data;
-            storage::head().data = n;
-            ++storage::head().count;
+            n->next = h.data;
+            h.data = n;
+            ++h.count;
+        }
+    }
+
+    /*!
+     * Allocates nodes from the parent heap and puts them in the free
+     * list until it holds `n` nodes, or as many as its limit allows.
+     * When the parent heap supports batches, the nodes that do not
+     * fit are handed over to it.
+     */
+    static void reserve(std::size_t n)
+    {
+        auto& h = storage::head();
+        auto b  = batch_size();
+        for (auto c = h.count + h.full_count; c < n; ++c) {
+            if (!b || (h.count >= b && !spill(batched{})))
+                break;
+            auto p = base_t::allocate(Size + sizeof(free_list_node));
+            auto node = static_cast<free_list_node*>(p);
+            node->next = h.data;
+            h.data = node;
+            ++h.count;
         }
     }
 
+    /*!
+     * Releases all the nodes in the free list to the parent heap.
+     */
+    static void trim()
+    {
+        clear();
+    }
+
+    /*!
+     * Returns the maximum number of elements kept in the free list.
+     */
+    static std::size_t limit()
+    {
+        return limit_().load(std::memory_order_relaxed);
+    }
+
+    /*!
+     * Changes the maximum number of elements kept in the free list.
+     * When it is lowered, the nodes that are already in the free list
+     * stay there until they are allocated or `trim()` is called.
+     */
+    static void set_limit(std::size_t n)
+    {
+        limit_().store(n, std::memory_order_relaxed);
+    }
+
     static void clear()
     {
-        while (storage::head().data) {
-            auto n = storage::head().data->next;
-            base_t::deallocate(Size + sizeof(free_list_node), storage::head().data);
-            storage::head().data = n;
-            --storage::head().count;
+        auto& h = storage::head();
+        release(h.data, h.count, batched{});
+        release(h.full, h.full_count, batched{});
+        h.data  = h.full = nullptr;
+        h.count = h.full_count = 0;
+    }
+
+private:
+    // shared by all the threads, when the storage is thread local
+    static std::atomic<std::size_t>& limit_()
+    {
+        static std::atomic<std::size_t> limit_{Limit};
+        return limit_;
+    }
+
+    // the free list holds two magazines of this size
+    static std::size_t batch_size()
+    {
+        auto l = limit();
+        return l > 1 ? l / 2 : l;
+    }
+
+    static bool refill(std::false_type)
+    {
+        auto& h = storage::head();
+        if (!h.full)
+            return false;
+        h.data       = h.full;
+        h.count      = h.full_count;
+        h.full       = nullptr;
+        h.full_count = 0;
+        return true;
+    }
+
+    static bool refill(std::true_type)
+    {
+        if (refill(std::false_type{}))
+            return true;
+        auto& h = storage::head();
+        h.data = base_t::allocate_batch(h.count);
+        return h.data != nullptr;
+    }
+
+    static bool spill(std::false_type)
+    {
+        auto& h = storage::head();
+        if (h.full)
+            return false;
+        h.full       = h.data;
+        h.full_count = h.count;
+        h.data       = nullptr;
+        h.count      = 0;
+        return true;
+    }
+
+    static bool spill(std::true_type)
+    {
+        auto& h = storage::head();
+        if (h.full)
+            base_t::deallocate_batch(h.full, h.full_count);
+        h.full = nullptr;
+        return spill(std::false_type{});
+    }
+
+    static void release(free_list_node* n, std::size_t count, std::false_type)
+    {
+        while (n) {
+            auto next = n->next;
+            base_t::deallocate(Size + sizeof(free_list_node), n);
+            n = next;
         }
     }
+
+    static void release(free_list_node* n, std::size_t count, std::true_type)
+    {
+        if (n)
+            base_t::deallocate_batch(n, count);
+    }
 };
 
 } // namespace detail
@@ -94,7 +238,8 @@ public:
  * ...>` heap adaptor.
  *
  * @tparam Size  Maximum size of the objects to be allocated.
- * @tparam Limit Maximum number of elements to keep in the free list.
+ * @tparam Limit Initial maximum number of elements to keep in the
+ *               free list.
  * @tparam Base  Type of the parent heap.
  */
 template <std::size_t Size, std::size_t Limit, typename Base>
@@ -13,6 +13,8 @@
 #include "detail/hamts/champ_iterator.hpp"
 
 #include <functional>
+#include <initializer_list>
+#include <iterator>
 
 namespace immer {
 
@@ -30,9 +32,13 @@ class map_transient;
  * @tparam K    The type of the keys.
  * @tparam T    The type of the values to be stored in the container.
  * @tparam Hash The type of a function object capable of hashing
- *              values of type `T`.
+ *              values of type `T`.  Wrap it in `immer::cached_hash`
+ *              to store the hashes in the container.
  * @tparam Equal The type of a function object capable of comparing
- *              values of type `T`.
+ *              values of type `T`.  When both `Hash` and `Equal`
+ *              declare an `is_transparent` type, lookups and `erase`
+ *              also take keys of other types, which are passed to
+ *              them without being converted.
  * @tparam MemoryPolicy Memory management policy. See @ref
  *              memory_policy.
  *
@@ -109,11 +115,18 @@ class map
 
     struct hash_key
     {
+        static constexpr bool cache_hash =
+            detail::hamts::get_cache_hash<Hash>::value;
+
         auto operator() (const value_t& v)
         { return Hash{}(v.first); }
 
         auto operator() (const K& v)
         { return Hash{}(v); }
+
+        template <typename Key>
+        auto operator() (const Key& v)
+        { return Hash{}(v); }
     };
 
     struct equal_key
@@ -123,6 +136,10 @@ class map
 
         auto operator() (const value_t& a, const K& b)
         { return Equal{}(a.first, b); }
+
+        template <typename Key>
+        auto operator() (const value_t& a, const Key& b)
+        { return Equal{}(a.first, b); }
     };
 
     struct equal_value
@@ -131,10 +148,76 @@ class map
         { return Equal{}(a.first, b.first) && a.second == b.second; }
     };
 
+    // Combines the associations of a key in two maps when merging
+    // them.  The one of the second map is kept, unless both have the
+    // same value, so the nodes of the first map can be reused.
+    struct merge_value
+    {
+        template <typename U = T>
+        auto operator() (const value_t& a, const value_t& b)
+            -> std::enable_if_t<detail::is_equality_comparable_v<U>,
+                                const value_t&>
+        { return a.second == b.second ? a : b; }
+
+        template <typename U = T>
+        auto operator() (const value_t&, const value_t& b)
+            -> std::enable_if_t<!detail::is_equality_comparable_v<U>,
+                                const value_t&>
+        { return b; }
+    };
+
+    // Like `merge_value`, but the values that differ are combined
+    // with `fn`.  The trie copies a combined value before combining
+    // the next one, so one slot is enough to return them by reference.
+    template <typename Fn>
+    struct merge_with_value
+    {
+        Fn& fn;
+        detail::aligned_storage_for<value_t> slot;
+        bool full = false;
+
+        merge_with_value(Fn& f) : fn{f} {}
+        merge_with_value(const merge_with_value&) = delete;
+        ~merge_with_value() { reset(); }
+
+        template <typename U = T>
+        auto operator() (const value_t& a, const value_t& b)
+            -> std::enable_if_t<detail::is_equality_comparable_v<U>,
+                                const value_t&>
+        { return a.second == b.second ? a : combine(a, b); }
+
+        template <typename U = T>
+        auto operator() (const value_t& a, const value_t& b)
+            -> std::enable_if_t<!detail::is_equality_comparable_v<U>,
+                                const value_t&>
+        { return combine(a, b); }
+
+        const value_t& combine(const value_t& a, const value_t& b)
+        {
+            reset();
+            auto p = new (&slot) value_t{a.first, fn(a.second, b.second)};
+            full = true;
+            return *p;
+        }
+
+        void reset()
+        {
+            if (full) {
+                full = false;
+                reinterpret_cast<value_t*>(&slot)->~value_t();
+            }
+        }
+    };
+
     using impl_t = detail::hamts::champ<
         value_t, hash_key, equal_key, MemoryPolicy, B>;
 
+    using move_t =
+        std::integral_constant<bool, MemoryPolicy::use_transient_rvalues>;
+
 public:
+    using memory_policy = MemoryPolicy;
+
     using key_type = K;
     using mapped_type = T;
     using value_type = std::pair<K, T>;
@@ -157,6 +240,28 @@ public:
      */
     map() = default;
 
+    /*!
+     * Constructs a map containing the associations in `values`.  When some
+     * of them have equal keys, the last one is kept.
+     */
+    map(std::initializer_list<value_type> values)
+        : impl_{impl_t::from_range(values.begin(), values.end())}
+    {}
+
+    /*!
+     * Constructs a map containing the associations in the range defined by
+     * the input iterator `first` and range sentinel `last`.  When some
+     * of them have equal keys, the last one is kept.  The nodes are
+     * built bottom-up, allocating each of them only once, which is
+     * much faster than inserting the associations one by one.
+     */
+    template <typename Iter, typename Sent,
+              std::enable_if_t
+              <detail::compatible_sentinel_v<Iter, Sent>, bool> = true>
+    map(Iter first, Sent last)
+        : impl_{impl_t::from_range(first, last)}
+    {}
+
     /*!
      * Returns an iterator pointing at the first element of the
      * collection. It does not allocate memory and its complexity is
@@ -185,6 +290,12 @@ public:
     { return impl_.template get<detail::constantly<size_type, 1>,
                                 detail::constantly<size_type, 0>>(k); }
 
+    template <typename Key,
+              typename = detail::transparent_key_t<Hash, Equal, Key>>
+    size_type count(const Key& k) const
+    { return impl_.template get<detail::constantly<size_type, 1>,
+                                detail::constantly<size_type, 0>>(k); }
+
     /*!
      * Returns a `const` reference to the values associated to the key
      * `k`.  If the key is not contained in the map, it returns a
@@ -194,6 +305,11 @@ public:
     const T& operator[] (const K& k) const
     { return impl_.template get<project_value, default_value>(k); }
 
+    template <typename Key,
+              typename = detail::transparent_key_t<Hash, Equal, Key>>
+    const T& operator[] (const Key& k) const
+    { return impl_.template get<project_value, default_value>(k); }
+
     /*!
      * Returns a `const` reference to the values associated to the key
      * `k`.  If the key is not contained in the map, throws an
@@ -203,6 +319,11 @@ public:
     const T& at(const K& k) const
     { return impl_.template get<project_value, error_value>(k); }
 
+    template <typename Key,
+              typename = detail::transparent_key_t<Hash, Equal, Key>>
+    const T& at(const Key& k) const
+    { return impl_.template get<project_value, error_value>(k); }
+
 
     /*!
      * Returns a pointer to the value associated with the key `k`.  If
@@ -237,6 +358,22 @@ public:
     { return impl_.template get<project_value_ptr,
                                 detail::constantly<const T*, nullptr>>(k); }
 
+    template <typename Key,
+              typename = detail::transparent_key_t<Hash, Equal, Key>>
+    const T* find(const Key& k) const
+    { return impl_.template get<project_value_ptr,
+                                detail::constantly<const T*, nullptr>>(k); }
+
+    /*!
+     * Like `find(k)`, but takes `hash`, which must be `Hash{}(k)`, so
+     * the key is not hashed again.  This is useful when looking up the
+     * same key in several maps, or when it is expensive to hash.
+     */
+    const T* find_hashed(const K& k, std::size_t hash) const
+    { return impl_.template get<project_value_ptr,
+                                detail::constantly<const T*, nullptr>>(
+                                    k, hash); }
+
     /*!
      * Returns whether the sets are equal.
      */
@@ -251,18 +388,77 @@ public:
      * It may allocate memory and its complexity is *effectively* @f$
      * O(1) @f$.
      */
-    map insert(value_type value) const
+    map insert(value_type value) const&
     { return impl_.add(std::move(value)); }
 
+    decltype(auto) insert(value_type value) &&
+    { return insert_move(move_t{}, std::move(value)); }
+
+    /*!
+     * Like `insert(value)`, but takes `hash`, which must be
+     * `Hash{}(value.first)`, so the key is not hashed again.
+     */
+    map insert_hashed(value_type value, std::size_t hash) const&
+    { return impl_.add(std::move(value), hash); }
+
+    decltype(auto) insert_hashed(value_type value, std::size_t hash) &&
+    { return insert_move(move_t{}, std::move(value), hash); }
+
+    /*!
+     * Returns a map containing the associations in the range defined by the
+     * input iterator `first` and range sentinel `last`, like if they
+     * were inserted one by one.  The range is built into a trie on its
+     * own, and then merged with this map.
+     */
+    template <typename Iter, typename Sent,
+              std::enable_if_t
+              <detail::compatible_sentinel_v<Iter, Sent>, bool> = true>
+    map insert(Iter first, Sent last) const
+    {
+        return impl_.merge(impl_t::from_range(first, last),
+                           merge_value{});
+    }
+
     /*!
      * Returns a map containing the association `(k, v)`.  If the key
      * is already in the map, it replaces its association in the map.
      * It may allocate memory and its complexity is *effectively* @f$
      * O(1) @f$.
      */
-    map set(key_type k, mapped_type v) const
+    map set(key_type k, mapped_type v) const&
     { return impl_.add({std::move(k), std::move(v)}); }
 
+    decltype(auto) set(key_type k, mapped_type v) &&
+    { return set_move(move_t{}, std::move(k), std::move(v)); }
+
+    /*!
+     * Returns a map containing the associations in the range `values`,
+     * replacing the ones with the same keys, as if they were set one
+     * by one.  Every node in their paths is copied only once per batch,
+     * and then updated in place, so it is much faster than calling
+     * `set` for every association when the batch is big.
+     */
+    template <typename Range>
+    map set_many(const Range& values) const&
+    { return impl_.add_many(std::begin(values), std::end(values)); }
+
+    template <typename Range>
+    decltype(auto) set_many(const Range& values) &&
+    { return set_many_move(move_t{}, values); }
+
+    /*!
+     * Returns a map without the keys in the range `keys`, as if they
+     * were erased one by one.  Like @ref set_many, every node in their
+     * paths is copied only once per batch.
+     */
+    template <typename Range>
+    map erase_many(const Range& keys) const&
+    { return impl_.sub_many(std::begin(keys), std::end(keys)); }
+
+    template <typename Range>
+    decltype(auto) erase_many(const Range& keys) &&
+    { return erase_many_move(move_t{}, keys); }
+
     /*!
      * Returns a map replacing the association `(k, v)` by the
      * association new association `(k, fn(v))`, where `v` is the
@@ -271,21 +467,123 @@ public:
      * and its complexity is *effectively* @f$ O(1) @f$.
      */
     template <typename Fn>
-    map update(key_type k, Fn&& fn) const
+    map update(key_type k, Fn&& fn) const&
     {
         return impl_
             .template update<project_value, default_value, combine_value>(
                 std::move(k), std::forward<Fn>(fn));
     }
 
+    template <typename Fn>
+    decltype(auto) update(key_type k, Fn&& fn) &&
+    { return update_move(move_t{}, std::move(k), std::forward<Fn>(fn)); }
+
+    /*!
+     * Like `update(k, fn)`, but when `k` is in the map and `fn`
+     * returns a value that is equal to its current value, as compared
+     * by `eq`, it returns the same map without allocating memory.
+     */
+    template <typename Fn, typename Eq = std::equal_to<T>>
+    map update_if_changed(key_type k, Fn&& fn, Eq&& eq = Eq{}) const&
+    {
+        auto hash = Hash{}(k);
+        auto old  = impl_.template get<project_value_ptr,
+                                       detail::constantly<const T*, nullptr>>(
+                                           k, hash);
+        if (!old)
+            return impl_.add({ std::move(k),
+                               std::forward<Fn>(fn)(default_value{}()) },
+                             hash);
+        auto v = std::forward<Fn>(fn)(*old);
+        if (eq(*old, v))
+            return *this;
+        return impl_.add({ std::move(k), std::move(v) }, hash);
+    }
+
+    template <typename Fn, typename Eq = std::equal_to<T>>
+    decltype(auto) update_if_changed(key_type k, Fn&& fn, Eq&& eq = Eq{}) &&
+    {
+        return update_if_changed_move(move_t{}, std::move(k),
+                                      std::forward<Fn>(fn),
+                                      std::forward<Eq>(eq));
+    }
+
     /*!
      * Returns a map without the key `k`.  If the key is not
      * associated in the map it returns the same map.  It may allocate
      * memory and its complexity is *effectively* @f$ O(1) @f$.
      */
-    map erase(const K& k) const
+    map erase(const K& k) const&
+    { return impl_.sub(k); }
+
+    decltype(auto) erase(const K& k) &&
+    { return erase_move(move_t{}, k); }
+
+    template <typename Key,
+              typename = detail::transparent_key_t<Hash, Equal, Key>>
+    map erase(const Key& k) const&
     { return impl_.sub(k); }
 
+    template <typename Key,
+              typename = detail::transparent_key_t<Hash, Equal, Key>>
+    decltype(auto) erase(const Key& k) &&
+    { return erase_move(move_t{}, k); }
+
+    /*!
+     * Like `erase(k)`, but takes `hash`, which must be `Hash{}(k)`, so
+     * the key is not hashed again.
+     */
+    map erase_hashed(const K& k, std::size_t hash) const&
+    { return impl_.sub(k, hash); }
+
+    decltype(auto) erase_hashed(const K& k, std::size_t hash) &&
+    { return erase_move(move_t{}, k, hash); }
+
+    /*!
+     * Returns a map with the associations of this map and `other`.
+     * When a key is in both, the association in `other` is kept.  The
+     * subtrees that are shared by both maps are reused, and so are the
+     * nodes of this map whose keys have the same values in `other`,
+     * when the values can be compared with `==`.  Thus, when `other`
+     * is a version of this same map, its complexity is @f$ O(d \cdot
+     * log(size)) @f$, where @f$ d @f$ is the number of associations
+     * where they differ.
+     */
+    map merge(const map& other) const
+    { return impl_.merge(other.impl_, merge_value{}); }
+
+    /*!
+     * Like @ref merge, but when a key `k` is associated to different
+     * values `a` and `b` in this map and in `other`, it is associated
+     * to `fn(a, b)` instead.  When the values can be compared with
+     * `==`, `fn` is not called for the keys associated to the same
+     * value, which is what allows reusing the nodes of this map.  Nor
+     * is it called for the subtrees shared by both maps.  Thus, `fn(v,
+     * v)` must be equal to `v`.
+     */
+    template <typename Fn>
+    map merge_with(const map& other, Fn&& fn) const
+    {
+        merge_with_value<std::remove_reference_t<Fn>> combine{fn};
+        return impl_.merge(other.impl_, combine);
+    }
+
+    /*!
+     * Returns a map with the associations of this map whose key is
+     * also in `other`.  Like @ref merge, it reuses the subtrees that
+     * are shared by both maps.
+     */
+    map intersect(const map& other) const
+    { return impl_.intersect(other.impl_); }
+
+    /*!
+     * Returns a map with the associations of this map whose key is
+     * not in `other`.  Like @ref merge, it reuses the subtrees that
+     * are shared by both maps.
+     */
+    map difference(const map& other) const
+    { return impl_.difference(other.impl_); }
+
     /*!
      * Returns an @a transient form of this container, a
      * `immer::map_transient`.
@@ -305,6 +603,93 @@ private:
         : impl_(std::move(impl))
     {}
 
+    map&& insert_move(std::true_type, value_type value)
+    { impl_.add_mut({}, std::move(value)); return std::move(*this); }
+    map insert_move(std::false_type, value_type value)
+    { return impl_.add(std::move(value)); }
+
+    map&& insert_move(std::true_type, value_type value, std::size_t hash)
+    { impl_.add_mut({}, std::move(value), hash); return std::move(*this); }
+    map insert_move(std::false_type, value_type value, std::size_t hash)
+    { return impl_.add(std::move(value), hash); }
+
+    map&& set_move(std::true_type, key_type k, mapped_type v)
+    { impl_.add_mut({}, {std::move(k), std::move(v)}); return std::move(*this); }
+    map set_move(std::false_type, key_type k, mapped_type v)
+    { return impl_.add({std::move(k), std::move(v)}); }
+
+    template <typename Fn, typename Eq>
+    map&& update_if_changed_move(std::true_type, key_type k, Fn&& fn, Eq&& eq)
+    {
+        auto hash = Hash{}(k);
+        auto old  = impl_.template get<project_value_ptr,
+                                       detail::constantly<const T*, nullptr>>(
+                                           k, hash);
+        if (!old)
+            impl_.add_mut({}, { std::move(k),
+                                std::forward<Fn>(fn)(default_value{}()) },
+                          hash);
+        else {
+            auto v = std::forward<Fn>(fn)(*old);
+            if (!eq(*old, v))
+                impl_.add_mut({}, { std::move(k), std::move(v) }, hash);
+        }
+        return std::move(*this);
+    }
+    template <typename Fn, typename Eq>
+    map update_if_changed_move(std::false_type, key_type k, Fn&& fn, Eq&& eq)
+    {
+        return update_if_changed(std::move(k), std::forward<Fn>(fn),
+                                 std::forward<Eq>(eq));
+    }
+
+    template <typename Range>
+    map&& set_many_move(std::true_type, const Range& values)
+    {
+        impl_.add_many_mut({}, std::begin(values), std::end(values));
+        return std::move(*this);
+    }
+    template <typename Range>
+    map set_many_move(std::false_type, const Range& values)
+    { return impl_.add_many(std::begin(values), std::end(values)); }
+
+    template <typename Range>
+    map&& erase_many_move(std::true_type, const Range& keys)
+    {
+        impl_.sub_many_mut({}, std::begin(keys), std::end(keys));
+        return std::move(*this);
+    }
+    template <typename Range>
+    map erase_many_move(std::false_type, const Range& keys)
+    { return impl_.sub_many(std::begin(keys), std::end(keys)); }
+
+    template <typename Fn>
+    map&& update_move(std::true_type, key_type k, Fn&& fn)
+    {
+        impl_.template update_mut<project_value, default_value, combine_value>(
+            {}, std::move(k), std::forward<Fn>(fn));
+        return std::move(*this);
+    }
+    template <typename Fn>
+    map update_move(std::false_type, key_type k, Fn&& fn)
+    {
+        return impl_
+            .template update<project_value, default_value, combine_value>(
+                std::move(k), std::forward<Fn>(fn));
+    }
+
+    template <typename Key>
+    map&& erase_move(std::true_type, const Key& k)
+    { impl_.sub_mut({}, k); return std::move(*this); }
+    template <typename Key>
+    map erase_move(std::false_type, const Key& k)
+    { return impl_.sub(k); }
+
+    map&& erase_move(std::true_type, const K& k, std::size_t hash)
+    { impl_.sub_mut({}, k, hash); return std::move(*this); }
+    map erase_move(std::false_type, const K& k, std::size_t hash)
+    { return impl_.sub(k, hash); }
+
     impl_t impl_ = impl_t::empty();
 };
 
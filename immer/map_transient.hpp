@@ -9,6 +9,7 @@
 #pragma once
 
 #include "memory_policy.hpp"
+#include "map.hpp"
 #include "detail/hamts/champ.hpp"
 
 #include <functional>
@@ -16,7 +17,14 @@
 namespace immer {
 
 /*!
- * **WORK IN PROGRESS**
+ * Mutable version of `immer::map`.
+ *
+ * @rst
+ *
+ * Refer to :doc:`transients` to learn more about when and how to use
+ * the mutable versions of immutable containers.
+ *
+ * @endrst
  */
 template <typename K,
           typename T,
@@ -24,6 +32,189 @@ template <typename K,
           typename Equal         = std::equal_to<K>,
           typename MemoryPolicy  = default_memory_policy,
           detail::hamts::bits_t B = default_bits>
-class map_transient;
+class map_transient
+    : MemoryPolicy::transience_t::owner
+{
+public:
+    using persistent_type = map<K, T, Hash, Equal, MemoryPolicy, B>;
+
+private:
+    using impl_t  = typename persistent_type::impl_t;
+    using owner_t = typename MemoryPolicy::transience_t::owner;
+
+    using project_value     = typename persistent_type::project_value;
+    using project_value_ptr = typename persistent_type::project_value_ptr;
+    using combine_value     = typename persistent_type::combine_value;
+    using default_value     = typename persistent_type::default_value;
+    using error_value       = typename persistent_type::error_value;
+
+public:
+    using key_type = K;
+    using mapped_type = T;
+    using value_type = std::pair<K, T>;
+    using size_type = detail::hamts::size_t;
+    using diference_type = std::ptrdiff_t;
+    using hasher = Hash;
+    using key_equal = Equal;
+    using reference = const value_type&;
+    using const_reference = const value_type&;
+
+    using iterator         = typename persistent_type::iterator;
+    using const_iterator   = iterator;
+
+    /*!
+     * Default constructor.  It creates a mutable map of `size() ==
+     * 0`.  It does not allocate memory and its complexity is
+     * @f$ O(1) @f$.
+     */
+    map_transient() = default;
+
+    /*!
+     * Returns an iterator pointing at the first element of the
+     * collection. It does not allocate memory and its complexity is
+     * @f$ O(1) @f$.
+     */
+    iterator begin() const { return {impl_}; }
+
+    /*!
+     * Returns an iterator pointing just after the last element of the
+     * collection. It does not allocate and its complexity is @f$ O(1) @f$.
+     */
+    iterator end() const { return {impl_, typename iterator::end_t{}}; }
+
+    /*!
+     * Returns the number of elements in the container.  It does
+     * not allocate memory and its complexity is @f$ O(1) @f$.
+     */
+    size_type size() const { return impl_.size; }
+
+    /*!
+     * Returns `true` if there are no elements in the container.  It
+     * does not allocate memory and its complexity is @f$ O(1) @f$.
+     */
+    bool empty() const { return impl_.size == 0; }
+
+    /*!
+     * Returns `1` when the key `k` is contained in the map or `0`
+     * otherwise. It won't allocate memory and its complexity is
+     * *effectively* @f$ O(1) @f$.
+     */
+    size_type count(const K& k) const
+    { return impl_.template get<detail::constantly<size_type, 1>,
+                                detail::constantly<size_type, 0>>(k); }
+
+    template <typename Key,
+              typename = detail::transparent_key_t<Hash, Equal, Key>>
+    size_type count(const Key& k) const
+    { return impl_.template get<detail::constantly<size_type, 1>,
+                                detail::constantly<size_type, 0>>(k); }
+
+    /*!
+     * Returns a `const` reference to the values associated to the key
+     * `k`.  If the key is not contained in the map, it returns a
+     * default constructed value.  It does not allocate memory and its
+     * complexity is *effectively* @f$ O(1) @f$.
+     */
+    const T& operator[] (const K& k) const
+    { return impl_.template get<project_value, default_value>(k); }
+
+    template <typename Key,
+              typename = detail::transparent_key_t<Hash, Equal, Key>>
+    const T& operator[] (const Key& k) const
+    { return impl_.template get<project_value, default_value>(k); }
+
+    /*!
+     * Returns a `const` reference to the values associated to the key
+     * `k`.  If the key is not contained in the map, throws an
+     * `std::out_of_range` error.  It does not allocate memory and its
+     * complexity is *effectively* @f$ O(1) @f$.
+     */
+    const T& at(const K& k) const
+    { return impl_.template get<project_value, error_value>(k); }
+
+    template <typename Key,
+              typename = detail::transparent_key_t<Hash, Equal, Key>>
+    const T& at(const Key& k) const
+    { return impl_.template get<project_value, error_value>(k); }
+
+    /*!
+     * Returns a pointer to the value associated with the key `k`.  If
+     * the key is not contained in the map, a `nullptr` is returned.
+     * It does not allocate memory and its complexity is *effectively*
+     * @f$ O(1) @f$.
+     */
+    const T* find(const K& k) const
+    { return impl_.template get<project_value_ptr,
+                                detail::constantly<const T*, nullptr>>(k); }
+
+    template <typename Key,
+              typename = detail::transparent_key_t<Hash, Equal, Key>>
+    const T* find(const Key& k) const
+    { return impl_.template get<project_value_ptr,
+                                detail::constantly<const T*, nullptr>>(k); }
+
+    /*!
+     * Inserts the association `value`.  If the key is already in the
+     * map, it replaces its association in the map.  It may allocate
+     * memory and its complexity is *effectively* @f$ O(1) @f$.
+     */
+    void insert(value_type value)
+    { impl_.add_mut(*this, std::move(value)); }
+
+    /*!
+     * Inserts the association `(k, v)`.  If the key is already in the
+     * map, it replaces its association in the map.  It may allocate
+     * memory and its complexity is *effectively* @f$ O(1) @f$.
+     */
+    void set(key_type k, mapped_type v)
+    { impl_.add_mut(*this, {std::move(k), std::move(v)}); }
+
+    /*!
+     * Replaces the association `(k, v)` by the association `(k,
+     * fn(v))`, where `v` is the currently associated value for `k` in
+     * the map or a default constructed value otherwise. It may
+     * allocate memory and its complexity is *effectively* @f$ O(1) @f$.
+     */
+    template <typename Fn>
+    void update(key_type k, Fn&& fn)
+    {
+        impl_.template update_mut<project_value, default_value, combine_value>(
+            *this, std::move(k), std::forward<Fn>(fn));
+    }
+
+    /*!
+     * Removes the key `k` from the map.  It does nothing if the key is
+     * not in the map.  It may allocate memory and its complexity is
+     * *effectively* @f$ O(1) @f$.
+     */
+    void erase(const K& k)
+    { impl_.sub_mut(*this, k); }
+
+    template <typename Key,
+              typename = detail::transparent_key_t<Hash, Equal, Key>>
+    void erase(const Key& k)
+    { impl_.sub_mut(*this, k); }
+
+    /*!
+     * Returns an @a immutable form of this container, an
+     * `immer::map`.
+     */
+    persistent_type persistent() &
+    {
+        this->owner_t::operator=(owner_t{});
+        return persistent_type{ impl_ };
+    }
+    persistent_type persistent() &&
+    { return persistent_type{ std::move(impl_) }; }
+
+private:
+    friend persistent_type;
+
+    map_transient(impl_t impl)
+        : impl_(std::move(impl))
+    {}
+
+    impl_t impl_ = impl_t::empty();
+};
 
 } // namespace immer
@@ -79,7 +79,9 @@ constexpr auto get_use_transient_rvalues_v = get_use_transient_rvalues<T>::value
  * @tparam PreferFewerBiggerObjects Boolean flag indicating whether
  *         the user should prefer to allocate memory in bigger chungs
  *         --e.g. by putting various objects in the same memory
- *         region-- or not.
+ *         region-- or not.  When set, relaxed vector nodes embed
+ *         their size tables, and map and set nodes embed their
+ *         values.
  * @tparam UseTransientRValues Boolean flag indicating whether
  *         immutable containers should try to modify contents in-place
  *         when manipulating an r-value reference.
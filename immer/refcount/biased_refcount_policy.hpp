@@ -0,0 +1,111 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#pragma once
+
+#include "config.hpp"
+#include "refcount/no_refcount_policy.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+
+namespace immer {
+
+namespace detail {
+
+/*!
+ * Returns a number identifying the current thread, that is never
+ * reused by other threads during the lifetime of the program.
+ */
+inline std::uint32_t refcount_thread_id()
+{
+    static std::atomic<std::uint32_t> next {1};
+    thread_local static std::uint32_t id = 0;
+    if (IMMER_UNLIKELY(!id))
+        id = next.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+} // namespace detail
+
+/*!
+ * A reference counting policy biased towards the thread that creates
+ * the objects.  The references taken by this *owner* thread are
+ * counted in a `local` count that is updated with plain loads and
+ * stores, while the ones taken by other threads, and all the
+ * releases, are counted in an atomic `shared` count.  The actual
+ * number of references is the sum of both, in modular arithmetic.
+ * It is **thread-safe**.
+ *
+ * Since most nodes are only ever copied by the thread that created
+ * them, most increments avoid the atomic read-modify-write.
+ * Decrements can not be biased in the same way, since the last
+ * reference might be released by any thread, which must then see all
+ * the increments done by the owner --they are made visible by the
+ * synchronization that passed the reference to the releasing thread,
+ * and by the releases done by the owner itself.
+ */
+struct biased_refcount_policy
+{
+    std::uint32_t owner;
+    mutable std::atomic<std::uint32_t> local;
+    mutable std::atomic<std::uint32_t> shared;
+
+    biased_refcount_policy()
+        : owner{detail::refcount_thread_id()}, local{1}, shared{0} {};
+    biased_refcount_policy(disowned)
+        : owner{detail::refcount_thread_id()}, local{0}, shared{0} {}
+
+    void inc()
+    {
+        if (owner == detail::refcount_thread_id())
+            local.store(local.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+        else if (IMMER_LIKELY(owner != immortal_owner))
+            shared.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool dec()
+    {
+        if (IMMER_UNLIKELY(owner == immortal_owner))
+            return false;
+        auto s = shared.fetch_sub(1, std::memory_order_acq_rel) - 1;
+        return s + local.load(std::memory_order_relaxed) == 0;
+    }
+
+    void dec_unsafe()
+    {
+        if (IMMER_LIKELY(owner != immortal_owner)) {
+            assert(count() > 1);
+            shared.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    bool unique()
+    {
+        return owner != immortal_owner && count() == 1;
+    }
+
+    void make_immortal()
+    {
+        owner = immortal_owner;
+    }
+
+private:
+    // no thread gets this identifier
+    static constexpr std::uint32_t immortal_owner = 0;
+
+    std::uint32_t count() const
+    {
+        return shared.load(std::memory_order_acquire)
+            + local.load(std::memory_order_relaxed);
+    }
+};
+
+} // namespace immer
@@ -0,0 +1,284 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#pragma once
+
+#include "refcount/refcount_policy.hpp"
+#include "detail/delete_deep.hpp"
+
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace immer {
+
+namespace detail {
+struct reclamation_job;
+} // namespace detail
+
+/*!
+ * A reference counting policy that counts references like
+ * `RefcountPolicy` does, but that does not destroy the containers
+ * whose root nodes are released by the current thread.  Instead, the
+ * roots are queued, and the destruction of the trees is done later,
+ * by a @ref reclamation_thread or by explicit calls to @ref
+ * drain_deferred, which may limit the work done on every call.
+ * Thus, the time spent releasing a container does not depend on its
+ * size.
+ *
+ * @rst
+ *
+ * .. caution:: The containers may be destroyed in a different thread
+ *    than the one that released them, so the *heap policy* must be
+ *    thread safe, unless all the reclamation is done via explicit
+ *    calls to :cpp:func:`drain_deferred` in the right thread.  Roots
+ *    that are never drained are leaked.
+ *
+ * @endrst
+ */
+template <typename RefcountPolicy = refcount_policy>
+struct deferred_refcount_policy : RefcountPolicy
+{
+    using RefcountPolicy::RefcountPolicy;
+
+    static void defer(detail::reclamation_job job);
+};
+
+namespace detail {
+
+template <typename RefcountPolicy>
+struct is_deferred_refcount : std::false_type {};
+
+template <typename RefcountPolicy>
+struct is_deferred_refcount<deferred_refcount_policy<RefcountPolicy>>
+    : std::true_type {};
+
+template <typename RefcountPolicy>
+constexpr auto is_deferred_refcount_v =
+    is_deferred_refcount<RefcountPolicy>::value;
+
+/*!
+ * A pending destruction of a tree, whose root reference count has
+ * already dropped to zero.  It holds an entry of the `Traits` of
+ * `detail::delete_deep`, and the function that resumes it.
+ */
+struct reclamation_job
+{
+    using storage_t = std::aligned_storage_t<32>;
+
+    std::size_t (*fn)(const reclamation_job&, std::size_t);
+    storage_t entry;
+
+    std::size_t operator()(std::size_t budget) const
+    { return fn(*this, budget); }
+};
+
+class reclamation_queue
+{
+public:
+    static reclamation_queue& instance()
+    {
+        static reclamation_queue instance_;
+        return instance_;
+    }
+
+    void push(reclamation_job job)
+    {
+        auto notify = false;
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            jobs_.push_back(job);
+            notify = waiting_;
+        }
+        if (notify)
+            cv_.notify_one();
+    }
+
+    std::size_t drain(std::size_t budget)
+    {
+        auto deleted = std::size_t{};
+        while (deleted < budget) {
+            auto job = reclamation_job{};
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                if (jobs_.empty())
+                    break;
+                job = jobs_.back();
+                jobs_.pop_back();
+            }
+            deleted += job(budget - deleted);
+        }
+        return deleted;
+    }
+
+    std::size_t pending()
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return jobs_.size();
+    }
+
+    void run(const bool& stop)
+    {
+        while (true) {
+            drain(unlimited_budget);
+            std::unique_lock<std::mutex> lock{mutex_};
+            waiting_ = true;
+            cv_.wait(lock, [&] { return stop || !jobs_.empty(); });
+            waiting_ = false;
+            if (stop && jobs_.empty())
+                return;
+        }
+    }
+
+    void wake() { cv_.notify_all(); }
+
+    std::mutex& mutex() { return mutex_; }
+
+private:
+    reclamation_queue() = default;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<reclamation_job> jobs_;
+    bool waiting_ = false;
+};
+
+inline void defer_reclamation(reclamation_job job)
+{
+    reclamation_queue::instance().push(job);
+}
+
+template <typename Traits>
+reclamation_job make_reclamation_job(const typename Traits::entry& e);
+
+template <typename Traits>
+std::size_t run_reclamation_job(const reclamation_job& job,
+                                std::size_t budget)
+{
+    using entry_t = typename Traits::entry;
+    auto& e = reinterpret_cast<const entry_t&>(job.entry);
+    return delete_deep<Traits>(e, budget, [] (const entry_t& rest) {
+        defer_reclamation(make_reclamation_job<Traits>(rest));
+    });
+}
+
+/*!
+ * Returns a job that deletes the released node in `e`, as it would be
+ * done by `delete_deep<Traits>(e)`.
+ */
+template <typename Traits>
+reclamation_job make_reclamation_job(const typename Traits::entry& e)
+{
+    using entry_t = typename Traits::entry;
+    static_assert(sizeof(entry_t) <= sizeof(reclamation_job::storage_t),
+                  "entry does not fit in a reclamation job");
+    static_assert(std::is_trivially_copyable<entry_t>::value,
+                  "entries must be trivially copyable");
+    auto job = reclamation_job{};
+    job.fn = &run_reclamation_job<Traits>;
+    new (&job.entry) entry_t{e};
+    return job;
+}
+
+template <typename RefcountPolicy>
+void defer_reclamation(reclamation_job job, std::true_type)
+{
+    RefcountPolicy::defer(job);
+}
+
+template <typename RefcountPolicy>
+void defer_reclamation(reclamation_job, std::false_type)
+{
+    assert(!"not a deferred refcount policy");
+}
+
+/*!
+ * Hands the deletion of the released node in `e` to the deferred
+ * `RefcountPolicy`.
+ */
+template <typename RefcountPolicy, typename Traits>
+void defer_delete_deep(const typename Traits::entry& e)
+{
+    defer_reclamation<RefcountPolicy>(
+        make_reclamation_job<Traits>(e),
+        is_deferred_refcount<RefcountPolicy>{});
+}
+
+} // namespace detail
+
+template <typename RefcountPolicy>
+void deferred_refcount_policy<RefcountPolicy>::defer(
+    detail::reclamation_job job)
+{
+    detail::defer_reclamation(job);
+}
+
+/*!
+ * Destroys, in the calling thread, the containers that have been
+ * released under a @ref deferred_refcount_policy and are still
+ * pending, deallocating at most `budget` nodes.  The trees that are
+ * not completely destroyed when the budget is exhausted stay in the
+ * queue, to be resumed on the next call.  Returns the number of
+ * nodes that were deallocated.
+ */
+inline std::size_t drain_deferred(
+    std::size_t budget = detail::unlimited_budget)
+{
+    return detail::reclamation_queue::instance().drain(budget);
+}
+
+/*!
+ * Returns the number of trees, or parts of them, released under a
+ * @ref deferred_refcount_policy that are waiting to be destroyed.
+ */
+inline std::size_t pending_deferred()
+{
+    return detail::reclamation_queue::instance().pending();
+}
+
+/*!
+ * A background thread that destroys the containers released under a
+ * @ref deferred_refcount_policy as soon as they are queued.  It is
+ * stopped, after draining all the pending work, when this object is
+ * destroyed.  There should be at most one of these at a time.
+ */
+class reclamation_thread
+{
+public:
+    reclamation_thread()
+        : thread_{[this] { queue_.run(stop_); }}
+    {}
+
+    ~reclamation_thread()
+    {
+        {
+            std::lock_guard<std::mutex> lock{queue_.mutex()};
+            stop_ = true;
+        }
+        queue_.wake();
+        thread_.join();
+    }
+
+    reclamation_thread(const reclamation_thread&) = delete;
+    reclamation_thread& operator=(const reclamation_thread&) = delete;
+
+private:
+    // getting the queue here ensures that it outlives static threads
+    detail::reclamation_queue& queue_ =
+        detail::reclamation_queue::instance();
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+} // namespace immer
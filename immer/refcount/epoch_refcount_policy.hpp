@@ -0,0 +1,415 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#pragma once
+
+#include "config.hpp"
+#include "memory_policy.hpp"
+#include "refcount/no_refcount_policy.hpp"
+#include "refcount/refcount_policy.hpp"
+#include "refcount/deferred_refcount_policy.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace immer {
+
+namespace detail {
+
+/*!
+ * Number of @ref epoch_guard alive in the current thread.
+ */
+inline int& epoch_depth()
+{
+    thread_local static int depth = 0;
+    return depth;
+}
+
+/*!
+ * Whether the current thread is copying or releasing the container
+ * of an @ref epoch_snapshot, whose references are not counted.
+ */
+inline bool& epoch_uncounted()
+{
+    thread_local static bool uncounted = false;
+    return uncounted;
+}
+
+/*!
+ * Keeps track of the epochs in which the threads are reading, and of
+ * the trees that have been retired in every epoch.  A tree retired in
+ * epoch `e` can be deleted once the global epoch is `e + 2`, since
+ * the epoch only advances when every thread that is reading has
+ * observed the current one.
+ */
+class epoch_domain
+{
+public:
+    static epoch_domain& instance()
+    {
+        // never destroyed, since containers with static storage may
+        // be released after it otherwise
+        static auto instance_ = new epoch_domain{};
+        return *instance_;
+    }
+
+    void enter()
+    {
+        auto& r = local().get();
+        r.store(global_.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    void leave()
+    {
+        local().get().store(0, std::memory_order_release);
+    }
+
+    void retire(reclamation_job job)
+    {
+        // a tree released while deleting another retired one may
+        // still be seen through a snapshot taken by a reader in a
+        // later epoch, so it is retired in the current one too
+        auto size = std::size_t{};
+        {
+            std::lock_guard<std::mutex> lock{retired_mutex_};
+            auto epoch = global_.load(std::memory_order_acquire);
+            retired_.push_back({epoch, job});
+            size = retired_.size();
+        }
+        if (size % default_epoch_reclaim_interval == 0
+            && !epoch_depth() && !reclaiming())
+            reclaim();
+    }
+
+    std::size_t reclaim()
+    {
+        assert(!epoch_depth());
+        auto deleted = std::size_t{};
+        auto ready = std::vector<retired_job>{};
+        // deleting a tree may retire the trees nested in it, which
+        // are collected in the next rounds when no reader holds the
+        // epoch back
+        do {
+            if (try_advance())
+                try_advance();
+            auto epoch = global_.load(std::memory_order_acquire);
+            ready.clear();
+            {
+                std::lock_guard<std::mutex> lock{retired_mutex_};
+                auto it = std::stable_partition(
+                    retired_.begin(), retired_.end(),
+                    [&] (auto&& r) { return r.epoch + 2 > epoch; });
+                ready.assign(it, retired_.end());
+                retired_.erase(it, retired_.end());
+            }
+            auto was_reclaiming = reclaiming();
+            reclaiming() = true;
+            for (auto& r : ready)
+                deleted += r.job(unlimited_budget);
+            reclaiming() = was_reclaiming;
+        } while (!ready.empty());
+        return deleted;
+    }
+
+    std::size_t pending()
+    {
+        std::lock_guard<std::mutex> lock{retired_mutex_};
+        return retired_.size();
+    }
+
+private:
+    using record = std::atomic<std::uint64_t>;
+
+    struct retired_job
+    {
+        std::uint64_t epoch;
+        reclamation_job job;
+    };
+
+    // The record of a thread is registered when it first reads, and
+    // unregistered when the thread finishes.  Zero means that the
+    // thread is not reading.
+    struct local_t
+    {
+        epoch_domain& domain = instance();
+        record* rec = nullptr;
+
+        record& get()
+        {
+            if (IMMER_UNLIKELY(!rec))
+                rec = domain.add_record();
+            return *rec;
+        }
+
+        ~local_t()
+        {
+            if (rec)
+                domain.remove_record(rec);
+        }
+    };
+
+    static local_t& local()
+    {
+        thread_local static local_t l;
+        return l;
+    }
+
+    static bool& reclaiming()
+    {
+        thread_local static bool r = false;
+        return r;
+    }
+
+    record* add_record()
+    {
+        auto r = new record{0};
+        std::lock_guard<std::mutex> lock{records_mutex_};
+        records_.push_back(r);
+        return r;
+    }
+
+    void remove_record(record* r)
+    {
+        {
+            std::lock_guard<std::mutex> lock{records_mutex_};
+            records_.erase(std::find(records_.begin(), records_.end(), r));
+        }
+        delete r;
+    }
+
+    bool try_advance()
+    {
+        auto epoch = global_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        {
+            std::lock_guard<std::mutex> lock{records_mutex_};
+            for (auto r : records_) {
+                auto e = r->load(std::memory_order_acquire);
+                if (e && e != epoch)
+                    return false;
+            }
+        }
+        global_.compare_exchange_strong(epoch, epoch + 1,
+                                        std::memory_order_acq_rel);
+        return true;
+    }
+
+    epoch_domain() = default;
+
+    std::atomic<std::uint64_t> global_ {1};
+    std::mutex records_mutex_;
+    std::vector<record*> records_;
+    std::mutex retired_mutex_;
+    std::vector<retired_job> retired_;
+};
+
+} // namespace detail
+
+/*!
+ * Marks a scope in which the current thread is reading containers
+ * that use the @ref epoch_refcount_policy.  The trees released by
+ * other threads while a guard is alive are not deleted until the
+ * guard is gone.  Guards can be nested.  Containers must not be
+ * updated inside a guard.
+ */
+class epoch_guard
+{
+public:
+    epoch_guard()
+    {
+        if (detail::epoch_depth()++ == 0)
+            detail::epoch_domain::instance().enter();
+    }
+
+    ~epoch_guard()
+    {
+        if (--detail::epoch_depth() == 0)
+            detail::epoch_domain::instance().leave();
+    }
+
+    epoch_guard(const epoch_guard&) = delete;
+    epoch_guard& operator=(const epoch_guard&) = delete;
+};
+
+/*!
+ * A reference counting policy for containers that are written by
+ * some threads and read by many others.  It counts references
+ * atomically, like @ref refcount_policy does, except for the
+ * container held by an @ref epoch_snapshot, so readers can take
+ * snapshots of the containers without touching the shared cache
+ * lines of their roots.  When the last counted reference to a tree
+ * is released, the tree is *retired*, and it is only deleted once
+ * all the threads that were reading at that point have left their
+ * @ref epoch_guard.  It is **thread-safe**.
+ *
+ * @rst
+ *
+ * .. caution:: Containers must not be updated inside a guard, as
+ *    the new nodes could share retired ones.  Since uncounted
+ *    snapshots may exist, nodes are never considered unique, so
+ *    r-value updates and transients always copy.
+ *
+ * .. note:: Retired trees are deleted by :cpp:func:`drain_retired`,
+ *    which is also called periodically when trees are retired.
+ *
+ * @endrst
+ */
+struct epoch_refcount_policy
+{
+    mutable std::atomic<int> refcount;
+
+    epoch_refcount_policy() : refcount{1}
+    {
+        assert(!detail::epoch_depth() &&
+               "containers must not be updated inside an epoch_guard");
+    }
+    epoch_refcount_policy(disowned) : refcount{0} {}
+
+    void inc()
+    {
+        if (counting())
+            refcount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool dec()
+    {
+        return counting()
+            && 1 == refcount.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    void dec_unsafe()
+    {
+        if (counting()) {
+            assert(refcount.load() > 1);
+            refcount.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    bool unique()
+    {
+        return false;
+    }
+
+    void make_immortal()
+    {
+        refcount.store(refcount_policy::immortal_count,
+                       std::memory_order_relaxed);
+    }
+
+    bool counting() const
+    {
+        return !detail::epoch_uncounted()
+            && refcount.load(std::memory_order_relaxed)
+               != refcount_policy::immortal_count;
+    }
+
+    static void defer(detail::reclamation_job job)
+    {
+        detail::epoch_domain::instance().retire(job);
+    }
+};
+
+/*!
+ * An uncounted reference to a container that uses the @ref
+ * epoch_refcount_policy.  Taking and releasing a snapshot does not
+ * touch the reference counts of the container, and the trees it
+ * refers to are kept alive because the snapshot holds an @ref
+ * epoch_guard for as long as it exists.  The snapshot is bound to
+ * the thread that took it, so it can not be copied nor moved.
+ *
+ * @rst
+ *
+ * .. caution:: The container of the snapshot may only be read.  It
+ *    must not be copied nor updated, since its trees may already be
+ *    retired, use the source container for that.
+ *
+ * @endrst
+ */
+template <typename Container>
+class epoch_snapshot
+{
+public:
+    explicit epoch_snapshot(const Container& c)
+    {
+        uncounted_scope s;
+        new (&storage_) Container(c);
+    }
+
+    ~epoch_snapshot()
+    {
+        uncounted_scope s;
+        get().~Container();
+    }
+
+    epoch_snapshot(const epoch_snapshot&) = delete;
+    epoch_snapshot& operator=(const epoch_snapshot&) = delete;
+
+    const Container& get() const
+    { return *reinterpret_cast<const Container*>(&storage_); }
+
+    const Container& operator*() const { return get(); }
+    const Container* operator->() const { return &get(); }
+
+private:
+    struct uncounted_scope
+    {
+        bool previous = detail::epoch_uncounted();
+
+        uncounted_scope()  { detail::epoch_uncounted() = true; }
+        ~uncounted_scope() { detail::epoch_uncounted() = previous; }
+    };
+
+    epoch_guard guard_;
+    std::aligned_storage_t<sizeof(Container), alignof(Container)> storage_;
+};
+
+namespace detail {
+
+template <>
+struct is_deferred_refcount<epoch_refcount_policy> : std::true_type {};
+
+} // namespace detail
+
+/*!
+ * Nodes counted with the @ref epoch_refcount_policy are never unique,
+ * so r-value updates return new containers instead of trying to
+ * mutate in place.
+ */
+template <>
+struct get_use_transient_rvalues<epoch_refcount_policy> : std::false_type {};
+
+/*!
+ * Deletes, in the calling thread, the trees retired under the @ref
+ * epoch_refcount_policy that are no longer visible to any reader.
+ * It must not be called inside an @ref epoch_guard.  Returns the
+ * number of nodes that were deallocated.
+ */
+inline std::size_t drain_retired()
+{
+    return detail::epoch_domain::instance().reclaim();
+}
+
+/*!
+ * Returns the number of trees retired under the @ref
+ * epoch_refcount_policy that are waiting to be deleted.
+ */
+inline std::size_t pending_retired()
+{
+    return detail::epoch_domain::instance().pending();
+}
+
+} // namespace immer
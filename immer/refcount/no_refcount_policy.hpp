@@ -25,6 +25,7 @@ struct no_refcount_policy
     bool dec() { return false; }
     void dec_unsafe() {}
     bool unique() { return false; }
+    void make_immortal() {}
 };
 
 } // namespace immer
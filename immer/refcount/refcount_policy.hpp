@@ -8,20 +8,26 @@
 
 #pragma once
 
+#include "config.hpp"
 #include "refcount/no_refcount_policy.hpp"
 
 #include <atomic>
 #include <utility>
 #include <cassert>
+#include <limits>
 
 namespace immer {
 
 /*!
  * A reference counting policy implemented using an *atomic* `int`
- * count.  It is **thread-safe**.
+ * count.  It is **thread-safe**.  The count of *immortal* objects is
+ * only ever read, so that they do not bounce between the caches of
+ * the threads that use them.
  */
 struct refcount_policy
 {
+    static constexpr int immortal_count = std::numeric_limits<int>::min();
+
     mutable std::atomic<int> refcount;
 
     refcount_policy() : refcount{1} {};
@@ -29,18 +35,32 @@ struct refcount_policy
 
     void inc()
     {
-        refcount.fetch_add(1, std::memory_order_relaxed);
+        if (IMMER_LIKELY(!immortal()))
+            refcount.fetch_add(1, std::memory_order_relaxed);
     }
 
     bool dec()
     {
-        return 1 == refcount.fetch_sub(1, std::memory_order_acq_rel);
+        return IMMER_LIKELY(!immortal())
+            && 1 == refcount.fetch_sub(1, std::memory_order_acq_rel);
     }
 
     void dec_unsafe()
     {
-        assert(refcount.load() > 1);
-        refcount.fetch_sub(1, std::memory_order_relaxed);
+        if (IMMER_LIKELY(!immortal())) {
+            assert(refcount.load() > 1);
+            refcount.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    void make_immortal()
+    {
+        refcount.store(immortal_count, std::memory_order_relaxed);
+    }
+
+    bool immortal() const
+    {
+        return refcount.load(std::memory_order_relaxed) == immortal_count;
     }
 
     bool unique()
@@ -11,13 +11,15 @@
 #include "refcount/no_refcount_policy.hpp"
 
 #include <atomic>
+#include <limits>
 #include <utility>
 
 namespace immer {
 
 /*!
  * A reference counting policy implemented using a raw `int` count.
- * It is **not thread-safe**.
+ * It is **not thread-safe**.  Immortal objects just start with a
+ * count that is never going to drop to zero.
  */
 struct unsafe_refcount_policy
 {
@@ -30,6 +32,7 @@ struct unsafe_refcount_policy
     bool dec() { return --refcount == 0; }
     void dec_unsafe() { --refcount; }
     bool unique() { return refcount == 1; }
+    void make_immortal() { refcount = std::numeric_limits<int>::max() / 2; }
 };
 
 } // namespace immer
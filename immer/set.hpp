@@ -13,6 +13,7 @@
 #include "detail/hamts/champ_iterator.hpp"
 
 #include <functional>
+#include <initializer_list>
 
 namespace immer {
 
@@ -28,9 +29,13 @@ class set_transient;
  *
  * @tparam T    The type of the values to be stored in the container.
  * @tparam Hash The type of a function object capable of hashing
- *              values of type `T`.
+ *              values of type `T`.  Wrap it in `immer::cached_hash`
+ *              to store the hashes in the container.
  * @tparam Equal The type of a function object capable of comparing
- *              values of type `T`.
+ *              values of type `T`.  When both `Hash` and `Equal`
+ *              declare an `is_transparent` type, lookups and `erase`
+ *              also take values of other types, which are passed to
+ *              them without being converted.
  * @tparam MemoryPolicy Memory management policy. See @ref
  *              memory_policy.
  *
@@ -62,7 +67,12 @@ class set
 {
     using impl_t = detail::hamts::champ<T, Hash, Equal, MemoryPolicy, B>;
 
+    using move_t =
+        std::integral_constant<bool, MemoryPolicy::use_transient_rvalues>;
+
 public:
+    using memory_policy = MemoryPolicy;
+
     using key_type = T;
     using value_type = T;
     using size_type = detail::hamts::size_t;
@@ -84,6 +94,28 @@ public:
      */
     set() = default;
 
+    /*!
+     * Constructs a set containing the values in `values`.  When some
+     * of them are equal, the last one is kept.
+     */
+    set(std::initializer_list<T> values)
+        : impl_{impl_t::from_range(values.begin(), values.end())}
+    {}
+
+    /*!
+     * Constructs a set containing the values in the range defined by
+     * the input iterator `first` and range sentinel `last`.  When some
+     * of them are equal, the last one is kept.  The nodes are
+     * built bottom-up, allocating each of them only once, which is
+     * much faster than inserting the values one by one.
+     */
+    template <typename Iter, typename Sent,
+              std::enable_if_t
+              <detail::compatible_sentinel_v<Iter, Sent>, bool> = true>
+    set(Iter first, Sent last)
+        : impl_{impl_t::from_range(first, last)}
+    {}
+
     /*!
      * Returns an iterator pointing at the first element of the
      * collection. It does not allocate memory and its complexity is
@@ -112,6 +144,23 @@ public:
     { return impl_.template get<detail::constantly<size_type, 1>,
                                 detail::constantly<size_type, 0>>(value); }
 
+    template <typename Key,
+              typename = detail::transparent_key_t<Hash, Equal, Key>>
+    size_type count(const Key& value) const
+    { return impl_.template get<detail::constantly<size_type, 1>,
+                                detail::constantly<size_type, 0>>(value); }
+
+    /*!
+     * Like `count(value)`, but takes `hash`, which must be
+     * `Hash{}(value)`, so the value is not hashed again.  This is
+     * useful when looking up the same value in several sets, or when
+     * it is expensive to hash.
+     */
+    size_type count_hashed(const T& value, std::size_t hash) const
+    { return impl_.template get<detail::constantly<size_type, 1>,
+                                detail::constantly<size_type, 0>>(
+                                    value, hash); }
+
     /*!
      * Returns whether the sets are equal.
      */
@@ -125,17 +174,102 @@ public:
      * the set, it returns the same set.  It may allocate memory and
      * its complexity is *effectively* @f$ O(1) @f$.
      */
-    set insert(T value) const
+    set insert(T value) const&
     { return impl_.add(std::move(value)); }
 
+    decltype(auto) insert(T value) &&
+    { return insert_move(move_t{}, std::move(value)); }
+
+    /*!
+     * Like `insert(value)`, but takes `hash`, which must be
+     * `Hash{}(value)`, so the value is not hashed again.
+     */
+    set insert_hashed(T value, std::size_t hash) const&
+    { return impl_.add(std::move(value), hash); }
+
+    decltype(auto) insert_hashed(T value, std::size_t hash) &&
+    { return insert_move(move_t{}, std::move(value), hash); }
+
+    /*!
+     * Returns a set containing the values in the range defined by the
+     * input iterator `first` and range sentinel `last`.  The range is
+     * built into a trie on its own, and then merged with this set, so
+     * the values that were already in the set are kept.
+     */
+    template <typename Iter, typename Sent,
+              std::enable_if_t
+              <detail::compatible_sentinel_v<Iter, Sent>, bool> = true>
+    set insert(Iter first, Sent last) const
+    {
+        return impl_.merge(impl_t::from_range(first, last),
+                           [] (const T& a, const T&) -> const T& {
+                               return a;
+                           });
+    }
+
     /*!
      * Returns a set without `value`.  If the `value` is not in the
      * set it returns the same set.  It may allocate memory and its
      * complexity is *effectively* @f$ O(1) @f$.
      */
-    set erase(const T& value) const
+    set erase(const T& value) const&
+    { return impl_.sub(value); }
+
+    decltype(auto) erase(const T& value) &&
+    { return erase_move(move_t{}, value); }
+
+    template <typename Key,
+              typename = detail::transparent_key_t<Hash, Equal, Key>>
+    set erase(const Key& value) const&
     { return impl_.sub(value); }
 
+    template <typename Key,
+              typename = detail::transparent_key_t<Hash, Equal, Key>>
+    decltype(auto) erase(const Key& value) &&
+    { return erase_move(move_t{}, value); }
+
+    /*!
+     * Like `erase(value)`, but takes `hash`, which must be
+     * `Hash{}(value)`, so the value is not hashed again.
+     */
+    set erase_hashed(const T& value, std::size_t hash) const&
+    { return impl_.sub(value, hash); }
+
+    decltype(auto) erase_hashed(const T& value, std::size_t hash) &&
+    { return erase_move(move_t{}, value, hash); }
+
+    /*!
+     * Returns a set with the values that are in this set or in
+     * `other`.  The subtrees that are shared by both sets are reused,
+     * and so are the nodes of this set where they do not differ.
+     * Thus, when `other` is a version of this same set, its
+     * complexity is @f$ O(d \cdot log(size)) @f$, where @f$ d @f$ is
+     * the number of values where they differ.
+     */
+    set merge(const set& other) const
+    {
+        return impl_.merge(other.impl_,
+                           [] (const T& a, const T&) -> const T& {
+                               return a;
+                           });
+    }
+
+    /*!
+     * Returns a set with the values that are both in this set and in
+     * `other`.  Like @ref merge, it reuses the subtrees that are
+     * shared by both sets.
+     */
+    set intersect(const set& other) const
+    { return impl_.intersect(other.impl_); }
+
+    /*!
+     * Returns a set with the values of this set that are not in
+     * `other`.  Like @ref merge, it reuses the subtrees that are
+     * shared by both sets.
+     */
+    set difference(const set& other) const
+    { return impl_.difference(other.impl_); }
+
     /*!
      * Returns an @a transient form of this container, a
      * `immer::set_transient`.
@@ -155,6 +289,28 @@ private:
         : impl_(std::move(impl))
     {}
 
+    set&& insert_move(std::true_type, T value)
+    { impl_.add_mut({}, std::move(value)); return std::move(*this); }
+    set insert_move(std::false_type, T value)
+    { return impl_.add(std::move(value)); }
+
+    set&& insert_move(std::true_type, T value, std::size_t hash)
+    { impl_.add_mut({}, std::move(value), hash); return std::move(*this); }
+    set insert_move(std::false_type, T value, std::size_t hash)
+    { return impl_.add(std::move(value), hash); }
+
+    template <typename Key>
+    set&& erase_move(std::true_type, const Key& value)
+    { impl_.sub_mut({}, value); return std::move(*this); }
+    template <typename Key>
+    set erase_move(std::false_type, const Key& value)
+    { return impl_.sub(value); }
+
+    set&& erase_move(std::true_type, const T& value, std::size_t hash)
+    { impl_.sub_mut({}, value, hash); return std::move(*this); }
+    set erase_move(std::false_type, const T& value, std::size_t hash)
+    { return impl_.sub(value, hash); }
+
     impl_t impl_ = impl_t::empty();
 };
 
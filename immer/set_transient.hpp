@@ -9,6 +9,7 @@
 #pragma once
 
 #include "memory_policy.hpp"
+#include "set.hpp"
 #include "detail/hamts/champ.hpp"
 
 #include <functional>
@@ -16,13 +17,130 @@
 namespace immer {
 
 /*!
- * **WORK IN PROGRESS**
+ * Mutable version of `immer::set`.
+ *
+ * @rst
+ *
+ * Refer to :doc:`transients` to learn more about when and how to use
+ * the mutable versions of immutable containers.
+ *
+ * @endrst
  */
 template <typename T,
           typename Hash          = std::hash<T>,
           typename Equal         = std::equal_to<T>,
           typename MemoryPolicy  = default_memory_policy,
           detail::hamts::bits_t B = default_bits>
-class set_transient;
+class set_transient
+    : MemoryPolicy::transience_t::owner
+{
+    using impl_t  = detail::hamts::champ<T, Hash, Equal, MemoryPolicy, B>;
+    using owner_t = typename MemoryPolicy::transience_t::owner;
+
+public:
+    using key_type = T;
+    using value_type = T;
+    using size_type = detail::hamts::size_t;
+    using diference_type = std::ptrdiff_t;
+    using hasher = Hash;
+    using key_equal = Equal;
+    using reference = const T&;
+    using const_reference = const T&;
+
+    using iterator         = detail::hamts::champ_iterator<T, Hash, Equal,
+                                                         MemoryPolicy, B>;
+    using const_iterator   = iterator;
+
+    using persistent_type  = set<T, Hash, Equal, MemoryPolicy, B>;
+
+    /*!
+     * Default constructor.  It creates a mutable set of `size() ==
+     * 0`.  It does not allocate memory and its complexity is
+     * @f$ O(1) @f$.
+     */
+    set_transient() = default;
+
+    /*!
+     * Returns an iterator pointing at the first element of the
+     * collection. It does not allocate memory and its complexity is
+     * @f$ O(1) @f$.
+     */
+    iterator begin() const { return {impl_}; }
+
+    /*!
+     * Returns an iterator pointing just after the last element of the
+     * collection. It does not allocate and its complexity is @f$ O(1) @f$.
+     */
+    iterator end() const { return {impl_, typename iterator::end_t{}}; }
+
+    /*!
+     * Returns the number of elements in the container.  It does
+     * not allocate memory and its complexity is @f$ O(1) @f$.
+     */
+    size_type size() const { return impl_.size; }
+
+    /*!
+     * Returns `true` if there are no elements in the container.  It
+     * does not allocate memory and its complexity is @f$ O(1) @f$.
+     */
+    bool empty() const { return impl_.size == 0; }
+
+    /*!
+     * Returns `1` when `value` is contained in the set or `0`
+     * otherwise. It won't allocate memory and its complexity is
+     * *effectively* @f$ O(1) @f$.
+     */
+    size_type count(const T& value) const
+    { return impl_.template get<detail::constantly<size_type, 1>,
+                                detail::constantly<size_type, 0>>(value); }
+
+    template <typename Key,
+              typename = detail::transparent_key_t<Hash, Equal, Key>>
+    size_type count(const Key& value) const
+    { return impl_.template get<detail::constantly<size_type, 1>,
+                                detail::constantly<size_type, 0>>(value); }
+
+    /*!
+     * Inserts `value` in the set.  It does nothing if the `value` is
+     * already in the set.  It may allocate memory and its complexity
+     * is *effectively* @f$ O(1) @f$.
+     */
+    void insert(T value)
+    { impl_.add_mut(*this, std::move(value)); }
+
+    /*!
+     * Removes `value` from the set.  It does nothing if the `value` is
+     * not in the set.  It may allocate memory and its complexity is
+     * *effectively* @f$ O(1) @f$.
+     */
+    void erase(const T& value)
+    { impl_.sub_mut(*this, value); }
+
+    template <typename Key,
+              typename = detail::transparent_key_t<Hash, Equal, Key>>
+    void erase(const Key& value)
+    { impl_.sub_mut(*this, value); }
+
+    /*!
+     * Returns an @a immutable form of this container, an
+     * `immer::set`.
+     */
+    persistent_type persistent() &
+    {
+        this->owner_t::operator=(owner_t{});
+        return persistent_type{ impl_ };
+    }
+    persistent_type persistent() &&
+    { return persistent_type{ std::move(impl_) }; }
+
+private:
+    friend persistent_type;
+
+    set_transient(impl_t impl)
+        : impl_(std::move(impl))
+    {}
+
+    impl_t impl_ = impl_t::empty();
+};
 
 } // namespace immer
@@ -12,6 +12,8 @@
 #include "detail/rbts/rbtree_iterator.hpp"
 #include "memory_policy.hpp"
 
+#include <functional>
+
 #if IMMER_DEBUG_PRINT
 #include "flex_vector.hpp"
 #endif
@@ -247,6 +249,28 @@ public:
     decltype(auto) set(size_type index, value_type value) &&
     { return set_move(move_t{}, index, std::move(value)); }
 
+    /*!
+     * Like `set(index, value)`, but when `value` is equal to the
+     * element at position `index`, as compared by `eq`, it returns the
+     * same vector without allocating memory.
+     */
+    template <typename Eq = std::equal_to<T>>
+    vector set_if_changed(size_type index, value_type value,
+                      Eq&& eq = Eq{}) const&
+    {
+        if (eq(impl_.get(index), value))
+            return *this;
+        return impl_.assoc(index, std::move(value));
+    }
+
+    template <typename Eq = std::equal_to<T>>
+    decltype(auto) set_if_changed(size_type index, value_type value,
+                                  Eq&& eq = Eq{}) &&
+    {
+        return set_if_changed_move(move_t{}, index, std::move(value),
+                                   std::forward<Eq>(eq));
+    }
+
     /*!
      * Returns a vector containing the result of the expression
      * `fn((*this)[idx])` at position `idx`.
@@ -336,6 +360,19 @@ private:
     vector set_move(std::false_type, size_type index, value_type value)
     { return impl_.assoc(index, std::move(value)); }
 
+    template <typename Eq>
+    vector&& set_if_changed_move(std::true_type, size_type index,
+                                value_type value, Eq&& eq)
+    {
+        if (!eq(impl_.get(index), value))
+            impl_.assoc_mut({}, index, std::move(value));
+        return std::move(*this);
+    }
+    template <typename Eq>
+    vector set_if_changed_move(std::false_type, size_type index,
+                              value_type value, Eq&& eq)
+    { return set_if_changed(index, std::move(value), std::forward<Eq>(eq)); }
+
     template <typename Fn>
     vector&& update_move(std::true_type, size_type index, Fn&& fn)
     { impl_.update_mut({}, index, std::forward<Fn>(fn)); return std::move(*this); }
@@ -0,0 +1,28 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#include <immer/flex_vector.hpp>
+#include <immer/vector.hpp>
+#include <immer/refcount/deferred_refcount_policy.hpp>
+
+using deferred_memory = immer::memory_policy<
+    immer::free_list_heap_policy<immer::cpp_heap>,
+    immer::deferred_refcount_policy<>>;
+
+template <typename T>
+using test_flex_vector_t = immer::flex_vector<T, deferred_memory, 3u>;
+
+template <typename T>
+using test_vector_t = immer::vector<T, deferred_memory, 3u>;
+
+// all the containers released by the tests below are destroyed here
+static immer::reclamation_thread test_reclamation_thread;
+
+#define FLEX_VECTOR_T test_flex_vector_t
+#define VECTOR_T      test_vector_t
+#include "generic.ipp"
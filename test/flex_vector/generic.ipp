@@ -17,6 +17,7 @@
 #include <boost/range/irange.hpp>
 
 #include <algorithm>
+#include <deque>
 #include <numeric>
 #include <vector>
 #include <array>
@@ -115,6 +116,82 @@ TEST_CASE("push_front")
     }
 }
 
+TEST_CASE("push_front move")
+{
+    const auto n = 666u;
+    auto v = FLEX_VECTOR_T<unsigned>{};
+
+    for (auto i = 0u; i < n; ++i) {
+        v = std::move(v).push_front(i);
+        CHECK(v.size() == i + 1);
+    }
+    CHECK_VECTOR_EQUALS(v, boost::irange(0u, n) | boost::adaptors::reversed);
+}
+
+TEST_CASE("push front and back")
+{
+    const auto n = 666u;
+    auto v = FLEX_VECTOR_T<unsigned>{};
+    auto d = std::deque<unsigned>{};
+
+    for (auto i = 0u; i < n; ++i) {
+        if (i % 3) {
+            v = v.push_front(i);
+            d.push_front(i);
+        } else {
+            v = v.push_back(i);
+            d.push_back(i);
+        }
+        if (i % 7 == 6) {
+            v = v.drop(1);
+            d.pop_front();
+        }
+        CHECK(v.size() == d.size());
+        CHECK(v.front() == d.front());
+        CHECK(v.back() == d.back());
+    }
+    CHECK_VECTOR_EQUALS_RANGE(v, d.begin(), d.end());
+    CHECK_VECTOR_EQUALS_RANGE(v.set(42, 0).set(42, d[42]), d.begin(), d.end());
+    CHECK(v == v.take(13) + v.drop(13));
+    CHECK(v == v.drop(1).push_front(d.front()));
+    CHECK((v.push_front(1) + v) == (v + v).push_front(1));
+}
+
+TEST_CASE("pop front")
+{
+    const auto n = 666u;
+
+    SECTION("regular")
+    {
+        auto v = make_test_flex_vector(0, n);
+        for (auto i = 0u; i < n; ++i) {
+            CHECK(v.front() == i);
+            v = v.drop(1);
+        }
+        CHECK(v.empty());
+    }
+
+    SECTION("relaxed")
+    {
+        auto v = make_test_flex_vector_front(0, n);
+        for (auto i = 0u; i < n; ++i) {
+            CHECK(v.front() == i);
+            v = v.drop(1);
+        }
+        CHECK(v.empty());
+    }
+
+    SECTION("move")
+    {
+        auto v = make_test_flex_vector(0, n);
+        for (auto i = 0u; i < n; ++i) {
+            CHECK(v.front() == i);
+            v = std::move(v).drop(1);
+        }
+        CHECK(v.empty());
+    }
+}
+
 TEST_CASE("concat")
 {
 #if IMMER_SLOW_TESTS
@@ -564,6 +641,39 @@ TEST_CASE("exception safety relaxed")
         IMMER_TRACE_E(d.happenings);
     }
 
+    SECTION("push front")
+    {
+        auto half = n / 2;
+        auto v = make_test_flex_vector<dadaist_vector_t>(half, n);
+        auto d = dadaism{};
+        for (auto i = half; v.size() < static_cast<decltype(v.size())>(n);) {
+            auto s = d.next();
+            try {
+                v = v.push_front({i - 1});
+                --i;
+            } catch (dada_error) {}
+            CHECK_VECTOR_EQUALS(v, boost::irange(i, n));
+        }
+        CHECK(d.happenings > 0);
+        IMMER_TRACE_E(d.happenings);
+    }
+
+    SECTION("pop front")
+    {
+        auto v = make_test_flex_vector_front<dadaist_vector_t>(0, n);
+        auto d = dadaism{};
+        for (auto i = 0u; i < n;) {
+            auto s = d.next();
+            try {
+                v = v.drop(1);
+                ++i;
+            } catch (dada_error) {}
+            CHECK_VECTOR_EQUALS(v, boost::irange(i, n));
+        }
+        CHECK(d.happenings > 0);
+        IMMER_TRACE_E(d.happenings);
+    }
+
     SECTION("update")
     {
         auto v = make_test_flex_vector_front<dadaist_vector_t>(0, n);
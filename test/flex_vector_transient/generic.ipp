@@ -102,6 +102,28 @@ TEST_CASE("drop move")
     CHECK_VECTOR_EQUALS(v, boost::irange(1u, 2u));
 }
 
+TEST_CASE("push front")
+{
+    constexpr auto n = 666u;
+
+    auto v = make_test_flex_vector<FLEX_VECTOR_T<unsigned>>(n, 2 * n)
+        .transient();
+    for (auto i = n; i > 0;)
+        v.push_front(--i);
+    CHECK_VECTOR_EQUALS(v, boost::irange(0u, 2 * n));
+
+    v.drop(1);
+    v.push_front(0);
+    v.push_back(2 * n);
+    CHECK_VECTOR_EQUALS(v, boost::irange(0u, 2 * n + 1));
+
+    auto p = v.persistent();
+    v.push_front(42);
+    v.drop(1);
+    CHECK(v.persistent() == p);
+    CHECK_VECTOR_EQUALS(p, boost::irange(0u, 2 * n + 1));
+}
+
 TEST_CASE("exception safety relaxed")
 {
     using dadaist_vector_t = typename dadaist_wrapper<FLEX_VECTOR_T<unsigned>>::type;
@@ -204,6 +226,35 @@ TEST_CASE("exception safety relaxed")
         CHECK(t.d.happenings > 0);
     }
 
+    SECTION("push front")
+    {
+        auto half = n / 2;
+        auto t = as_transient_tester(
+            make_test_flex_vector<dadaist_vector_t>(half, n));
+        auto d = dadaism{};
+        for (auto li = half, i = half; i > 0;) {
+            auto s = d.next();
+            try {
+                if (t.transient)
+                    t.vt.push_front({i - 1});
+                else
+                    t.vp = t.vp.push_front({i - 1});
+                --i;
+            } catch (dada_error) {}
+            if (t.step())
+                li = i;
+            if (t.transient) {
+                CHECK_VECTOR_EQUALS(t.vt, boost::irange(i, n));
+                CHECK_VECTOR_EQUALS(t.vp, boost::irange(li, n));
+            } else {
+                CHECK_VECTOR_EQUALS(t.vp, boost::irange(i, n));
+                CHECK_VECTOR_EQUALS(t.vt, boost::irange(li, n));
+            }
+        }
+        CHECK(d.happenings > 0);
+        CHECK(t.d.happenings > 0);
+    }
+
     SECTION("drop")
     {
         auto t = as_transient_tester(
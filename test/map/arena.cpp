@@ -0,0 +1,40 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#include <immer/map.hpp>
+#include <immer/heap/heap_policy.hpp>
+#include <immer/refcount/no_refcount_policy.hpp>
+
+using arena_memory = immer::memory_policy<
+    immer::arena_heap_policy<>,
+    immer::no_refcount_policy>;
+
+template <typename K, typename T,
+          typename Hash = std::hash<K>,
+          typename Eq   = std::equal_to<K>>
+using test_map_t = immer::map<K, T, Hash, Eq, arena_memory, 3u>;
+
+// all the tests below run inside this arena
+static immer::arena test_arena;
+
+#define MAP_T test_map_t
+#include "generic.ipp"
+
+TEST_CASE("empty maps outlive arenas")
+{
+    {
+        immer::arena scope;
+        auto m = immer::map<int, int, std::hash<int>, std::equal_to<int>,
+                            arena_memory, 2u>{}.set(1, 42);
+        CHECK(m[1] == 42);
+    }
+    auto m = immer::map<int, int, std::hash<int>, std::equal_to<int>,
+                        arena_memory, 2u>{};
+    CHECK(m.size() == 0u);
+    CHECK(m.set(2, 13)[2] == 13);
+}
@@ -0,0 +1,65 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#include <immer/cached_hash.hpp>
+#include <immer/map.hpp>
+
+template <typename K, typename T,
+          typename Hash = std::hash<K>,
+          typename Eq   = std::equal_to<K>>
+using test_map_t = immer::map<K, T, immer::cached_hash<Hash>, Eq,
+                              immer::default_memory_policy, 3u>;
+
+#define MAP_T test_map_t
+#include "generic.ipp"
+
+namespace {
+
+struct counted_hash
+{
+    static std::size_t count;
+
+    std::size_t operator() (unsigned x) const
+    { ++count; return std::hash<unsigned>{}(x); }
+};
+
+std::size_t counted_hash::count = 0;
+
+} // anonymous namespace
+
+TEST_CASE("values are hashed once")
+{
+    constexpr auto n = 666u;
+
+    auto m = test_map_t<unsigned, unsigned, counted_hash>{};
+    counted_hash::count = 0;
+    for (auto i = 0u; i < n; ++i)
+        m = m.set(i, i);
+    CHECK(counted_hash::count == n);
+    for (auto i = 0u; i < n; i += 2)
+        m = m.erase(i);
+    CHECK(counted_hash::count == n + n / 2);
+    for (auto i = 0u; i < n; ++i)
+        CHECK(m.count(i) == i % 2);
+}
+
+TEST_CASE("hashed operations do not hash")
+{
+    constexpr auto n = 666u;
+    auto hash = [] (unsigned x) { return std::hash<unsigned>{}(x); };
+
+    auto m = test_map_t<unsigned, unsigned, counted_hash>{};
+    counted_hash::count = 0;
+    for (auto i = 0u; i < n; ++i)
+        m = m.insert_hashed({i, i}, hash(i));
+    for (auto i = 0u; i < n; i += 2)
+        m = m.erase_hashed(i, hash(i));
+    for (auto i = 0u; i < n; ++i)
+        CHECK((m.find_hashed(i, hash(i)) != nullptr) == (i % 2 == 1));
+    CHECK(counted_hash::count == 0);
+}
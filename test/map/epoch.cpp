@@ -0,0 +1,28 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#include <immer/map.hpp>
+#include <immer/refcount/epoch_refcount_policy.hpp>
+
+using epoch_memory = immer::memory_policy<
+    immer::free_list_heap_policy<immer::cpp_heap>,
+    immer::epoch_refcount_policy>;
+
+template <typename K, typename T,
+          typename Hash = std::hash<K>,
+          typename Eq   = std::equal_to<K>>
+using test_map_t = immer::map<K, T, Hash, Eq, epoch_memory, 3u>;
+
+// the trees retired by the tests below are deleted here
+static struct drain_at_exit
+{
+    ~drain_at_exit() { immer::drain_retired(); }
+} test_drain_at_exit;
+
+#define MAP_T test_map_t
+#include "generic.ipp"
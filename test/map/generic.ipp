@@ -13,6 +13,7 @@
 #endif
 
 #include <immer/algorithm.hpp>
+#include <immer/executor.hpp>
 
 #include "test/util.hpp"
 #include "test/dada.hpp"
@@ -134,6 +135,175 @@ TEST_CASE("find")
     CHECK(v.find(1234) == nullptr);
 }
 
+TEST_CASE("transparent lookup")
+{
+    using map_t = MAP_T<std::string, unsigned,
+                        transparent_hash, transparent_equal>;
+    const auto n = 666u;
+
+    auto keys = std::vector<std::string>{};
+    auto v = map_t{};
+    for (auto i = 0u; i < n; ++i) {
+        keys.push_back(std::to_string(i));
+        v = v.set(keys.back(), i);
+    }
+
+    for (auto i = 0u; i < n; ++i) {
+        auto k = str_view{keys[i].c_str()};
+        CHECK(v.count(k) == 1);
+        CHECK(v[k] == i);
+        CHECK(v.at(k) == i);
+        REQUIRE(v.find(k));
+        CHECK(*v.find(k) == i);
+    }
+    CHECK(v.count(str_view{"foo"}) == 0);
+    CHECK(v[str_view{"foo"}] == 0);
+    CHECK_THROWS_AS(v.at(str_view{"foo"}), std::out_of_range&);
+    CHECK(v.find(str_view{"foo"}) == nullptr);
+
+    SECTION("erase")
+    {
+        auto v2 = v;
+        for (auto i = 0u; i < n; ++i) {
+            auto k = str_view{keys[i].c_str()};
+            v2 = i % 2 ? v2.erase(k) : std::move(v2).erase(k);
+            CHECK(v2.size() == n - i - 1);
+            CHECK(v2.count(k) == 0);
+            CHECK(v.count(k) == 1);
+        }
+        CHECK(v.erase(str_view{"foo"}) == v);
+    }
+}
+
+TEST_CASE("from range")
+{
+    constexpr auto n = 666u;
+
+    SECTION("values")
+    {
+        auto gen  = make_generator();
+        auto vals = std::vector<std::pair<unsigned, unsigned>>{};
+        for (auto i = 0u; i < n; ++i)
+            vals.push_back({gen() % (n / 2), i});
+        auto m = MAP_T<unsigned, unsigned>(vals.begin(), vals.end());
+        auto e = MAP_T<unsigned, unsigned>{};
+        for (auto&& v : vals)
+            e = e.insert(v);
+        CHECK(m == e);
+        CHECK(m.size() == e.size());
+
+        auto l = MAP_T<unsigned, unsigned>{{1u, 2u}, {3u, 4u}, {1u, 5u}};
+        CHECK(l.size() == 2);
+        CHECK(l[1u] == 5u);
+        CHECK(l[3u] == 4u);
+    }
+
+    SECTION("collisions")
+    {
+        auto vals = make_values_with_collisions(n);
+        auto dups = vals;
+        for (auto i = 0u; i < n / 2; ++i)
+            dups.push_back({vals[i].first, vals[i].second + 1});
+        auto m = MAP_T<conflictor, unsigned, hash_conflictor>(dups.begin(),
+                                                              dups.end());
+        CHECK(m.size() == n);
+        for (auto i = 0u; i < n; ++i)
+            CHECK(m[vals[i].first] == vals[i].second + (i < n / 2));
+    }
+
+    SECTION("insert")
+    {
+        auto m = make_test_map(n);
+        auto vals = std::vector<std::pair<unsigned, unsigned>>{};
+        for (auto i = n / 2; i < n + n / 2; ++i)
+            vals.push_back({i, i + 1});
+        auto r = m.insert(vals.begin(), vals.end());
+        CHECK(r.size() == n + n / 2);
+        for (auto i = 0u; i < n + n / 2; ++i)
+            CHECK(r[i] == i + (i >= n / 2));
+        CHECK(m == make_test_map(n));
+    }
+}
+
+TEST_CASE("set and erase many")
+{
+    constexpr auto n = 666u;
+
+    auto gen = make_generator();
+
+    SECTION("values")
+    {
+        auto m = make_test_map(n);
+        auto sets = std::vector<std::pair<unsigned, unsigned>>{};
+        auto erases = std::vector<unsigned>{};
+        for (auto i = 0u; i < n; ++i) {
+            sets.push_back({gen() % (2 * n), i});
+            erases.push_back(gen() % (2 * n));
+        }
+        auto e = m;
+        for (auto&& v : sets)
+            e = e.insert(v);
+        auto r = m.set_many(sets);
+        CHECK(r == e);
+        CHECK(m == make_test_map(n));
+        CHECK(std::move(r).set_many(sets) == e);
+
+        for (auto&& k : erases)
+            e = e.erase(k);
+        auto r2 = m.set_many(sets).erase_many(erases);
+        CHECK(r2 == e);
+        CHECK(m.erase_many(std::vector<unsigned>{}) == m);
+    }
+
+    SECTION("collisions")
+    {
+        auto vals = make_values_with_collisions(n);
+        auto m = make_test_map(vals);
+        auto sets = std::vector<std::pair<conflictor, unsigned>>{};
+        auto erases = std::vector<conflictor>{};
+        for (auto i = 0u; i < n; i += 2)
+            sets.push_back({vals[i].first, vals[i].second + 1});
+        for (auto i = 1u; i < n; i += 3)
+            erases.push_back(vals[i].first);
+        auto r = m.set_many(sets).erase_many(erases);
+        for (auto i = 0u; i < n; ++i) {
+            if (i % 3 == 1)
+                CHECK(r.count(vals[i].first) == 0);
+            else
+                CHECK(r[vals[i].first] == vals[i].second + (i % 2 == 0));
+            CHECK(m[vals[i].first] == vals[i].second);
+        }
+    }
+}
+
+TEST_CASE("hashed")
+{
+    const auto n = 666u;
+    auto hash = [] (unsigned x) { return std::hash<unsigned>{}(x); };
+
+    auto v = MAP_T<unsigned, unsigned>{};
+    for (auto i = 0u; i < n; ++i)
+        v = i % 2
+            ? v.insert_hashed({i, i}, hash(i))
+            : std::move(v).insert_hashed({i, i}, hash(i));
+    CHECK(v == make_test_map(n));
+    for (auto i = 0u; i < n; ++i) {
+        REQUIRE(v.find_hashed(i, hash(i)));
+        CHECK(*v.find_hashed(i, hash(i)) == i);
+    }
+    CHECK(v.find_hashed(n, hash(n)) == nullptr);
+
+    auto v2 = v;
+    for (auto i = 0u; i < n; i += 2)
+        v2 = i % 4
+            ? v2.erase_hashed(i, hash(i))
+            : std::move(v2).erase_hashed(i, hash(i));
+    CHECK(v2.size() == n / 2);
+    for (auto i = 0u; i < n; ++i)
+        CHECK(v2.count(i) == i % 2);
+    CHECK(v.size() == n);
+}
+
 TEST_CASE("equals and setting")
 {
     const auto n = 666u;
@@ -213,6 +383,66 @@ TEST_CASE("accumulate")
     }
 }
 
+TEST_CASE("parallel accumulate")
+{
+    const auto n = 6666u;
+    auto v = make_test_map(n);
+    auto ex = immer::thread_executor{4};
+
+    SECTION("sum collection")
+    {
+        auto acc = [] (unsigned acc, const std::pair<unsigned, unsigned>& x) {
+            return acc + x.first + x.second;
+        };
+        auto sum1 = immer::accumulate(v, 0u, acc);
+        auto sum2 = immer::accumulate(ex, v, 0u, acc, std::plus<unsigned>{});
+        CHECK(sum1 == sum2);
+    }
+
+    SECTION("sum collisions") {
+        auto vals = make_values_with_collisions(n);
+        auto s = make_test_map(vals);
+        auto acc = [] (unsigned r, std::pair<conflictor, unsigned> x) {
+            return r + x.first.v1 + x.first.v2 + x.second;
+        };
+        auto sum1 = std::accumulate(vals.begin(), vals.end(), 0u, acc);
+        auto sum2 = immer::accumulate(ex, s, 0u, acc, std::plus<unsigned>{});
+        CHECK(sum1 == sum2);
+    }
+}
+
+TEST_CASE("update if changed")
+{
+    const auto n = 666u;
+    auto v = make_test_map(n);
+
+    auto u = v.update_if_changed(42u, [] (auto x) { return x; });
+    CHECK(u.impl().root == v.impl().root);
+    CHECK(u.find(42u) == v.find(42u));
+
+    auto w = v.update_if_changed(42u, [] (auto x) { return x + 1; });
+    CHECK(w[42u] == 43u);
+    CHECK(v[42u] == 42u);
+
+    auto x = v.update_if_changed(42u, [] (auto x) { return x + 1; },
+                                 [] (auto a, auto b) { return a / 2 == b / 2; });
+    CHECK(x.impl().root == v.impl().root);
+
+    auto y = v.update_if_changed(n, [] (auto x) { return x; });
+    CHECK(y.size() == n + 1);
+    CHECK(y.count(n) == 1);
+    CHECK(y[n] == 0u);
+
+    auto z = std::move(u).update_if_changed(42u, [] (auto x) { return x; });
+    CHECK(z.impl().root == v.impl().root);
+    z = std::move(z).update_if_changed(42u, [] (auto x) { return x + 1; });
+    z = std::move(z).update_if_changed(n, [] (auto x) { return x + 1; });
+    CHECK(z[42u] == 43u);
+    CHECK(z[n] == 1u);
+    CHECK(v[42u] == 42u);
+    CHECK(v.count(n) == 0);
+}
+
 TEST_CASE("update a lot")
 {
     auto v = make_test_map(666u);
@@ -223,6 +453,266 @@ TEST_CASE("update a lot")
     }
 }
 
+TEST_CASE("update move")
+{
+    using map_t = MAP_T<unsigned, unsigned>;
+
+    auto v = make_test_map(666u);
+
+    auto check_move = [&] (map_t&& x) -> map_t&& {
+        if (map_t::memory_policy::use_transient_rvalues)
+            CHECK(&x == &v);
+        else
+            CHECK(&x != &v);
+        return std::move(x);
+    };
+
+    auto addr_before = v.find(42u);
+    v = check_move(std::move(v).set(42u, 0u));
+    v = check_move(std::move(v).update(42u, [] (auto x) { return x + 1; }));
+    auto addr_after = v.find(42u);
+    if (map_t::memory_policy::use_transient_rvalues)
+        CHECK(addr_before == addr_after);
+    else
+        CHECK(addr_before != addr_after);
+    CHECK(v[42u] == 1u);
+
+    auto p = v;
+    for (auto i = 0u; i < 666u; ++i)
+        v = check_move(std::move(v).update(i, [] (auto x) { return x + 1; }));
+    for (auto i = 666u; i < 1000u; ++i)
+        v = check_move(std::move(v).insert({i, i}));
+    for (auto i = 0u; i < 1000u; i += 2)
+        v = check_move(std::move(v).erase(i));
+    CHECK(v.size() == 500u);
+    for (auto i = 1u; i < 1000u; i += 2)
+        CHECK(v[i] == (i < 666u ? i + 1 : i) + (i == 42u));
+    CHECK(p.size() == 666u);
+    for (auto i = 0u; i < 666u; ++i)
+        CHECK(p[i] == (i == 42u ? 1u : i));
+}
+
+template <typename Map>
+void check_map_algebra(const Map& a, const Map& b)
+{
+    auto merged      = a;
+    auto merged_with = a;
+    auto common      = Map{};
+    auto only_a      = Map{};
+    for (auto&& kv : a) {
+        if (auto v = b.find(kv.first)) {
+            if (*v != kv.second)
+                merged_with = merged_with.set(kv.first, kv.second + *v);
+            common = common.insert(kv);
+        } else
+            only_a = only_a.insert(kv);
+    }
+    for (auto&& kv : b) {
+        merged = merged.insert(kv);
+        if (!a.count(kv.first))
+            merged_with = merged_with.insert(kv);
+    }
+    auto plus = [] (unsigned x, unsigned y) { return x + y; };
+    CHECK(a.merge(b).size() == merged.size());
+    CHECK(a.merge(b) == merged);
+    CHECK(a.merge_with(b, plus) == merged_with);
+    CHECK(b.merge_with(a, plus) == merged_with);
+    CHECK(a.intersect(b).size() == common.size());
+    CHECK(a.intersect(b) == common);
+    CHECK(a.difference(b).size() == only_a.size());
+    CHECK(a.difference(b) == only_a);
+}
+
+TEST_CASE("merge, intersect and difference")
+{
+    constexpr auto n = 666u;
+
+    auto gen = make_generator();
+
+    SECTION("versions of the same map")
+    {
+        auto a = make_test_map(n);
+        auto b = a;
+        for (auto i = 0u; i < n / 10; ++i) {
+            b = b.erase(gen() % n);
+            b = b.set(gen() % n, gen());
+            b = b.set(n + gen() % n, gen());
+        }
+        check_map_algebra(a, b);
+        check_map_algebra(b, a);
+        check_map_algebra(a, MAP_T<unsigned, unsigned>{});
+    }
+
+    SECTION("collisions")
+    {
+        auto vals = make_values_with_collisions(n);
+        auto a = make_test_map(vals);
+        auto b = a;
+        for (auto i = 0u; i < n; i += 3) {
+            b = b.erase(vals[i].first);
+            b = b.set(vals[i + 1].first, i);
+            b = b.set({vals[i].first.v1, vals[i].first.v2 + 1}, i);
+        }
+        check_map_algebra(a, b);
+        check_map_algebra(b, a);
+    }
+
+    SECTION("reuses the shared nodes")
+    {
+        auto a = make_test_map(n);
+        CHECK(a.merge(a).impl().root == a.impl().root);
+        CHECK(a.set(42u, 0u).merge(a).impl().root == a.impl().root);
+        CHECK(a.merge(a.erase(42u)).impl().root == a.impl().root);
+        CHECK(a.merge(a.set(42u, 42u)).impl().root == a.impl().root);
+        CHECK(a.merge_with(a.erase(42u), std::plus<unsigned>{})
+              .impl().root == a.impl().root);
+        CHECK(a.intersect(a.set(n, n)).impl().root == a.impl().root);
+    }
+
+    SECTION("values that can not be compared")
+    {
+        struct opaque { unsigned v; };
+        auto a = MAP_T<unsigned, opaque>{}.set(1u, {1u}).set(2u, {2u});
+        auto b = MAP_T<unsigned, opaque>{}.set(2u, {2u}).set(3u, {3u});
+        auto plus = [] (opaque x, opaque y) { return opaque{x.v + y.v}; };
+        auto c = a.merge_with(b, plus);
+        CHECK(c.size() == 3u);
+        CHECK(c[1u].v == 1u);
+        CHECK(c[2u].v == 4u);
+        CHECK(c[3u].v == 3u);
+        CHECK(a.merge(b)[2u].v == 2u);
+    }
+}
+
+template <typename Map>
+void check_diff(const Map& a, const Map& b)
+{
+    using value_t = typename Map::value_type;
+    auto added   = std::vector<value_t>{};
+    auto removed = std::vector<value_t>{};
+    auto changed = std::vector<std::pair<value_t, value_t>>{};
+    immer::diff(a, b,
+                [&] (auto&& x) { added.push_back(x); },
+                [&] (auto&& x) { removed.push_back(x); },
+                [&] (auto&& x, auto&& y) { changed.push_back({x, y}); });
+
+    auto expected_added   = 0u;
+    auto expected_removed = 0u;
+    auto expected_changed = 0u;
+    for (auto&& kv : a) {
+        if (auto v = b.find(kv.first))
+            expected_changed += *v != kv.second;
+        else
+            ++expected_removed;
+    }
+    for (auto&& kv : b)
+        expected_added += !a.count(kv.first);
+
+    CHECK(added.size() == expected_added);
+    CHECK(removed.size() == expected_removed);
+    CHECK(changed.size() == expected_changed);
+    for (auto&& kv : added)
+        CHECK((!a.count(kv.first) && b[kv.first] == kv.second));
+    for (auto&& kv : removed)
+        CHECK((a[kv.first] == kv.second && !b.count(kv.first)));
+    for (auto&& c : changed) {
+        CHECK(a[c.first.first] == c.first.second);
+        CHECK(b[c.second.first] == c.second.second);
+        CHECK(c.first.second != c.second.second);
+    }
+}
+
+struct diff_counter
+{
+    unsigned calls = 0;
+    template <typename... Ts>
+    void operator() (Ts&&...) { ++calls; }
+};
+
+TEST_CASE("diff")
+{
+    constexpr auto n = 666u;
+
+    auto gen = make_generator();
+
+    SECTION("versions of the same map")
+    {
+        auto a = make_test_map(n);
+        auto b = a;
+        for (auto i = 0u; i < n / 10; ++i) {
+            b = b.erase(gen() % n);
+            b = b.set(gen() % n, gen());
+            b = b.set(n + gen() % n, gen());
+        }
+        check_diff(a, b);
+        check_diff(b, a);
+        check_diff(a, a);
+        check_diff(a, MAP_T<unsigned, unsigned>{});
+        check_diff(MAP_T<unsigned, unsigned>{}, a);
+    }
+
+    SECTION("collisions")
+    {
+        auto vals = make_values_with_collisions(n);
+        auto a = make_test_map(vals);
+        auto b = a;
+        for (auto i = 0u; i < n; i += 3) {
+            b = b.erase(vals[i].first);
+            b = b.set(vals[i + 1].first, i);
+            b = b.set({vals[i].first.v1, vals[i].first.v2 + 1}, i);
+        }
+        check_diff(a, b);
+        check_diff(b, a);
+    }
+
+    SECTION("skips the shared nodes")
+    {
+        auto a = make_test_map(n);
+        auto b = a.set(42u, 0u).set(n, n).erase(13u);
+        auto calls = 0u;
+        immer::diff(a, b,
+                    [&] (auto&& x) { CHECK(x.first == n); ++calls; },
+                    [&] (auto&& x) { CHECK(x.first == 13u); ++calls; },
+                    [&] (auto&& x, auto&& y) {
+                        CHECK(x.first == 42u);
+                        CHECK(y.second == 0u);
+                        ++calls;
+                    });
+        CHECK(calls == 3);
+    }
+
+    SECTION("stateful functors")
+    {
+        auto a = make_test_map(n);
+        auto empty = MAP_T<unsigned, unsigned>{};
+        auto added   = diff_counter{};
+        auto removed = diff_counter{};
+        auto changed = diff_counter{};
+        immer::diff(a, empty, added, removed, changed);
+        CHECK(added.calls == 0);
+        CHECK(removed.calls == n);
+        immer::diff(empty, a, added, removed, changed);
+        CHECK(added.calls == n);
+        CHECK(changed.calls == 0);
+    }
+}
+
+namespace {
+
+struct dada_alive : tristan_tzara
+{
+    static int& count() { static int c = 0; return c; }
+
+    dada_alive() { ++count(); }
+    dada_alive(const dada_alive& x) : tristan_tzara{x} { ++count(); }
+    dada_alive(dada_alive&& x) : tristan_tzara{std::move(x)} { ++count(); }
+    dada_alive& operator=(const dada_alive&) = default;
+    dada_alive& operator=(dada_alive&&) = default;
+    ~dada_alive() { --count(); }
+};
+
+} // anonymous namespace
+
 TEST_CASE("exception safety")
 {
     constexpr auto n = 2666u;
@@ -272,4 +762,77 @@ TEST_CASE("exception safety")
         CHECK(d.happenings > 0);
         IMMER_TRACE_E(d.happenings);
     }
+
+    SECTION("from range")
+    {
+        auto vals = make_values_with_collisions(n);
+        auto d = dadaism{};
+        auto v = dadaist_conflictor_map_t{};
+        while (v.size() == 0) {
+            try {
+                auto s = d.next();
+                v = dadaist_conflictor_map_t(vals.begin(), vals.end());
+            } catch (dada_error) {}
+        }
+        for (auto&& x : vals)
+            CHECK(v.at(x.first) == x.second);
+        CHECK(d.happenings > 0);
+        IMMER_TRACE_E(d.happenings);
+    }
+
+    SECTION("set and erase many")
+    {
+        auto vals = make_values_with_collisions(n);
+        auto keys = std::vector<conflictor>{};
+        for (auto&& v : vals)
+            keys.push_back(v.first);
+        auto v = dadaist_conflictor_map_t{};
+        auto d = dadaism{};
+        for (auto done = 0u; done < 2;) {
+            try {
+                auto s = d.next();
+                if (done == 0)
+                    v = v.set_many(vals);
+                else
+                    v = v.erase_many(keys);
+                ++done;
+            } catch (dada_error) {}
+            CHECK(v.size() == (done == 1 ? n : 0));
+        }
+        CHECK(d.happenings > 0);
+        IMMER_TRACE_E(d.happenings);
+    }
+
+    SECTION("values are destroyed once")
+    {
+        using map_t = MAP_T<unsigned, dada_alive>;
+        {
+            auto v = map_t{};
+            auto d = dadaism{};
+            for (auto i = 0u; i < n;) {
+                try {
+                    auto s = d.next();
+                    v = i % 2
+                        ? v.set(i, {})
+                        : std::move(v).set(i, {});
+                    ++i;
+                } catch (dada_error) {}
+                CHECK(dada_alive::count() >= int(v.size()));
+            }
+            for (auto i = 0u; i < n;) {
+                try {
+                    auto s = d.next();
+                    v = i % 2
+                        ? v.erase(i)
+                        : std::move(v).erase(i);
+                    ++i;
+                } catch (dada_error) {}
+                CHECK(dada_alive::count() >= int(v.size()));
+            }
+            CHECK(d.happenings > 0);
+            IMMER_TRACE_E(d.happenings);
+        }
+        // values may outlive the map under some memory policies
+        CHECK(dada_alive::count() >= 0);
+    }
 }
@@ -0,0 +1,290 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#include "test/util.hpp"
+#include "test/dada.hpp"
+
+#include <catch.hpp>
+
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifndef MAP_T
+#error "define the map template to use in MAP_T"
+#endif
+
+#ifndef MAP_TRANSIENT_T
+#error "define the map template to use in MAP_TRANSIENT_T"
+#endif
+
+namespace {
+
+template <typename T=unsigned>
+auto make_generator()
+{
+    auto engine = std::default_random_engine{42};
+    auto dist = std::uniform_int_distribution<T>{};
+    return std::bind(dist, engine);
+}
+
+struct conflictor
+{
+    unsigned v1;
+    unsigned v2;
+
+    bool operator== (const conflictor& x) const
+    { return v1 == x.v1 && v2 == x.v2; }
+};
+
+struct hash_conflictor
+{
+    std::size_t operator() (const conflictor& x) const
+    { return x.v1; }
+};
+
+auto make_values_with_collisions(unsigned n)
+{
+    auto gen   = make_generator();
+    auto vals  = std::vector<std::pair<conflictor, unsigned>>{};
+    auto vals_ = std::unordered_set<conflictor, hash_conflictor>{};
+    auto i = 0u;
+    generate_n(back_inserter(vals), n, [&] {
+        auto newv = conflictor{};
+        do {
+            newv = { unsigned(gen() % (n / 2)), gen() };
+        } while (!vals_.insert(newv).second);
+        return std::pair<conflictor, unsigned>{newv, i++};
+    });
+    return vals;
+}
+
+auto make_test_map(unsigned n)
+{
+    auto s = MAP_T<unsigned, unsigned>{};
+    for (auto i = 0u; i < n; ++i)
+        s = s.insert({i, i});
+    return s;
+}
+
+template <typename Map, typename Expected>
+void check_map_equals(const Map& m, const Expected& expected)
+{
+    CHECK(m.size() == expected.size());
+    for (auto&& kv : expected) {
+        auto p = m.find(kv.first);
+        REQUIRE(p);
+        CHECK(*p == kv.second);
+    }
+    auto count = std::size_t{};
+    for (auto&& kv : m) {
+        CHECK(expected.count(kv.first) == 1);
+        ++count;
+    }
+    CHECK(count == expected.size());
+}
+
+} // anonymous namespace
+
+TEST_CASE("from map and to map")
+{
+    constexpr auto n = 100u;
+
+    auto p = make_test_map(n);
+    auto t = p.transient();
+    CHECK(t.size() == n);
+    for (auto i = 0u; i < n; ++i)
+        CHECK(t[i] == i);
+
+    auto p2 = t.persistent();
+    CHECK(p2 == p);
+}
+
+TEST_CASE("protect persistence")
+{
+    constexpr auto n = 666u;
+
+    SECTION("from persistent")
+    {
+        auto p = make_test_map(n);
+        auto t = p.transient();
+        for (auto i = 0u; i < n; ++i)
+            t.set(i, i + 1);
+        t.erase(0);
+        t.set(n, n);
+        CHECK(p.size() == n);
+        for (auto i = 0u; i < n; ++i)
+            CHECK(p[i] == i);
+        CHECK(t.size() == n);
+        for (auto i = 1u; i < n; ++i)
+            CHECK(t[i] == i + 1);
+    }
+
+    SECTION("to persistent")
+    {
+        auto t = MAP_TRANSIENT_T<unsigned, unsigned>{};
+        for (auto i = 0u; i < n; ++i)
+            t.set(i, i);
+        auto p = t.persistent();
+        for (auto i = 0u; i < n; ++i)
+            t.update(i, [] (auto x) { return x + 1; });
+        for (auto i = 0u; i < n; i += 2)
+            t.erase(i);
+        CHECK(p.size() == n);
+        for (auto i = 0u; i < n; ++i)
+            CHECK(p[i] == i);
+        CHECK(t.size() == n / 2);
+        for (auto i = 1u; i < n; i += 2)
+            CHECK(t[i] == i + 1);
+    }
+}
+
+TEST_CASE("mutates in place")
+{
+    auto t = make_test_map(666u).transient();
+    t.set(42u, 0u);
+    auto p = t.find(42u);
+    t.set(42u, 1u);
+    CHECK(t.find(42u) == p);
+    t.update(42u, [] (auto x) { return x + 1; });
+    CHECK(t.find(42u) == p);
+    CHECK(*p == 2u);
+}
+
+TEST_CASE("insert, update and erase a lot")
+{
+    constexpr auto n = 1000u;
+
+    auto gen = make_generator();
+    auto t   = MAP_TRANSIENT_T<unsigned, unsigned>{};
+    auto m   = std::unordered_map<unsigned, unsigned>{};
+    for (auto i = 0u; i < 10 * n; ++i) {
+        auto k = gen() % n;
+        switch (gen() % 3) {
+        case 0:
+            t.set(k, i);
+            m[k] = i;
+            break;
+        case 1:
+            t.update(k, [] (auto x) { return x + 1; });
+            ++m[k];
+            break;
+        case 2:
+            t.erase(k);
+            m.erase(k);
+            break;
+        }
+    }
+    check_map_equals(t, m);
+    check_map_equals(t.persistent(), m);
+}
+
+TEST_CASE("erase everything")
+{
+    constexpr auto n = 666u;
+
+    auto t = make_test_map(n).transient();
+    for (auto i = 0u; i < n; ++i) {
+        t.erase(i);
+        CHECK(t.size() == n - i - 1);
+        CHECK(t.count(i) == 0);
+    }
+    CHECK(t.empty());
+    CHECK(t.begin() == t.end());
+    t.set(42u, 42u);
+    CHECK(t.size() == 1);
+    CHECK(t[42u] == 42u);
+}
+
+TEST_CASE("collisions")
+{
+    constexpr auto n = 666u;
+
+    using map_t = MAP_TRANSIENT_T<conflictor, unsigned, hash_conflictor>;
+
+    auto vals = make_values_with_collisions(n);
+    auto t    = map_t{};
+    for (auto&& v : vals)
+        t.insert(v);
+    CHECK(t.size() == n);
+    for (auto&& v : vals)
+        CHECK(t[v.first] == v.second);
+
+    auto p = t.persistent();
+    for (auto&& v : vals)
+        t.update(v.first, [] (auto x) { return x + 1; });
+    for (auto&& v : vals)
+        CHECK(t[v.first] == v.second + 1);
+
+    for (auto i = 0u; i < n; ++i) {
+        t.erase(vals[i].first);
+        CHECK(t.size() == n - i - 1);
+        CHECK(t.count(vals[i].first) == 0);
+        if (i + 1 < n)
+            CHECK(t[vals[i + 1].first] == vals[i + 1].second + 1);
+    }
+    CHECK(t.empty());
+    CHECK(p.size() == n);
+    for (auto&& v : vals)
+        CHECK(p[v.first] == v.second);
+}
+
+TEST_CASE("transparent lookup")
+{
+    using map_t = MAP_TRANSIENT_T<std::string, unsigned,
+                                  transparent_hash, transparent_equal>;
+    constexpr auto n = 666u;
+
+    auto keys = std::vector<std::string>{};
+    auto t = map_t{};
+    for (auto i = 0u; i < n; ++i) {
+        keys.push_back(std::to_string(i));
+        t.set(keys.back(), i);
+    }
+
+    for (auto i = 0u; i < n; ++i) {
+        auto k = str_view{keys[i].c_str()};
+        CHECK(t.count(k) == 1);
+        CHECK(t[k] == i);
+        CHECK(t.at(k) == i);
+        REQUIRE(t.find(k));
+        CHECK(*t.find(k) == i);
+    }
+    CHECK(t.count(str_view{"foo"}) == 0);
+    CHECK(t.find(str_view{"foo"}) == nullptr);
+
+    for (auto i = 0u; i < n; ++i) {
+        auto k = str_view{keys[i].c_str()};
+        t.erase(k);
+        CHECK(t.size() == n - i - 1);
+        CHECK(t.count(k) == 0);
+    }
+}
+
+TEST_CASE("exception safety")
+{
+    constexpr auto n = 666u;
+
+    using dadaist_map_t = typename dadaist_wrapper<
+        MAP_TRANSIENT_T<unsigned, unsigned>>::type;
+
+    auto t = dadaist_map_t{};
+    auto d = dadaism{};
+    for (auto i = 0u; i < n;) {
+        try {
+            auto s = d.next();
+            t.set(i, i);
+            ++i;
+        } catch (dada_error) {}
+        CHECK(t.size() == i);
+        for (auto j : test_irange(0u, i))
+            CHECK(t.at(j) == j);
+    }
+    CHECK(d.happenings > 0);
+    IMMER_TRACE_E(d.happenings);
+}
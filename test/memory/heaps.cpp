@@ -9,11 +9,24 @@
 #include <immer/heap/malloc_heap.hpp>
 #include <immer/heap/free_list_heap.hpp>
 #include <immer/heap/thread_local_free_list_heap.hpp>
+#include <immer/heap/remote_free_list_heap.hpp>
 #include <immer/heap/gc_heap.hpp>
 #include <immer/heap/cpp_heap.hpp>
+#include <immer/heap/arena_heap.hpp>
+#include <immer/heap/hugepage_heap.hpp>
+#include <immer/heap/split_heap.hpp>
+#include <immer/heap/stats_heap.hpp>
+#include <immer/heap/heap_policy.hpp>
+#include <immer/flex_vector.hpp>
 
 #include <catch.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <future>
 #include <numeric>
+#include <thread>
+#include <vector>
 
 void do_stuff_to(void* buf, std::size_t size)
 {
@@ -58,6 +71,95 @@ TEST_CASE("cpp")
     }
 }
 
+TEST_CASE("arena")
+{
+    using heap = immer::arena_heap<>;
+
+    immer::arena a;
+    auto p = heap::allocate(42u);
+    do_stuff_to(p, 42u);
+    {
+        immer::arena b{128u};
+        auto q = heap::allocate(1000u);
+        do_stuff_to(q, 1000u);
+        auto r = heap::allocate(12u);
+        do_stuff_to(r, 12u);
+        heap::deallocate(1000u, q);
+        auto offset = reinterpret_cast<std::uintptr_t>(r)
+            % alignof(std::max_align_t);
+        CHECK(offset == 0u);
+    }
+    auto u = heap::allocate(12u);
+    do_stuff_to(u, 12u);
+    CHECK(u != p);
+    auto distance = static_cast<char*>(u) - static_cast<char*>(p);
+    CHECK(distance == alignof(std::max_align_t) * 4);
+}
+
+TEST_CASE("hugepage")
+{
+    using heap = immer::hugepage_heap<1u << 16>;
+
+    SECTION("basic")
+    {
+        auto p = heap::allocate(42u);
+        do_stuff_to(p, 42u);
+        auto u = heap::allocate(12u);
+        do_stuff_to(u, 12u);
+        auto offset = reinterpret_cast<std::uintptr_t>(u)
+            % alignof(std::max_align_t);
+        CHECK(offset == 0u);
+        heap::deallocate(42, p);
+        heap::deallocate(12, u);
+    }
+
+    SECTION("big objects")
+    {
+        auto p = heap::allocate(heap::max_size + 1);
+        do_stuff_to(p, heap::max_size + 1);
+        heap::deallocate(heap::max_size + 1, p);
+    }
+
+    SECTION("many regions")
+    {
+        auto v = std::vector<void*>{};
+        for (auto i = 0u; i < 10000u; ++i) {
+            v.push_back(heap::allocate(100u));
+            do_stuff_to(v.back(), 100u);
+        }
+        for (auto p : v)
+            heap::deallocate(100u, p);
+    }
+
+    SECTION("deallocate from other threads")
+    {
+        auto v = std::vector<void*>{};
+        for (auto i = 0u; i < 10000u; ++i)
+            v.push_back(heap::allocate(100u));
+        std::thread{[&] {
+            for (auto p : v)
+                heap::deallocate(100u, p);
+        }}.join();
+    }
+
+    SECTION("composition")
+    {
+        using split = immer::split_heap<64, heap, immer::malloc_heap>;
+        auto p = split::allocate(42u);
+        auto q = split::allocate(420u);
+        do_stuff_to(p, 42u);
+        do_stuff_to(q, 420u);
+        split::deallocate(42u, p);
+        split::deallocate(420u, q);
+
+        using free_list = immer::free_list_heap<64, 16, heap>;
+        auto u = free_list::allocate(42u);
+        free_list::deallocate(42u, u);
+        CHECK(free_list::allocate(12u) == u);
+        free_list::deallocate(12u, u);
+    }
+}
+
 template <typename Heap>
 void test_free_list_heap()
 {
@@ -88,12 +190,392 @@ TEST_CASE("free list")
     test_free_list_heap<immer::free_list_heap<42u, 2, immer::malloc_heap>>();
 }
 
+TEST_CASE("free list concurrent")
+{
+    using heap = immer::free_list_heap<42u, 64, immer::malloc_heap>;
+
+    constexpr auto thread_count = 8u;
+    constexpr auto iterations   = 10000u;
+    constexpr auto batch        = 16u;
+
+    auto failures = std::vector<unsigned>(thread_count, 0u);
+    auto threads  = std::vector<std::thread>{};
+    for (auto t = 0u; t < thread_count; ++t) {
+        threads.emplace_back([&, t] {
+            void* ps[batch];
+            for (auto i = 0u; i < iterations; ++i) {
+                for (auto& p : ps) {
+                    p = heap::allocate(42u);
+                    std::fill_n(static_cast<unsigned char*>(p), 42u, t);
+                }
+                for (auto& p : ps) {
+                    auto b = static_cast<unsigned char*>(p);
+                    failures[t] += std::count(b, b + 42u, t) != 42;
+                    heap::deallocate(42u, p);
+                }
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    CHECK(std::accumulate(failures.begin(), failures.end(), 0u) == 0u);
+}
+
 TEST_CASE("thread local free list")
 {
     test_free_list_heap<immer::thread_local_free_list_heap<42u, 2, immer::malloc_heap>>();
 }
 
+template <typename Tag>
+struct counting_heap : immer::malloc_heap
+{
+    static std::atomic<std::size_t> allocations;
+    static std::atomic<std::size_t> deallocations;
+
+    template <typename... Tags>
+    static void* allocate(std::size_t size, Tags...)
+    {
+        ++allocations;
+        return malloc_heap::allocate(size);
+    }
+
+    static void deallocate(std::size_t size, void* data)
+    {
+        ++deallocations;
+        malloc_heap::deallocate(size, data);
+    }
+};
+
+template <typename Tag>
+std::atomic<std::size_t> counting_heap<Tag>::allocations {0};
+
+template <typename Tag>
+std::atomic<std::size_t> counting_heap<Tag>::deallocations {0};
+
+TEST_CASE("thread local free list batches")
+{
+    using base = counting_heap<struct batches_tag>;
+    using heap = immer::thread_local_free_list_heap<
+        42u, 8, immer::free_list_heap<42u, 1024, base>>;
+
+    constexpr auto rounds = 10u;
+    constexpr auto count  = 64u;
+
+    auto ptrs = std::vector<void*>(count);
+    for (auto r = 0u; r < rounds; ++r) {
+        std::thread{[&] {
+            for (auto& p : ptrs) {
+                p = heap::allocate(42u);
+                do_stuff_to(p, 42u);
+            }
+        }}.join();
+        std::thread{[&] {
+            for (auto p : ptrs)
+                heap::deallocate(42u, p);
+        }}.join();
+    }
+    // only the first round, and a few that got stuck in the thread
+    // local lists, need to hit the parent heap
+    CHECK(base::allocations < 2 * count);
+}
+
+TEST_CASE("thread local free list of nodes too small to be batched")
+{
+    using heap = immer::thread_local_free_list_heap<
+        8u, 64, immer::free_list_heap<8u, 64, immer::malloc_heap>>;
+    static_assert(!immer::detail::has_free_list_batches<
+                      immer::free_list_heap<8u, 64, immer::malloc_heap>>{},
+                  "");
+
+    auto ptrs = std::vector<void*>(128);
+    for (auto& p : ptrs) {
+        p = heap::allocate(8u);
+        do_stuff_to(p, 8u);
+    }
+    for (auto p : ptrs)
+        heap::deallocate(8u, p);
+    heap::trim();
+}
+
+template <typename Heap, typename Base>
+void test_free_list_reserve_and_trim()
+{
+    using heap = Heap;
+    using base = Base;
+
+    auto ptrs = std::vector<void*>(16);
+
+    SECTION("reserve")
+    {
+        heap::reserve(16);
+        CHECK(base::allocations == 16u);
+        for (auto& p : ptrs)
+            p = heap::allocate(42u);
+        CHECK(base::allocations == 16u);
+        for (auto p : ptrs)
+            heap::deallocate(42u, p);
+        heap::reserve(16);
+        CHECK(base::allocations == 16u);
+    }
+
+    SECTION("trim")
+    {
+        for (auto& p : ptrs)
+            p = heap::allocate(42u);
+        for (auto p : ptrs)
+            heap::deallocate(42u, p);
+        CHECK(base::deallocations == 0u);
+        heap::trim();
+        CHECK(base::deallocations == 16u);
+        heap::deallocate(42u, heap::allocate(42u));
+        CHECK(base::allocations == 17u);
+    }
+
+    SECTION("limit")
+    {
+        CHECK(heap::limit() == 64u);
+        heap::set_limit(0);
+        auto p = heap::allocate(42u);
+        heap::deallocate(42u, p);
+        CHECK(base::deallocations == 1u);
+        heap::reserve(16);
+        CHECK(base::allocations == 1u);
+        heap::set_limit(64);
+    }
+
+    heap::trim();
+    base::allocations   = 0;
+    base::deallocations = 0;
+}
+
+TEST_CASE("free list reserve and trim")
+{
+    using base = counting_heap<struct reserve_tag>;
+    test_free_list_reserve_and_trim<
+        immer::free_list_heap<42u, 64, base, 1>, base>();
+}
+
+TEST_CASE("thread local free list reserve and trim")
+{
+    using base = counting_heap<struct local_reserve_tag>;
+    test_free_list_reserve_and_trim<
+        immer::thread_local_free_list_heap<42u, 64, base>, base>();
+}
+
+TEST_CASE("free list heap policy reserve and trim")
+{
+    using base     = counting_heap<struct policy_reserve_tag>;
+    using policy_t = immer::free_list_heap_policy<base, 64>;
+    using memory_t = immer::memory_policy<policy_t, immer::refcount_policy>;
+    using vector_t = immer::flex_vector<int, memory_t>;
+
+    // uses the sizes of the nodes of the vector
+    vector_t{};
+    auto empty = base::allocations.load();
+
+    policy_t::reserve(32);
+    auto reserved = base::allocations.load();
+    CHECK(reserved > empty);
+    {
+        auto v = vector_t{};
+        for (auto i = 0; i < 32 * 32; ++i)
+            v = v.push_back(i);
+        CHECK(base::allocations == reserved);
+    }
+
+    policy_t::trim();
+    CHECK(base::deallocations >= reserved - empty);
+
+    policy_t::set_limit(0);
+    auto before = base::deallocations.load();
+    {
+        auto v = vector_t{}.push_back(42);
+    }
+    CHECK(base::deallocations > before);
+    policy_t::set_limit(64);
+}
+
 TEST_CASE("unsafe free_list")
 {
     test_free_list_heap<immer::unsafe_free_list_heap<42u, 2, immer::malloc_heap>>();
 }
+
+TEST_CASE("remote free list")
+{
+    test_free_list_heap<immer::remote_free_list_heap<42u, 2, immer::malloc_heap>>();
+}
+
+TEST_CASE("remote free list returns nodes to their owner")
+{
+    using base = counting_heap<struct remote_tag>;
+    using heap = immer::remote_free_list_heap<42u, 1024, base>;
+
+    constexpr auto count = 64u;
+
+    auto allocated = std::promise<void>{};
+    auto released  = std::promise<void>{};
+    auto ptrs      = std::vector<void*>(count);
+    auto owner     = std::thread{[&] {
+        for (auto& p : ptrs)
+            p = heap::allocate(42u);
+        allocated.set_value();
+        released.get_future().wait();
+        auto again = std::vector<void*>(count);
+        for (auto& p : again)
+            p = heap::allocate(42u);
+        CHECK(std::is_permutation(ptrs.begin(), ptrs.end(), again.begin()));
+        for (auto p : again)
+            heap::deallocate(42u, p);
+    }};
+    allocated.get_future().wait();
+    for (auto p : ptrs)
+        heap::deallocate(42u, p);
+    released.set_value();
+    owner.join();
+    CHECK(base::allocations == count);
+}
+
+namespace {
+
+immer::heap_stats_counters operator-(immer::heap_stats_counters a,
+                                     const immer::heap_stats_counters& b)
+{
+    a.allocations       -= b.allocations;
+    a.deallocations     -= b.deallocations;
+    a.allocated_bytes   -= b.allocated_bytes;
+    a.deallocated_bytes -= b.deallocated_bytes;
+    a.misses            -= b.misses;
+    a.releases          -= b.releases;
+    return a;
+}
+
+} // anonymous namespace
+
+TEST_CASE("stats heap")
+{
+    using tag_t = immer::heap_stats_tag;
+    auto size_class = immer::heap_stats::size_class(42u);
+    auto before = immer::get_heap_stats();
+
+    SECTION("size classes")
+    {
+        CHECK(immer::heap_stats::size_class(1u) == 0u);
+        CHECK(immer::heap_stats::size_class(2u) == 1u);
+        CHECK(immer::heap_stats::size_class(42u) == 6u);
+        CHECK(immer::heap_stats::size_class(64u) == 6u);
+        CHECK(immer::heap_stats::size_class(65u) == 7u);
+        CHECK(immer::heap_stats::size_class(std::size_t{1} << 40)
+              == immer::heap_stats::size_classes - 1);
+        CHECK(immer::heap_stats::size_class_limit(6u) == 64u);
+    }
+
+    SECTION("counts by size class and tag")
+    {
+        using heap = immer::stats_heap<immer::malloc_heap>;
+        auto p = heap::allocate(42u);
+        auto q = heap::allocate(42u);
+        auto r = heap::allocate(1000u, immer::norefs_tag{});
+        do_stuff_to(p, 42u);
+        heap::deallocate(42u, p);
+
+        auto after = immer::get_heap_stats();
+        auto small = after.get(tag_t::none, size_class)
+            - before.get(tag_t::none, size_class);
+        CHECK(small.allocations == 2u);
+        CHECK(small.deallocations == 1u);
+        CHECK(small.live() == 1u);
+        CHECK(small.live_bytes() == 42u);
+        CHECK(small.misses == 0u);
+        auto norefs = after.by_tag(tag_t::norefs)
+            - before.by_tag(tag_t::norefs);
+        CHECK(norefs.allocations == 1u);
+        CHECK(norefs.allocated_bytes == 1000u);
+        CHECK((after.total() - before.total()).allocations == 3u);
+
+        heap::deallocate(42u, q);
+        heap::deallocate(1000u, r);
+        CHECK((immer::get_heap_stats().total() - before.total()).live() == 0u);
+    }
+
+    SECTION("free list hits")
+    {
+        using heap = immer::stats_heap<
+            immer::with_free_list_node<
+                immer::unsafe_free_list_heap<
+                    42u, 16,
+                    immer::stats_fallback_heap<immer::malloc_heap>>>>;
+        auto ptrs = std::vector<void*>(4);
+        for (auto round = 0; round < 2; ++round) {
+            for (auto& p : ptrs)
+                p = heap::allocate(42u);
+            for (auto p : ptrs)
+                heap::deallocate(42u, p);
+        }
+        auto c = immer::get_heap_stats().get(tag_t::none, size_class)
+            - before.get(tag_t::none, size_class);
+        CHECK(c.allocations == 8u);
+        CHECK(c.misses == 4u);
+        CHECK(c.hits() == 4u);
+        CHECK(c.hit_rate() == 0.5);
+        CHECK(c.releases == 0u);
+        heap::clear();
+    }
+
+    SECTION("threads that are gone")
+    {
+        using heap = immer::stats_heap<immer::malloc_heap>;
+        std::thread{[] {
+            for (auto i = 0; i < 10; ++i)
+                heap::deallocate(42u, heap::allocate(42u));
+        }}.join();
+        auto c = immer::get_heap_stats().get(tag_t::none, size_class)
+            - before.get(tag_t::none, size_class);
+        CHECK(c.allocations == 10u);
+        CHECK(c.deallocations == 10u);
+    }
+
+    SECTION("containers")
+    {
+        using memory_t = immer::memory_policy<
+            immer::stats_heap_policy<immer::malloc_heap>,
+            immer::refcount_policy>;
+        using vector_t = immer::flex_vector<int, memory_t>;
+        // the empty root and tail are allocated once and never freed
+        vector_t{};
+        before = immer::get_heap_stats();
+        {
+            auto v = vector_t{};
+            for (auto i = 0; i < 1000; ++i)
+                v = v.push_back(i);
+            auto w = v + v;
+            auto c = immer::get_heap_stats().total() - before.total();
+            CHECK(c.live() > 0u);
+            CHECK(c.misses > 0u);
+            CHECK((immer::get_heap_stats().by_tag(tag_t::norefs)
+                   - before.by_tag(tag_t::norefs)).allocations > 0u);
+        }
+        auto c = immer::get_heap_stats().total() - before.total();
+        CHECK(c.live() == 0u);
+        CHECK(c.hits() > 0u);
+    }
+}
+
+TEST_CASE("arena outside of an arena")
+{
+    struct tag {};
+    using base = counting_heap<tag>;
+    using heap = immer::arena_heap<base>;
+
+    auto p = heap::allocate(42u);
+    do_stuff_to(p, 42u);
+    CHECK(base::allocations == 1u);
+    {
+        immer::arena a;
+        auto q = heap::allocate(42u);
+        do_stuff_to(q, 42u);
+        heap::deallocate(42u, q);
+        heap::deallocate(42u, p);
+        CHECK(base::allocations == 1u);
+        CHECK(base::deallocations == 1u);
+    }
+}
@@ -9,9 +9,21 @@
 #include <immer/refcount/refcount_policy.hpp>
 #include <immer/refcount/unsafe_refcount_policy.hpp>
 #include <immer/refcount/no_refcount_policy.hpp>
+#include <immer/refcount/deferred_refcount_policy.hpp>
+#include <immer/refcount/biased_refcount_policy.hpp>
+#include <immer/refcount/epoch_refcount_policy.hpp>
+#include <immer/array.hpp>
+#include <immer/box.hpp>
+#include <immer/flex_vector.hpp>
+#include <immer/map.hpp>
+#include <immer/vector.hpp>
 
 #include <catch.hpp>
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+
 TEST_CASE("no refcount has no data")
 {
     static_assert(std::is_empty<immer::no_refcount_policy>{}, "");
@@ -52,6 +64,17 @@ void test_refcount()
         elem.dec_unsafe();
         CHECK(elem.dec());
     }
+
+    SECTION("immortal")
+    {
+        refcount elem{};
+        elem.make_immortal();
+        elem.inc();
+        CHECK(!elem.dec());
+        CHECK(!elem.dec());
+        CHECK(!elem.dec());
+        CHECK(!elem.unique());
+    }
 }
 
 TEST_CASE("basic refcount")
@@ -63,3 +86,431 @@ TEST_CASE("thread unsafe refcount")
 {
     test_refcount<immer::unsafe_refcount_policy>();
 }
+
+TEST_CASE("deferred refcount")
+{
+    test_refcount<immer::deferred_refcount_policy<>>();
+}
+
+TEST_CASE("empty roots are immortal")
+{
+    auto v = immer::vector<int>{};
+    auto f = immer::flex_vector<int>{};
+    auto a = immer::array<int>{};
+    auto m = immer::map<int, int>{};
+    CHECK(v.impl().root->refs(v.impl().root).immortal());
+    CHECK(v.impl().tail->refs(v.impl().tail).immortal());
+    CHECK(f.impl().root->refs(f.impl().root).immortal());
+    CHECK(a.impl().ptr->refs().immortal());
+    CHECK(m.impl().root->refs(m.impl().root).immortal());
+    auto w = v.push_back(1);
+    CHECK(!w.impl().tail->refs(w.impl().tail).immortal());
+}
+
+namespace {
+
+// a user defined policy, that does not know about immortality
+struct plain_refcount_policy
+{
+    mutable int refcount;
+
+    plain_refcount_policy() : refcount{1} {};
+    plain_refcount_policy(immer::disowned) : refcount{0} {}
+
+    void inc() { ++refcount; }
+    bool dec() { return --refcount == 0; }
+    void dec_unsafe() { --refcount; }
+    bool unique() { return refcount == 1; }
+};
+
+} // anonymous namespace
+
+TEST_CASE("empty roots without immortality")
+{
+    using memory = immer::memory_policy<
+        immer::default_heap_policy, plain_refcount_policy>;
+    static_assert(
+        !immer::detail::has_make_immortal_v<plain_refcount_policy>, "");
+    static_assert(
+        immer::detail::has_make_immortal_v<immer::refcount_policy>, "");
+
+    auto v = immer::vector<int, memory>{}.push_back(1);
+    auto f = immer::flex_vector<int, memory>{}.push_front(1);
+    auto a = immer::array<int, memory>{}.push_back(1);
+    auto m = immer::map<int, int, std::hash<int>,
+                        std::equal_to<int>, memory>{}.set(1, 1);
+    CHECK(v.size() == 1u);
+    CHECK(f.size() == 1u);
+    CHECK(a.size() == 1u);
+    CHECK(m.size() == 1u);
+}
+
+TEST_CASE("biased refcount")
+{
+    test_refcount<immer::biased_refcount_policy>();
+
+    SECTION("other threads")
+    {
+        using refcount = immer::biased_refcount_policy;
+        refcount elem{};
+        std::thread{[&] {
+            elem.inc();
+            elem.inc();
+            CHECK(!elem.dec());
+        }}.join();
+        CHECK(!elem.dec());
+        elem.inc();
+        CHECK(!elem.unique());
+        std::thread{[&] {
+            CHECK(!elem.dec());
+            CHECK(elem.unique());
+        }}.join();
+        CHECK(elem.dec());
+    }
+}
+
+TEST_CASE("epoch refcount")
+{
+    test_refcount<immer::epoch_refcount_policy>();
+
+    SECTION("counted while reading")
+    {
+        immer::epoch_refcount_policy elem{};
+        {
+            immer::epoch_guard guard;
+            elem.inc();
+            CHECK(!elem.dec());
+        }
+        CHECK(elem.dec());
+    }
+
+    SECTION("never unique")
+    {
+        immer::epoch_refcount_policy elem{};
+        CHECK(!elem.unique());
+        CHECK(elem.dec());
+    }
+}
+
+namespace {
+
+struct counted
+{
+    static std::atomic<int> alive;
+    counted() { ++alive; }
+    counted(const counted&) { ++alive; }
+    ~counted() { --alive; }
+};
+
+std::atomic<int> counted::alive {0};
+
+using deferred_memory = immer::memory_policy<
+    immer::free_list_heap_policy<immer::cpp_heap>,
+    immer::deferred_refcount_policy<>>;
+
+template <typename Container, typename Fn>
+void test_deferred(Fn make)
+{
+    immer::drain_deferred();
+    {
+        auto v = make();
+        auto w = v;
+        CHECK(counted::alive > 0);
+    }
+    CHECK(counted::alive > 0);
+    CHECK(immer::pending_deferred() > 0);
+    CHECK(immer::drain_deferred() > 0);
+    CHECK(counted::alive == 0);
+    CHECK(immer::pending_deferred() == 0);
+}
+
+} // anonymous namespace
+
+TEST_CASE("deferred reclamation")
+{
+    SECTION("vector")
+    {
+        using vector_t = immer::vector<counted, deferred_memory, 3u>;
+        test_deferred<vector_t>([] {
+            auto v = vector_t{};
+            for (auto i = 0; i < 666; ++i)
+                v = std::move(v).push_back({});
+            return v;
+        });
+    }
+
+    SECTION("flex_vector")
+    {
+        using vector_t = immer::flex_vector<counted, deferred_memory, 3u>;
+        test_deferred<vector_t>([] {
+            auto v = vector_t{};
+            for (auto i = 0; i < 666; ++i)
+                v = vector_t{}.push_back({}) + v;
+            return v;
+        });
+    }
+
+    SECTION("array")
+    {
+        using array_t = immer::array<counted, deferred_memory>;
+        test_deferred<array_t>([] { return array_t(42u); });
+    }
+
+    SECTION("map")
+    {
+        using map_t = immer::map<int, counted, std::hash<int>,
+                                 std::equal_to<int>, deferred_memory>;
+        test_deferred<map_t>([] {
+            auto m = map_t{};
+            for (auto i = 0; i < 666; ++i)
+                m = std::move(m).set(i, {});
+            return m;
+        });
+    }
+
+    SECTION("nested")
+    {
+        using inner_t = immer::vector<counted, deferred_memory>;
+        using outer_t = immer::vector<inner_t, deferred_memory>;
+        test_deferred<outer_t>([] {
+            auto v = outer_t{};
+            for (auto i = 0; i < 42; ++i)
+                v = std::move(v).push_back(inner_t(42u));
+            return v;
+        });
+    }
+
+    SECTION("budget")
+    {
+        using vector_t = immer::flex_vector<counted, deferred_memory, 3u>;
+        using map_t = immer::map<int, counted, std::hash<int>,
+                                 std::equal_to<int>, deferred_memory>;
+        {
+            auto v = vector_t(666u);
+            auto m = map_t{};
+            for (auto i = 0; i < 666; ++i)
+                m = m.set(i, {});
+            v = vector_t{}.push_back({}) + v;
+        }
+        auto calls = 0;
+        while (immer::pending_deferred()) {
+            CHECK(immer::drain_deferred(10u) <= 10u);
+            ++calls;
+        }
+        CHECK(calls > 10);
+        CHECK(counted::alive == 0);
+    }
+
+    SECTION("reclamation thread")
+    {
+        using vector_t = immer::vector<counted, deferred_memory>;
+        {
+            immer::reclamation_thread reclaimer;
+            auto v = vector_t(666u);
+            CHECK(counted::alive == 666);
+        }
+        CHECK(counted::alive == 0);
+        CHECK(immer::pending_deferred() == 0);
+    }
+}
+
+TEST_CASE("biased reclamation")
+{
+    using biased_memory = immer::memory_policy<
+        immer::free_list_heap_policy<immer::cpp_heap>,
+        immer::biased_refcount_policy>;
+    using vector_t = immer::flex_vector<counted, biased_memory, 3u>;
+    using map_t    = immer::map<int, counted, std::hash<int>,
+                                std::equal_to<int>, biased_memory>;
+
+    SECTION("released by other threads")
+    {
+        {
+            auto v = vector_t(666u);
+            auto m = map_t{};
+            for (auto i = 0; i < 666; ++i)
+                m = std::move(m).set(i, {});
+            auto threads = std::vector<std::thread>{};
+            std::size_t sizes[4][2];
+            for (auto i = 0; i < 4; ++i)
+                threads.emplace_back([v, m, i, &sizes] () mutable {
+                    auto w = v.push_back({}).drop(i) + v;
+                    auto n = m.set(666 + i, {}).erase(i);
+                    v = {};
+                    m = {};
+                    sizes[i][0] = w.size();
+                    sizes[i][1] = n.size();
+                });
+            v = {};
+            for (auto& t : threads)
+                t.join();
+            for (auto i = 0u; i < 4; ++i) {
+                CHECK(sizes[i][0] == 666u * 2 + 1 - i);
+                CHECK(sizes[i][1] == 666u);
+            }
+            CHECK(counted::alive == 666);
+        }
+        CHECK(counted::alive == 0);
+    }
+
+    SECTION("moved to other threads")
+    {
+        {
+            auto v = vector_t(666u);
+            auto copies = std::vector<vector_t>(4, v);
+            auto threads = std::vector<std::thread>{};
+            for (auto& c : copies)
+                threads.emplace_back([c = std::move(c)] () mutable {
+                    c = std::move(c).push_back({});
+                    c = {};
+                });
+            for (auto& t : threads)
+                t.join();
+            CHECK(counted::alive == 666);
+        }
+        CHECK(counted::alive == 0);
+    }
+}
+
+TEST_CASE("epoch reclamation")
+{
+    using epoch_memory = immer::memory_policy<
+        immer::free_list_heap_policy<immer::cpp_heap>,
+        immer::epoch_refcount_policy>;
+    using vector_t = immer::flex_vector<counted, epoch_memory, 3u>;
+    using map_t    = immer::map<int, counted, std::hash<int>,
+                                std::equal_to<int>, epoch_memory>;
+    using box_t    = immer::box<map_t, epoch_memory>;
+
+    immer::drain_retired();
+    immer::drain_retired();
+
+    SECTION("retired when released")
+    {
+        {
+            auto v = vector_t(666u);
+            auto w = v.push_back({});
+            auto m = map_t{}.set(42, {});
+            CHECK(counted::alive >= 668);
+        }
+        CHECK(counted::alive >= 668);
+        CHECK(immer::pending_retired() > 0);
+        CHECK(immer::drain_retired() > 0);
+        CHECK(counted::alive == 0);
+        CHECK(immer::pending_retired() == 0);
+    }
+
+    SECTION("snapshots are not counted")
+    {
+        auto v = vector_t(666u);
+        auto root = v.impl().root;
+        auto count = root->refs(root).refcount.load();
+        {
+            immer::epoch_snapshot<vector_t> s{v};
+            CHECK(root->refs(root).refcount.load() == count);
+            CHECK(s->size() == 666u);
+            CHECK(&s.get()[42] == &v[42]);
+        }
+        CHECK(root->refs(root).refcount.load() == count);
+        v = {};
+        immer::drain_retired();
+        CHECK(counted::alive == 0);
+    }
+
+    SECTION("copies made inside a guard are counted")
+    {
+        auto v = vector_t(666u);
+        auto w = vector_t{};
+        {
+            immer::epoch_guard guard;
+            w = v;
+        }
+        v = {};
+        immer::drain_retired();
+        CHECK(counted::alive == 666);
+        CHECK(w.size() == 666u);
+        w = {};
+        immer::drain_retired();
+        CHECK(counted::alive == 0);
+    }
+
+    SECTION("waits for readers")
+    {
+        auto b = box_t{map_t{}.set(1, {}).set(2, {})};
+        immer::drain_retired();
+        {
+            immer::epoch_snapshot<box_t> snapshot{b};
+            std::thread{[&] {
+                b = box_t{};
+                immer::drain_retired();
+            }}.join();
+            CHECK(counted::alive == 2);
+            CHECK(snapshot->get().size() == 2u);
+        }
+        immer::drain_retired();
+        CHECK(counted::alive == 0);
+    }
+
+    SECTION("nested trees wait for later readers")
+    {
+        auto m = map_t{}.set(1, {});
+        auto b = box_t{m};
+        b = box_t{};
+        {
+            // the epoch moves on while the box is retired, so it
+            // becomes ready while a later reader still sees the map
+            immer::epoch_snapshot<map_t> first{m};
+            std::thread{[] { immer::drain_retired(); }}.join();
+        }
+        {
+            immer::epoch_snapshot<map_t> snapshot{m};
+            std::thread{[&] {
+                m = map_t{};
+                immer::drain_retired();
+            }}.join();
+            CHECK(counted::alive == 1);
+            CHECK(snapshot->size() == 1u);
+            CHECK(snapshot->count(1) == 1u);
+        }
+        immer::drain_retired();
+        CHECK(counted::alive == 0);
+    }
+
+    SECTION("concurrent readers")
+    {
+        {
+            std::mutex mutex;
+            auto current = box_t{};
+            std::atomic<bool> done {false};
+            std::atomic<int> errors {0};
+            auto readers = std::vector<std::thread>{};
+            for (auto i = 0; i < 4; ++i)
+                readers.emplace_back([&] {
+                    while (!done) {
+                        std::unique_lock<std::mutex> lock{mutex};
+                        immer::epoch_snapshot<box_t> snapshot{current};
+                        lock.unlock();
+                        auto count = 0u;
+                        for (auto&& x : snapshot->get()) {
+                            (void) x;
+                            ++count;
+                        }
+                        if (count != snapshot->get().size())
+                            ++errors;
+                    }
+                });
+            for (auto i = 0; i < 666; ++i) {
+                auto next = current->set(i, {});
+                std::lock_guard<std::mutex> lock{mutex};
+                current = std::move(next);
+            }
+            done = true;
+            for (auto& t : readers)
+                t.join();
+            CHECK(errors == 0);
+            CHECK(counted::alive >= 666);
+        }
+        immer::drain_retired();
+        CHECK(counted::alive == 0);
+    }
+}
@@ -0,0 +1,26 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#include <immer/cached_hash.hpp>
+#include <immer/set.hpp>
+
+// the hashes are embedded in the inner nodes along with the values
+using fewer_bigger_memory = immer::memory_policy<
+    immer::free_list_heap_policy<immer::cpp_heap>,
+    immer::refcount_policy,
+    immer::no_transience_policy,
+    true>;
+
+template <typename T,
+          typename Hash = std::hash<T>,
+          typename Eq   = std::equal_to<T>>
+using test_set_t = immer::set<T, immer::cached_hash<Hash>, Eq,
+                              fewer_bigger_memory, 3u>;
+
+#define SET_T test_set_t
+#include "generic.ipp"
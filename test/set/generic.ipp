@@ -16,9 +16,13 @@
 #include "test/dada.hpp"
 
 #include <immer/algorithm.hpp>
+#include <immer/executor.hpp>
 
 #include <catch.hpp>
 
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
 #include <unordered_set>
 #include <random>
 
@@ -155,6 +159,41 @@ TEST_CASE("erase a lot")
     }
 }
 
+TEST_CASE("insert and erase move")
+{
+    constexpr auto N = 666u;
+
+    using set_t = SET_T<unsigned>;
+
+    auto s = set_t{};
+
+    auto check_move = [&] (set_t&& x) -> set_t&& {
+        if (set_t::memory_policy::use_transient_rvalues)
+            CHECK(&x == &s);
+        else
+            CHECK(&x != &s);
+        return std::move(x);
+    };
+
+    for (auto i = 0u; i < N; ++i)
+        s = check_move(std::move(s).insert(i));
+    auto p = s;
+    for (auto i = 0u; i < N; i += 2)
+        s = check_move(std::move(s).erase(i));
+    for (auto i = N; i < 2 * N; ++i)
+        s = check_move(std::move(s).insert(i));
+
+    CHECK(p.size() == N);
+    for (auto i = 0u; i < N; ++i)
+        CHECK(p.count(i) == 1);
+    CHECK(s.size() == N + N / 2);
+    for (auto i = 0u; i < 2 * N; ++i)
+        CHECK(s.count(i) == (i >= N || i % 2));
+    for (auto i = 0u; i < 2 * N; ++i)
+        s = check_move(std::move(s).erase(i));
+    CHECK(s.size() == 0);
+}
+
 TEST_CASE("erase conflicts")
 {
     constexpr auto N = 666u;
@@ -201,6 +240,66 @@ TEST_CASE("accumulate")
     }
 }
 
+TEST_CASE("parallel accumulate")
+{
+    const auto n = 6666u;
+    auto s = make_test_set(n);
+    auto expected = n * (n - 1) / 2;
+
+    SECTION("sequential executor")
+    {
+        auto ex = immer::sequential_executor{};
+        CHECK(immer::accumulate(ex, s, 0u, std::plus<unsigned>{}) == expected);
+    }
+
+    SECTION("thread executor")
+    {
+        auto ex = immer::thread_executor{4};
+        CHECK(immer::accumulate(ex, s, 0u, std::plus<unsigned>{}) == expected);
+        CHECK(immer::accumulate(ex, s, 1u, std::plus<unsigned>{})
+              == expected + 1);
+        CHECK(immer::accumulate(ex, SET_T<unsigned>{}, 42u,
+                                std::plus<unsigned>{}) == 42u);
+    }
+
+    SECTION("combine")
+    {
+        auto ex = immer::thread_executor{3};
+        auto v = immer::accumulate(
+            ex, s, std::vector<unsigned>{},
+            [] (auto acc, auto x) { acc.push_back(x); return acc; },
+            [] (auto a, auto b) {
+                a.insert(a.end(), b.begin(), b.end());
+                return a;
+            });
+        std::sort(v.begin(), v.end());
+        CHECK(v.size() == n);
+        for (auto i = 0u; i < n; ++i)
+            CHECK(v[i] == i);
+    }
+
+    SECTION("for each chunk")
+    {
+        auto ex = immer::thread_executor{};
+        std::atomic<unsigned> sum{0};
+        immer::for_each_chunk(ex, s, [&] (auto first, auto last) {
+            sum += std::accumulate(first, last, 0u);
+        });
+        CHECK(sum == expected);
+    }
+
+    SECTION("exceptions")
+    {
+        auto ex = immer::thread_executor{4};
+        auto fn = [] (auto first, auto last) {
+            if (std::find(first, last, 42u) != last)
+                throw std::runtime_error{"42"};
+        };
+        CHECK_THROWS_AS(immer::for_each_chunk(ex, s, fn),
+                        std::runtime_error&);
+    }
+}
+
 TEST_CASE("iterator")
 {
     const auto N = 666u;
@@ -277,6 +376,99 @@ TEST_CASE("non default")
     CHECK(v.size() == n);
 }
 
+TEST_CASE("from range")
+{
+    constexpr auto n = 666u;
+
+    SECTION("values")
+    {
+        auto gen  = make_generator();
+        auto vals = std::vector<unsigned>{};
+        generate_n(back_inserter(vals), n, [&] { return gen() % (n / 2); });
+        auto s = SET_T<unsigned>(vals.begin(), vals.end());
+        auto e = SET_T<unsigned>{};
+        for (auto&& v : vals)
+            e = e.insert(v);
+        CHECK(s == e);
+        CHECK(s.size() == e.size());
+        CHECK(SET_T<unsigned>(vals.begin(), vals.begin()).size() == 0);
+        CHECK(SET_T<unsigned>{42u}.count(42u) == 1);
+    }
+
+    SECTION("collisions")
+    {
+        auto vals = make_values_with_collisions(n);
+        auto dups = vals;
+        dups.insert(dups.end(), vals.begin(), vals.begin() + n / 2);
+        auto s = SET_T<conflictor, hash_conflictor>(dups.begin(), dups.end());
+        CHECK(s.size() == n);
+        CHECK(s == make_test_set(vals));
+    }
+
+    SECTION("insert")
+    {
+        auto s = make_test_set(n);
+        auto vals = std::vector<unsigned>{};
+        for (auto i = n / 2; i < n + n / 2; ++i)
+            vals.push_back(i);
+        auto r = s.insert(vals.begin(), vals.end());
+        CHECK(r == make_test_set(n + n / 2));
+        CHECK(s == make_test_set(n));
+    }
+}
+
+TEST_CASE("hashed")
+{
+    const auto n = 666u;
+    auto hash = [] (unsigned x) { return std::hash<unsigned>{}(x); };
+
+    auto s = SET_T<unsigned>{};
+    for (auto i = 0u; i < n; ++i)
+        s = i % 2
+            ? s.insert_hashed(i, hash(i))
+            : std::move(s).insert_hashed(i, hash(i));
+    CHECK(s == make_test_set(n));
+    for (auto i = 0u; i < n; ++i)
+        CHECK(s.count_hashed(i, hash(i)) == 1);
+    CHECK(s.count_hashed(n, hash(n)) == 0);
+
+    auto s2 = s;
+    for (auto i = 0u; i < n; i += 2)
+        s2 = i % 4
+            ? s2.erase_hashed(i, hash(i))
+            : std::move(s2).erase_hashed(i, hash(i));
+    CHECK(s2.size() == n / 2);
+    for (auto i = 0u; i < n; ++i)
+        CHECK(s2.count(i) == i % 2);
+    CHECK(s.size() == n);
+}
+
+TEST_CASE("transparent lookup")
+{
+    using set_t = SET_T<std::string, transparent_hash, transparent_equal>;
+    const auto n = 666u;
+
+    auto keys = std::vector<std::string>{};
+    auto s = set_t{};
+    for (auto i = 0u; i < n; ++i) {
+        keys.push_back(std::to_string(i));
+        s = s.insert(keys.back());
+    }
+
+    for (auto i = 0u; i < n; ++i)
+        CHECK(s.count(str_view{keys[i].c_str()}) == 1);
+    CHECK(s.count(str_view{"foo"}) == 0);
+
+    auto s2 = s;
+    for (auto i = 0u; i < n; ++i) {
+        auto k = str_view{keys[i].c_str()};
+        s2 = i % 2 ? s2.erase(k) : std::move(s2).erase(k);
+        CHECK(s2.size() == n - i - 1);
+        CHECK(s2.count(k) == 0);
+        CHECK(s.count(k) == 1);
+    }
+}
+
 TEST_CASE("equals")
 {
     const auto n = 666u;
@@ -305,6 +497,138 @@ TEST_CASE("equals collisions")
           .insert(vals[13]).insert(vals[42]));
 }
 
+template <typename Set, typename Pred>
+Set make_algebra_result(const Set& a, const Set& b, Pred pred)
+{
+    auto r = Set{};
+    for (auto&& x : a)
+        if (pred(true, b.count(x) == 1))
+            r = r.insert(x);
+    for (auto&& x : b)
+        if (!a.count(x) && pred(false, true))
+            r = r.insert(x);
+    return r;
+}
+
+template <typename Set>
+void check_algebra(const Set& a, const Set& b)
+{
+    auto merged = make_algebra_result(a, b, [] (bool x, bool y) { return x || y; });
+    auto common = make_algebra_result(a, b, [] (bool x, bool y) { return x && y; });
+    auto only_a = make_algebra_result(a, b, [] (bool x, bool y) { return x && !y; });
+    CHECK(a.merge(b).size() == merged.size());
+    CHECK(a.merge(b) == merged);
+    CHECK(b.merge(a) == merged);
+    CHECK(a.intersect(b).size() == common.size());
+    CHECK(a.intersect(b) == common);
+    CHECK(b.intersect(a) == common);
+    CHECK(a.difference(b).size() == only_a.size());
+    CHECK(a.difference(b) == only_a);
+}
+
+TEST_CASE("merge, intersect and difference")
+{
+    constexpr auto n = 666u;
+
+    auto gen = make_generator();
+
+    SECTION("versions of the same set")
+    {
+        auto a = make_test_set(n);
+        auto b = a;
+        for (auto i = 0u; i < n / 10; ++i) {
+            b = b.erase(gen() % n);
+            b = b.insert(n + gen() % n);
+        }
+        check_algebra(a, b);
+    }
+
+    SECTION("unrelated sets")
+    {
+        auto a = SET_T<unsigned>{};
+        auto b = SET_T<unsigned>{};
+        for (auto i = 0u; i < n; ++i) {
+            a = a.insert(gen() % (2 * n));
+            b = b.insert(gen() % (2 * n));
+        }
+        check_algebra(a, b);
+        check_algebra(a, SET_T<unsigned>{});
+        check_algebra(SET_T<unsigned>{}, b);
+        check_algebra(a.insert(4u), SET_T<unsigned>{}.insert(4u));
+    }
+
+    SECTION("collisions")
+    {
+        auto vals = make_values_with_collisions(n);
+        auto a = make_test_set(vals);
+        auto b = a;
+        auto c = SET_T<conflictor, hash_conflictor>{};
+        for (auto i = 0u; i < n; i += 3) {
+            b = b.erase(vals[i]);
+            c = c.insert(vals[i]);
+            c = c.insert({vals[i].v1, vals[i].v2 + 1});
+        }
+        check_algebra(a, b);
+        check_algebra(a, c);
+        check_algebra(b, c);
+    }
+
+    SECTION("reuses the shared nodes")
+    {
+        auto a = make_test_set(n);
+        CHECK(a.merge(a).impl().root == a.impl().root);
+        CHECK(a.merge(a.erase(42u)).impl().root == a.impl().root);
+        CHECK(a.erase(42u).merge(a) == a);
+        CHECK(a.intersect(a.insert(n)).impl().root == a.impl().root);
+        CHECK(a.difference(a.erase(42u).insert(n)).size() == 1);
+        CHECK(a.difference(a).size() == 0);
+    }
+}
+
+TEST_CASE("diff")
+{
+    constexpr auto n = 666u;
+
+    auto gen = make_generator();
+
+    SECTION("versions of the same set")
+    {
+        auto a = make_test_set(n);
+        auto b = a;
+        for (auto i = 0u; i < n / 10; ++i) {
+            b = b.erase(gen() % n);
+            b = b.insert(n + gen() % n);
+        }
+        auto added   = SET_T<unsigned>{};
+        auto removed = SET_T<unsigned>{};
+        immer::diff(a, b,
+                    [&] (auto x) { added = added.insert(x); },
+                    [&] (auto x) { removed = removed.insert(x); },
+                    [&] (auto, auto) { CHECK(false); });
+        CHECK(added == b.difference(a));
+        CHECK(removed == a.difference(b));
+    }
+
+    SECTION("collisions")
+    {
+        auto vals = make_values_with_collisions(n);
+        auto a = make_test_set(vals);
+        auto b = a;
+        for (auto i = 0u; i < n; i += 3) {
+            b = b.erase(vals[i]);
+            b = b.insert({vals[i].v1, vals[i].v2 + 1});
+        }
+        auto added   = SET_T<conflictor, hash_conflictor>{};
+        auto removed = SET_T<conflictor, hash_conflictor>{};
+        immer::diff(a, b,
+                    [&] (auto x) { added = added.insert(x); },
+                    [&] (auto x) { removed = removed.insert(x); },
+                    [&] (auto, auto) { CHECK(false); });
+        CHECK(added == b.difference(a));
+        CHECK(removed == a.difference(b));
+    }
+}
+
 TEST_CASE("exception safety")
 {
     constexpr auto n = 2666u;
@@ -389,4 +713,51 @@ TEST_CASE("exception safety")
         CHECK(d.happenings > 0);
         IMMER_TRACE_E(d.happenings);
     }
+
+    SECTION("from range")
+    {
+        auto vals = make_values_with_collisions(n);
+        auto d = dadaism{};
+        auto v = dadaist_conflictor_set_t{};
+        while (v.size() == 0) {
+            try {
+                auto s = d.next();
+                v = dadaist_conflictor_set_t(vals.begin(), vals.end());
+            } catch (dada_error) {}
+        }
+        for (auto&& x : vals)
+            CHECK(v.count({x}) == 1);
+        CHECK(d.happenings > 0);
+        IMMER_TRACE_E(d.happenings);
+    }
+
+    SECTION("merge, intersect and difference")
+    {
+        auto vals = make_values_with_collisions(n);
+        auto a = dadaist_conflictor_set_t{};
+        auto b = dadaist_conflictor_set_t{};
+        auto d = dadaism{};
+        for (auto i = 0u; i < n; ++i) {
+            if (i < n / 2 + n / 4)
+                a = a.insert({vals[i]});
+            if (i >= n / 4)
+                b = b.insert({vals[i]});
+        }
+        for (auto done = 0u; done < 3;) {
+            try {
+                auto s = d.next();
+                auto r = done == 0 ? a.merge(b)
+                       : done == 1 ? a.intersect(b)
+                       :             a.difference(b);
+                CHECK(r.size() == (done == 0 ? n
+                                   : done == 1 ? n / 2
+                                   :             n / 4));
+                ++done;
+            } catch (dada_error) {}
+            CHECK(a.size() == n / 2 + n / 4);
+            CHECK(b.size() == n - n / 4);
+        }
+        CHECK(d.happenings > 0);
+        IMMER_TRACE_E(d.happenings);
+    }
 }
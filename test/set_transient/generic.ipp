@@ -0,0 +1,187 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#include "test/util.hpp"
+#include "test/dada.hpp"
+
+#include <catch.hpp>
+
+#include <random>
+#include <unordered_set>
+
+#ifndef SET_T
+#error "define the set template to use in SET_T"
+#endif
+
+#ifndef SET_TRANSIENT_T
+#error "define the set template to use in SET_TRANSIENT_T"
+#endif
+
+namespace {
+
+template <typename T=unsigned>
+auto make_generator()
+{
+    auto engine = std::default_random_engine{42};
+    auto dist = std::uniform_int_distribution<T>{};
+    return std::bind(dist, engine);
+}
+
+struct conflictor
+{
+    unsigned v1;
+    unsigned v2;
+
+    bool operator== (const conflictor& x) const
+    { return v1 == x.v1 && v2 == x.v2; }
+};
+
+struct hash_conflictor
+{
+    std::size_t operator() (const conflictor& x) const
+    { return x.v1; }
+};
+
+auto make_values_with_collisions(unsigned n)
+{
+    auto gen   = make_generator();
+    auto vals  = std::vector<conflictor>{};
+    auto vals_ = std::unordered_set<conflictor, hash_conflictor>{};
+    generate_n(back_inserter(vals), n, [&] {
+        auto newv = conflictor{};
+        do {
+            newv = { unsigned(gen() % (n / 2)), gen() };
+        } while (!vals_.insert(newv).second);
+        return newv;
+    });
+    return vals;
+}
+
+auto make_test_set(unsigned n)
+{
+    auto s = SET_T<unsigned>{};
+    for (auto i = 0u; i < n; ++i)
+        s = s.insert(i);
+    return s;
+}
+
+} // anonymous namespace
+
+TEST_CASE("from set and to set")
+{
+    constexpr auto n = 100u;
+
+    auto p = make_test_set(n);
+    auto t = p.transient();
+    CHECK(t.size() == n);
+    for (auto i = 0u; i < n; ++i)
+        CHECK(t.count(i) == 1);
+
+    auto p2 = t.persistent();
+    CHECK(p2 == p);
+}
+
+TEST_CASE("protect persistence")
+{
+    constexpr auto n = 666u;
+
+    auto p = make_test_set(n);
+    auto t = p.transient();
+    for (auto i = 0u; i < n; i += 2)
+        t.erase(i);
+    for (auto i = n; i < 2 * n; ++i)
+        t.insert(i);
+    auto p2 = t.persistent();
+    t.erase(1);
+    t.insert(0);
+
+    CHECK(p.size() == n);
+    for (auto i = 0u; i < n; ++i)
+        CHECK(p.count(i) == 1);
+    CHECK(p2.size() == n + n / 2);
+    CHECK(p2.count(0) == 0);
+    CHECK(p2.count(1) == 1);
+    CHECK(t.size() == n + n / 2);
+    CHECK(t.count(0) == 1);
+    CHECK(t.count(1) == 0);
+}
+
+TEST_CASE("insert and erase a lot")
+{
+    constexpr auto n = 1000u;
+
+    auto gen = make_generator();
+    auto t   = SET_TRANSIENT_T<unsigned>{};
+    auto s   = std::unordered_set<unsigned>{};
+    for (auto i = 0u; i < 10 * n; ++i) {
+        auto v = gen() % n;
+        if (gen() % 2) {
+            t.insert(v);
+            s.insert(v);
+        } else {
+            t.erase(v);
+            s.erase(v);
+        }
+        CHECK(t.size() == s.size());
+    }
+    for (auto v : s)
+        CHECK(t.count(v) == 1);
+    auto p = t.persistent();
+    CHECK(p.size() == s.size());
+    for (auto v : p)
+        CHECK(s.count(v) == 1);
+}
+
+TEST_CASE("collisions")
+{
+    constexpr auto n = 666u;
+
+    auto vals = make_values_with_collisions(n);
+    auto t    = SET_TRANSIENT_T<conflictor, hash_conflictor>{};
+    for (auto&& v : vals)
+        t.insert(v);
+    CHECK(t.size() == n);
+    for (auto&& v : vals)
+        CHECK(t.count(v) == 1);
+
+    auto p = t.persistent();
+    for (auto i = 0u; i < n; ++i) {
+        t.erase(vals[i]);
+        CHECK(t.size() == n - i - 1);
+        CHECK(t.count(vals[i]) == 0);
+        for (auto j : test_irange(i + 1, n))
+            CHECK(t.count(vals[j]) == 1);
+    }
+    CHECK(t.empty());
+    CHECK(p.size() == n);
+}
+
+TEST_CASE("transparent lookup")
+{
+    using set_t = SET_TRANSIENT_T<std::string,
+                                  transparent_hash, transparent_equal>;
+    constexpr auto n = 666u;
+
+    auto keys = std::vector<std::string>{};
+    auto t = set_t{};
+    for (auto i = 0u; i < n; ++i) {
+        keys.push_back(std::to_string(i));
+        t.insert(keys.back());
+    }
+
+    for (auto i = 0u; i < n; ++i)
+        CHECK(t.count(str_view{keys[i].c_str()}) == 1);
+    CHECK(t.count(str_view{"foo"}) == 0);
+
+    for (auto i = 0u; i < n; ++i) {
+        auto k = str_view{keys[i].c_str()};
+        t.erase(k);
+        CHECK(t.size() == n - i - 1);
+        CHECK(t.count(k) == 0);
+    }
+}
@@ -11,6 +11,7 @@
 #include <boost/range/irange.hpp>
 #include <boost/range/join.hpp>
 #include <cstddef>
+#include <string>
 
 namespace {
 
@@ -45,6 +46,45 @@ auto test_irange(Integer from, Integer to)
 #endif
 }
 
+/*!
+ * A string that can not be converted to `std::string`, used to check
+ * that the transparent lookups do not build a key to look up.
+ */
+struct str_view
+{
+    const char* data;
+};
+
+struct transparent_hash
+{
+    using is_transparent = void;
+
+    std::size_t operator() (const char* s) const
+    {
+        auto h = std::size_t{14695981039346656037ull};
+        for (; *s; ++s)
+            h = (h ^ static_cast<unsigned char>(*s)) * 1099511628211ull;
+        return h;
+    }
+
+    std::size_t operator() (const std::string& s) const
+    { return (*this)(s.c_str()); }
+
+    std::size_t operator() (str_view s) const
+    { return (*this)(s.data); }
+};
+
+struct transparent_equal
+{
+    using is_transparent = void;
+
+    bool operator() (const std::string& a, const std::string& b) const
+    { return a == b; }
+
+    bool operator() (const std::string& a, str_view b) const
+    { return a == b.data; }
+};
+
 } // anonymous namespace
 
 #if IMMER_SLOW_TESTS
@@ -0,0 +1,36 @@
+//
+// immer: immutable data structures for C++
+// Copyright (C) 2016, 2017, 2018 Juan Pedro Bolivar Puente
+//
+// This software is distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://boost.org/LICENSE_1_0.txt
+//
+
+#include <immer/vector.hpp>
+#include <immer/heap/heap_policy.hpp>
+#include <immer/refcount/no_refcount_policy.hpp>
+
+using arena_memory = immer::memory_policy<
+    immer::arena_heap_policy<>,
+    immer::no_refcount_policy>;
+
+template <typename T>
+using test_vector_t = immer::vector<T, arena_memory, 3u>;
+
+// all the tests below run inside this arena
+static immer::arena test_arena;
+
+#define VECTOR_T test_vector_t
+#include "generic.ipp"
+
+TEST_CASE("empty vectors outlive arenas")
+{
+    {
+        immer::arena scope;
+        auto v = immer::vector<int, arena_memory, 2u>{}.push_back(42);
+        CHECK(v[0] == 42);
+    }
+    auto v = immer::vector<int, arena_memory, 2u>{};
+    CHECK(v.size() == 0u);
+    CHECK(v.push_back(13)[0] == 13);
+}
@@ -180,6 +180,30 @@ TEST_CASE("update")
         }
     }
 
+    SECTION("set if changed")
+    {
+        auto v = make_test_vector(0, 666u);
+
+        auto u = v.set_if_changed(200u, 200u);
+        CHECK(u == v);
+        CHECK(&u[200u] == &v[200u]);
+
+        auto w = v.set_if_changed(200u, 7u);
+        CHECK(w[200u] == 7u);
+        CHECK(v[200u] == 200u);
+
+        auto x = v.set_if_changed(200u, 201u, [] (auto a, auto b) {
+            return a / 2 == b / 2;
+        });
+        CHECK(&x[200u] == &v[200u]);
+
+        auto y = std::move(u).set_if_changed(200u, 200u);
+        CHECK(&y[200u] == &v[200u]);
+        y = std::move(y).set_if_changed(200u, 7u);
+        CHECK(y[200u] == 7u);
+        CHECK(v[200u] == 200u);
+    }
+
     SECTION("update")
     {
         const auto u = v.update(10u, [] (auto x) { return x + 10; });